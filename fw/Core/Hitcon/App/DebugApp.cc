@@ -1,11 +1,13 @@
 #include <App/DebugApp.h>
 #include <Logic/Display/display.h>
+#include <Logic/EcLogic.h>
 #include <Logic/ImuLogic.h>
 #include <Logic/IrController.h>
 #include <Service/Sched/Scheduler.h>
 #include <Service/Sched/SysTimer.h>
 #include <Service/Sched/Task.h>
 #include <Util/uint_to_str.h>
+#include <string.h>
 
 using namespace hitcon::service::sched;
 
@@ -20,6 +22,10 @@ void ByteToHex(uint8_t value, char* out) {
 
 DebugAccelApp g_debug_accel_app;
 IrRetxDebugApp g_ir_retx_debug_app;
+EccDebugApp g_ecc_debug_app;
+#if SCHED_PROFILE
+TaskProfDebugApp g_task_prof_debug_app;
+#endif
 DebugApp g_debug_app;
 
 DebugAccelApp::DebugAccelApp()
@@ -133,4 +139,105 @@ void IrRetxDebugApp::OnEntry() {
 
 void IrRetxDebugApp::OnExit() { MenuApp::OnExit(); }
 
+EccDebugApp::EccDebugApp() : MenuApp(nullptr, 0) {}
+
+void EccDebugApp::OnEntry() {
+  const ecc::PresigStats& stats = ecc::g_ec_logic.GetPresigStats();
+
+  // "PRESIG:n/N" with how many presignatures are ready, then how many were
+  // made, used by a signature, and missed because the pool was empty.
+  char* header = menu_texts_[0];
+  memcpy(header, "PRESIG:", 7);
+  header[7] = uint_to_chr_hex_nibble(ecc::g_ec_logic.GetPresigCount());
+  header[8] = '/';
+  header[9] = uint_to_chr_hex_nibble(ecc::kPresigPoolSize);
+  header[10] = '\0';
+
+  const char* labels[] = {"GEN:", "USED:", "MISS:"};
+  const uint32_t values[] = {stats.generated, stats.used, stats.missed};
+  for (int i = 0; i < 3; i++) {
+    char* line = menu_texts_[i + 1];
+    int len = strlen(labels[i]);
+    memcpy(line, labels[i], len);
+    uint_to_chr(&line[len], MENU_ENTRY_LEN - len, values[i]);
+  }
+
+  // "QUEUE:d/max", sign / verify jobs queued now and at most.
+  char* queue = menu_texts_[4];
+  memcpy(queue, "QUEUE:", 6);
+  queue[6] = uint_to_chr_hex_nibble(ecc::g_ec_logic.GetQueueDepth());
+  queue[7] = '/';
+  uint_to_chr(&queue[8], MENU_ENTRY_LEN - 8,
+              ecc::g_ec_logic.GetQueueStats().maxDepth);
+
+  for (int i = 0; i < MAX_MENU_ENTRIES; i++) {
+    menu_entries_[i].name = menu_texts_[i];
+    menu_entries_[i].app = nullptr;
+    menu_entries_[i].func = nullptr;
+  }
+  AdjustMenuPointer(menu_entries_, MAX_MENU_ENTRIES, true);
+  MenuApp::OnEntry();
+}
+
+void EccDebugApp::OnExit() { MenuApp::OnExit(); }
+
+#if SCHED_PROFILE
+TaskProfDebugApp::TaskProfDebugApp() : MenuApp(nullptr, 0) {}
+
+void TaskProfDebugApp::OnEntry() {
+  Profiler& profiler = scheduler.GetProfiler();
+
+  // Header "PROF:NN M:MMMM" with the number of profiled tasks and deadline
+  // misses.
+  char* header = menu_texts_[0];
+  memcpy(header, "PROF:", 5);
+  ByteToHex(profiler.size(), &header[5]);
+  memcpy(&header[7], " M:", 3);
+  uint16_t misses = scheduler.GetDeadlineMisses();
+  ByteToHex(misses >> 8, &header[10]);
+  ByteToHex(misses & 0xFF, &header[12]);
+  header[14] = '\0';
+
+  // Pick the tasks with the longest max execution time, slowest first.
+  // Format: "II E1234 W567" where II=profile index, E=max exec in us and
+  // W=max ready queue wait in us. The index matches the USB profile query.
+  uint8_t picked[MAX_MENU_ENTRIES - 1];
+  int menu_index = 1;
+  for (; menu_index < MAX_MENU_ENTRIES; menu_index++) {
+    int best = -1;
+    for (size_t i = 0; i < profiler.size(); i++) {
+      bool taken = false;
+      for (int j = 1; j < menu_index; j++) taken |= picked[j - 1] == i;
+      if (taken) continue;
+      if (best < 0 || profiler.Get(i).execMax > profiler.Get(best).execMax)
+        best = i;
+    }
+    if (best < 0) break;
+    picked[menu_index - 1] = best;
+
+    const TaskProfile& p = profiler.Get(best);
+    char* line = menu_texts_[menu_index];
+    ByteToHex(best, line);
+    line[2] = ' ';
+    line[3] = 'E';
+    int len = 4;
+    len += uint_to_chr(&line[len], 8, p.execMax / SysTimer::kCyclesPerUs);
+    line[len++] = ' ';
+    line[len++] = 'W';
+    uint_to_chr(&line[len], MENU_ENTRY_LEN - len,
+                p.waitMax / SysTimer::kCyclesPerUs);
+  }
+
+  for (int i = 0; i < menu_index; i++) {
+    menu_entries_[i].name = menu_texts_[i];
+    menu_entries_[i].app = nullptr;
+    menu_entries_[i].func = nullptr;
+  }
+  AdjustMenuPointer(menu_entries_, menu_index, true);
+  MenuApp::OnEntry();
+}
+
+void TaskProfDebugApp::OnExit() { MenuApp::OnExit(); }
+#endif
+
 }  // namespace hitcon
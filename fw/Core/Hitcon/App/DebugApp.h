@@ -57,12 +57,67 @@ class IrRetxDebugApp : public MenuApp {
 
 extern IrRetxDebugApp g_ir_retx_debug_app;
 
+// =========== ECC Debug App ===========
+
+class EccDebugApp : public MenuApp {
+ public:
+  static constexpr int MAX_MENU_ENTRIES = 5;
+  static constexpr int MENU_ENTRY_LEN = 16;
+
+  EccDebugApp();
+  virtual ~EccDebugApp() = default;
+
+  void OnEntry() override;
+  void OnExit() override;
+
+  void OnButtonMode() override {};
+  void OnButtonBack() override { badge_controller.BackToMenu(this); }
+  void OnButtonLongBack() override { badge_controller.BackToMenu(this); }
+
+ private:
+  char menu_texts_[MAX_MENU_ENTRIES][MENU_ENTRY_LEN];
+  menu_entry_t menu_entries_[MAX_MENU_ENTRIES];
+};
+
+extern EccDebugApp g_ecc_debug_app;
+
+#if SCHED_PROFILE
+// =========== Task Profile Debug App ===========
+
+class TaskProfDebugApp : public MenuApp {
+ public:
+  static constexpr int MAX_MENU_ENTRIES = 9;  // 1 header + top 8 tasks
+  static constexpr int MENU_ENTRY_LEN = 20;
+
+  TaskProfDebugApp();
+  virtual ~TaskProfDebugApp() = default;
+
+  void OnEntry() override;
+  void OnExit() override;
+
+  void OnButtonMode() override {};
+  void OnButtonBack() override { badge_controller.BackToMenu(this); }
+  void OnButtonLongBack() override { badge_controller.BackToMenu(this); }
+
+ private:
+  char menu_texts_[MAX_MENU_ENTRIES][MENU_ENTRY_LEN];
+  menu_entry_t menu_entries_[MAX_MENU_ENTRIES];
+};
+
+extern TaskProfDebugApp g_task_prof_debug_app;
+#endif
+
 // =========== Main Debug App ===========
 
 constexpr menu_entry_t debug_menu_entries[] = {
     {"Accel", &g_debug_accel_app, nullptr},
     {"IR Retx", &g_ir_retx_debug_app, nullptr},
-    {"IR Force Retx", &g_ir_force_retx_app, nullptr}};
+    {"IR Force Retx", &g_ir_force_retx_app, nullptr},
+    {"ECC", &g_ecc_debug_app, nullptr},
+#if SCHED_PROFILE
+    {"Task Prof", &g_task_prof_debug_app, nullptr},
+#endif
+};
 
 constexpr size_t debug_menu_entries_len =
     sizeof(debug_menu_entries) / sizeof(debug_menu_entries[0]);
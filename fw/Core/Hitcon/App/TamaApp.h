@@ -234,13 +234,14 @@ class TamaApp : public App {
  private:
   static constexpr unsigned ROUTINE_INTERVAL_MS =
       500;  // How often the Routine function runs
+  // Must be declared before _state, which is initialized from it.
+  tama_storage_t& _tama_data;
   TAMA_APP_STATE _state;
   TAMA_TYPE _current_selection_in_choose_mode;
   hitcon::service::sched::PeriodicTask _routine_task;
   hitcon::service::sched::DelayedTask _hatching_task;
   hitcon::service::sched::PeriodicTask _hunger_task;
   hitcon::service::sched::PeriodicTask _level_up_task;
-  tama_storage_t& _tama_data;
   tama_display_fb_t _fb;
   unsigned int _frame_count = 0;
   bool _is_selected = false;
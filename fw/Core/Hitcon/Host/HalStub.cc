@@ -0,0 +1,402 @@
+#ifdef HITCON_HOST_BUILD
+
+// Host implementation of the HAL surface used by the Hitcon layer.
+//
+// Peripherals are modelled just enough for the services to run:
+// - TIM driven DMA streams fire half/complete callbacks at the rate the real
+//   timers would (see kStreams below). Peripheral to memory streams sample the
+//   source register when a half is done.
+// - Flash is an anonymous mapping at the real flash address so NvStorage can
+//   read it directly. Program/erase complete through a deferred "interrupt".
+// - The IMU is a register file that answers WHO_AM_I.
+// - CRC is computed in software, same as the CRC unit (CRC-32/MPEG-2).
+// Everything else either completes after a fixed delay or does nothing.
+
+#include <Host/HalStub.h>
+#include <Host/VirtualClock.h>
+#include <adc.h>
+#include <crc.h>
+#include <i2c.h>
+#include <main.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <tim.h>
+#include <usart.h>
+#include <usb_device.h>
+#include <usbd_custom_hid_if.h>
+
+using namespace hitcon::host;
+
+GPIO_TypeDef host_gpioa, host_gpiob, host_gpioc;
+DWT_Type host_dwt;
+CoreDebug_Type host_core_debug;
+
+HostCycleCounter::operator uint32_t() const {
+  return static_cast<uint32_t>(g_virtual_clock.Now() * 12);
+}
+
+namespace {
+TIM_TypeDef tim1_regs, tim2_regs, tim3_regs, tim4_regs;
+USART_TypeDef usart2_regs;
+}  // namespace
+
+DMA_HandleTypeDef hdma_tim1_up;
+DMA_HandleTypeDef hdma_tim2_ch3;
+DMA_HandleTypeDef hdma_tim2_ch1;
+DMA_HandleTypeDef hdma_tim3_ch3;
+DMA_HandleTypeDef hdma_tim4_ch2;
+
+// Same prescaler/period as Core/Src/tim.c, HCLK is 12MHz.
+TIM_HandleTypeDef htim1 = {&tim1_regs, {5 - 1, 1500 - 1}, {&hdma_tim1_up}};
+TIM_HandleTypeDef htim2 = {&tim2_regs, {0, 4 - 1}, {}};
+TIM_HandleTypeDef htim3 = {&tim3_regs, {5 - 1, 63 - 1}, {}};
+TIM_HandleTypeDef htim4 = {&tim4_regs, {12000 - 1, 10 - 1}, {}};
+
+UART_HandleTypeDef huart2 = {&usart2_regs, HAL_UART_STATE_READY};
+ADC_HandleTypeDef hadc1;
+I2C_HandleTypeDef hi2c1;
+CRC_HandleTypeDef hcrc;
+USBD_HandleTypeDef hUsbDeviceFS;
+
+namespace {
+
+// ---------------------------------------------------------------- DMA
+
+struct DmaStream {
+  DMA_HandleTypeDef *hdma;
+  // Time per transferred element, in ns.
+  uint32_t elem_ns;
+  bool circular;
+  // Peripheral to memory? If so, the half that just completed is filled with
+  // the current value of the peripheral register.
+  bool to_memory;
+
+  bool running;
+  bool second_half;
+  uint64_t start_us;
+  uint64_t halves_done;
+  uint32_t src, dst, len;
+};
+
+DmaStream kStreams[] = {
+    // TIM1 update, 12MHz/5/1500 = 1600Hz. Display rows to GPIOB->BSRR.
+    {&hdma_tim1_up, 625000, true, false},
+    // TIM2 CC3, clocked by TIM3 TRGO/4, ~9.5kHz. GPIOA->IDR to IR rx buffer.
+    {&hdma_tim2_ch3, 105000, true, true},
+    // TIM3 CC3, 12MHz/5/63 ~= 38kHz. IR tx buffer to CCR3.
+    {&hdma_tim3_ch3, 26250, true, false},
+    // TIM4 CC2, 100Hz, normal mode. GPIOA->IDR to button buffer.
+    {&hdma_tim4_ch2, 10000000, false, true},
+};
+
+DmaStream *FindStream(DMA_HandleTypeDef *hdma) {
+  for (auto &s : kStreams) {
+    if (s.hdma == hdma) return &s;
+  }
+  return nullptr;
+}
+
+uint64_t NextHalfTime(DmaStream *s) {
+  uint64_t half_ns = static_cast<uint64_t>(s->len / 2) * s->elem_ns;
+  return s->start_us + ((s->halves_done + 1) * half_ns) / 1000;
+}
+
+void DmaEvent(void *arg) {
+  DmaStream *s = reinterpret_cast<DmaStream *>(arg);
+  if (!s->running) return;
+  bool second = s->second_half;
+  s->halves_done++;
+  s->second_half = !second;
+
+  if (s->to_memory) {
+    // All the rx streams on this board are 16-bit.
+    uint16_t *dst =
+        reinterpret_cast<uint16_t *>(static_cast<uintptr_t>(s->dst));
+    volatile uint32_t *src =
+        reinterpret_cast<volatile uint32_t *>(static_cast<uintptr_t>(s->src));
+    uint32_t half = s->len / 2;
+    uint16_t value = static_cast<uint16_t>(*src);
+    if (s->hdma == &hdma_tim2_ch3 && g_ir_rx_sampler) {
+      g_ir_rx_sampler(&dst[second ? half : 0], half);
+    } else {
+      for (uint32_t i = 0; i < half; i++) dst[(second ? half : 0) + i] = value;
+    }
+  } else if (s->hdma == &hdma_tim3_ch3 && g_ir_tx_observer) {
+    uint16_t *src =
+        reinterpret_cast<uint16_t *>(static_cast<uintptr_t>(s->src));
+    uint32_t half = s->len / 2;
+    g_ir_tx_observer(&src[second ? half : 0], half);
+  }
+
+  if (!second) {
+    g_virtual_clock.Schedule(NextHalfTime(s), &DmaEvent, s);
+    if (s->hdma->XferHalfCpltCallback) s->hdma->XferHalfCpltCallback(s->hdma);
+  } else {
+    if (s->circular) {
+      g_virtual_clock.Schedule(NextHalfTime(s), &DmaEvent, s);
+    } else {
+      s->running = false;
+    }
+    if (s->hdma->XferCpltCallback) s->hdma->XferCpltCallback(s->hdma);
+  }
+}
+
+// ---------------------------------------------------------------- Flash
+
+constexpr uint32_t kFlashBase = 0x08000000;
+constexpr uint32_t kFlashSize = 128 * 1024;
+// Roughly what the F103 datasheet quotes for word program and page erase.
+constexpr uint64_t kFlashProgramUs = 100;
+constexpr uint64_t kFlashEraseUs = 20000;
+
+void FlashDone(void *arg) {
+  HAL_FLASH_EndOfOperationCallback(
+      static_cast<uint32_t>(reinterpret_cast<uintptr_t>(arg)));
+}
+
+// ---------------------------------------------------------------- I2C (IMU)
+
+constexpr uint8_t kImuWhoAmI = 0x0F;
+constexpr uint8_t kImuCtrl3C = 0x12;
+// 100kHz, 9 bits per byte plus ~3 bytes of addressing overhead.
+constexpr uint64_t kI2cByteUs = 90;
+
+uint8_t imu_regs[256];
+pI2C_CallbackTypeDef i2c_mem_tx_cb, i2c_mem_rx_cb;
+
+void I2cTxDone(void *arg) {
+  I2C_HandleTypeDef *hi2c = reinterpret_cast<I2C_HandleTypeDef *>(arg);
+  if (i2c_mem_tx_cb) i2c_mem_tx_cb(hi2c);
+}
+
+void I2cRxDone(void *arg) {
+  I2C_HandleTypeDef *hi2c = reinterpret_cast<I2C_HandleTypeDef *>(arg);
+  if (i2c_mem_rx_cb) i2c_mem_rx_cb(hi2c);
+}
+
+// ---------------------------------------------------------------- Misc
+
+// 28800 baud, 10 bits per byte.
+constexpr uint64_t kUartByteUs = 347;
+constexpr uint64_t kAdcConvUs = 20;
+
+void UartTxDone(void *arg) {
+  HAL_UART_TxCpltCallback(reinterpret_cast<UART_HandleTypeDef *>(arg));
+}
+
+void AdcDone(void *arg) {
+  ADC_HandleTypeDef *hadc = reinterpret_cast<ADC_HandleTypeDef *>(arg);
+  if (hadc->ConvCpltCallback) hadc->ConvCpltCallback(hadc);
+}
+
+uint32_t adc_lcg = 0x12345678;
+
+}  // namespace
+
+namespace hitcon {
+namespace host {
+
+void (*g_ir_rx_sampler)(uint16_t *dst, size_t len) = nullptr;
+void (*g_ir_tx_observer)(const uint16_t *src, size_t len) = nullptr;
+
+void HalInit() {
+  void *flash = mmap(reinterpret_cast<void *>(kFlashBase), kFlashSize,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  if (flash != reinterpret_cast<void *>(kFlashBase)) {
+    perror("mmap flash");
+    abort();
+  }
+  memset(flash, 0xFF, kFlashSize);
+
+  // Buttons released (active low), IR receiver idle high, USB not attached.
+  host_gpioa.IDR = 0xFFFF;
+  host_gpiob.IDR = 0xFFFF;
+  host_gpioc.IDR = 0x0000;
+
+  imu_regs[kImuWhoAmI] = 0x6A;
+}
+
+}  // namespace host
+}  // namespace hitcon
+
+extern "C" {
+
+void Error_Handler(void) { abort(); }
+
+// There's only one thread of execution and "interrupts" only fire when the
+// virtual clock advances, so there's nothing to mask.
+void __disable_irq(void) {}
+void __enable_irq(void) {}
+void HAL_DBGMCU_EnableDBGSleepMode(void) {}
+
+uint32_t HAL_GetTick(void) {
+  return static_cast<uint32_t>(g_virtual_clock.Now() / 1000);
+}
+
+void HAL_Delay(uint32_t Delay) { g_virtual_clock.Advance(Delay * 1000ULL); }
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+  return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin,
+                       GPIO_PinState PinState) {
+  if (PinState == GPIO_PIN_SET)
+    GPIOx->ODR = GPIOx->ODR | GPIO_Pin;
+  else
+    GPIOx->ODR = GPIOx->ODR & ~static_cast<uint32_t>(GPIO_Pin);
+}
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress,
+                                   uint32_t DstAddress, uint32_t DataLength) {
+  DmaStream *s = FindStream(hdma);
+  if (!s) return HAL_ERROR;
+  g_virtual_clock.Cancel(&DmaEvent, s);
+  s->running = true;
+  s->second_half = false;
+  s->start_us = g_virtual_clock.Now();
+  s->halves_done = 0;
+  s->src = SrcAddress;
+  s->dst = DstAddress;
+  s->len = DataLength;
+  g_virtual_clock.Schedule(NextHalfTime(s), &DmaEvent, s);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim) {
+  htim->Instance->CR1 = htim->Instance->CR1 | 1;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+  htim->Instance->CR1 = htim->Instance->CR1 | 1;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop_DMA(TIM_HandleTypeDef *htim,
+                                       uint32_t Channel) {
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart,
+                                       const uint8_t *pData, uint16_t Size) {
+  g_virtual_clock.Schedule(g_virtual_clock.Now() + Size * kUartByteUs,
+                           &UartTxDone, huart);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart,
+                                      uint8_t *pData, uint16_t Size) {
+  // Nothing is ever connected.
+  huart->RxState = HAL_UART_STATE_BUSY_RX;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start_IT(ADC_HandleTypeDef *hadc) {
+  adc_lcg = adc_lcg * 1664525 + 1013904223;
+  hadc->Value = (adc_lcg >> 20) & 0xFFF;
+  g_virtual_clock.Schedule(g_virtual_clock.Now() + kAdcConvUs, &AdcDone, hadc);
+  return HAL_OK;
+}
+
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef *hadc) { return hadc->Value; }
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c) { return HAL_OK; }
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c) {
+  g_virtual_clock.Cancel(&I2cTxDone, hi2c);
+  g_virtual_clock.Cancel(&I2cRxDone, hi2c);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_RegisterCallback(I2C_HandleTypeDef *hi2c,
+                                           HAL_I2C_CallbackIDTypeDef CallbackID,
+                                           pI2C_CallbackTypeDef pCallback) {
+  switch (CallbackID) {
+    case HAL_I2C_MEM_TX_COMPLETE_CB_ID:
+      i2c_mem_tx_cb = pCallback;
+      break;
+    case HAL_I2C_MEM_RX_COMPLETE_CB_ID:
+      i2c_mem_rx_cb = pCallback;
+      break;
+    default:
+      break;
+  }
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c,
+                                       uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData,
+                                       uint16_t Size) {
+  for (uint16_t i = 0; i < Size; i++) {
+    imu_regs[(MemAddress + i) & 0xFF] = pData[i];
+  }
+  // SW_RESET clears itself once the reset is done.
+  imu_regs[kImuCtrl3C] &= ~0x01;
+  g_virtual_clock.Schedule(g_virtual_clock.Now() + (Size + 3) * kI2cByteUs,
+                           &I2cTxDone, hi2c);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c,
+                                      uint16_t DevAddress, uint16_t MemAddress,
+                                      uint16_t MemAddSize, uint8_t *pData,
+                                      uint16_t Size) {
+  for (uint16_t i = 0; i < Size; i++) {
+    pData[i] = imu_regs[(MemAddress + i) & 0xFF];
+  }
+  g_virtual_clock.Schedule(g_virtual_clock.Now() + (Size + 4) * kI2cByteUs,
+                           &I2cRxDone, hi2c);
+  return HAL_OK;
+}
+
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[],
+                           uint32_t BufferLength) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint32_t i = 0; i < BufferLength; i++) {
+    crc ^= pBuffer[i];
+    for (int j = 0; j < 32; j++) {
+      crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) { return HAL_OK; }
+
+HAL_StatusTypeDef HAL_FLASH_Program_IT(uint32_t TypeProgram, uint32_t Address,
+                                       uint64_t Data) {
+  if (Address < kFlashBase || Address + 4 > kFlashBase + kFlashSize)
+    return HAL_ERROR;
+  uint32_t *ptr = reinterpret_cast<uint32_t *>(static_cast<uintptr_t>(Address));
+  // Programming can only clear bits.
+  *ptr &= static_cast<uint32_t>(Data);
+  g_virtual_clock.Schedule(
+      g_virtual_clock.Now() + kFlashProgramUs, &FlashDone,
+      reinterpret_cast<void *>(static_cast<uintptr_t>(Address)));
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef *pEraseInit) {
+  uint32_t addr = pEraseInit->PageAddress;
+  uint32_t size = pEraseInit->NbPages * FLASH_PAGE_SIZE;
+  if (addr < kFlashBase || addr + size > kFlashBase + kFlashSize)
+    return HAL_ERROR;
+  memset(reinterpret_cast<void *>(static_cast<uintptr_t>(addr)), 0xFF, size);
+  g_virtual_clock.Schedule(g_virtual_clock.Now() + kFlashEraseUs, &FlashDone,
+                           reinterpret_cast<void *>(0xFFFFFFFFu));
+  return HAL_OK;
+}
+
+uint8_t USBD_CUSTOM_HID_SendReport(USBD_HandleTypeDef *pdev, uint8_t *report,
+                                   uint16_t len) {
+  return USBD_OK;
+}
+
+}  // extern "C"
+
+#endif  // HITCON_HOST_BUILD
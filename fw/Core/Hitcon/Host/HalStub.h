@@ -0,0 +1,25 @@
+#ifndef HITCON_HOST_HAL_STUB_H_
+#define HITCON_HOST_HAL_STUB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace hitcon {
+namespace host {
+
+// Map the emulated flash and put the GPIO inputs in their idle state.
+// Must be called before hitcon_run().
+void HalInit();
+
+// If set, called to fill each half of the IR rx DMA buffer instead of
+// sampling GPIOA->IDR. Each element is a GPIOA->IDR sample.
+extern void (*g_ir_rx_sampler)(uint16_t *dst, size_t len);
+
+// If set, called with each half of the IR tx DMA buffer (CCR3 values) once
+// it has been sent out.
+extern void (*g_ir_tx_observer)(const uint16_t *src, size_t len);
+
+}  // namespace host
+}  // namespace hitcon
+
+#endif  // HITCON_HOST_HAL_STUB_H_
@@ -0,0 +1,18 @@
+#ifndef HITCON_HOST_ADC_H_
+#define HITCON_HOST_ADC_H_
+
+// Host stand-in for the CubeMX generated adc.h, see Host/HalStub.cc.
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern ADC_HandleTypeDef hadc1;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HITCON_HOST_ADC_H_
@@ -0,0 +1,18 @@
+#ifndef HITCON_HOST_CRC_H_
+#define HITCON_HOST_CRC_H_
+
+// Host stand-in for the CubeMX generated crc.h, see Host/HalStub.cc.
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern CRC_HandleTypeDef hcrc;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HITCON_HOST_CRC_H_
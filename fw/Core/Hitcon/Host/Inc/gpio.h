@@ -0,0 +1,8 @@
+#ifndef HITCON_HOST_GPIO_H_
+#define HITCON_HOST_GPIO_H_
+
+// Host stand-in for the CubeMX generated gpio.h, see Host/HalStub.cc.
+
+#include "main.h"
+
+#endif  // HITCON_HOST_GPIO_H_
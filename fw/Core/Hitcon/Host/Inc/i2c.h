@@ -0,0 +1,18 @@
+#ifndef HITCON_HOST_I2C_H_
+#define HITCON_HOST_I2C_H_
+
+// Host stand-in for the CubeMX generated i2c.h, see Host/HalStub.cc.
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern I2C_HandleTypeDef hi2c1;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HITCON_HOST_I2C_H_
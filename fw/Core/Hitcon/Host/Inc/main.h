@@ -0,0 +1,91 @@
+#ifndef HITCON_HOST_MAIN_H_
+#define HITCON_HOST_MAIN_H_
+
+// Host stand-in for the CubeMX generated main.h, see Host/HalStub.cc.
+
+#include "stm32f1xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void Error_Handler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define USB_DET_Pin GPIO_PIN_14
+#define USB_DET_GPIO_Port GPIOC
+#define USB_DET_EXTI_IRQn EXTI15_10_IRQn
+#define IMU_PWR_Pin GPIO_PIN_15
+#define IMU_PWR_GPIO_Port GPIOC
+#define IrRx_Pin GPIO_PIN_0
+#define IrRx_GPIO_Port GPIOA
+#define BtnB_Pin GPIO_PIN_4
+#define BtnB_GPIO_Port GPIOA
+#define BtnC_Pin GPIO_PIN_5
+#define BtnC_GPIO_Port GPIOA
+#define BtnD_Pin GPIO_PIN_6
+#define BtnD_GPIO_Port GPIOA
+#define BtnE_Pin GPIO_PIN_7
+#define BtnE_GPIO_Port GPIOA
+#define IrTx_Pin GPIO_PIN_0
+#define IrTx_GPIO_Port GPIOB
+#define LedCh_Pin GPIO_PIN_1
+#define LedCh_GPIO_Port GPIOB
+#define LedCg_Pin GPIO_PIN_2
+#define LedCg_GPIO_Port GPIOB
+#define LedCf_Pin GPIO_PIN_10
+#define LedCf_GPIO_Port GPIOB
+#define LedCe_Pin GPIO_PIN_11
+#define LedCe_GPIO_Port GPIOB
+#define LedCd_Pin GPIO_PIN_12
+#define LedCd_GPIO_Port GPIOB
+#define LedCc_Pin GPIO_PIN_13
+#define LedCc_GPIO_Port GPIOB
+#define LedCb_Pin GPIO_PIN_14
+#define LedCb_GPIO_Port GPIOB
+#define LedCa_Pin GPIO_PIN_15
+#define LedCa_GPIO_Port GPIOB
+#define BtnF_Pin GPIO_PIN_8
+#define BtnF_GPIO_Port GPIOA
+#define BtnG_Pin GPIO_PIN_9
+#define BtnG_GPIO_Port GPIOA
+#define BtnH_Pin GPIO_PIN_10
+#define BtnH_GPIO_Port GPIOA
+#define UsbDm_Pin GPIO_PIN_11
+#define UsbDm_GPIO_Port GPIOA
+#define UsbDp_Pin GPIO_PIN_12
+#define UsbDp_GPIO_Port GPIOA
+#define BtnA_Pin GPIO_PIN_15
+#define BtnA_GPIO_Port GPIOA
+#define LedA0_GPIO_Port GPIOB
+#define LedA1_GPIO_Port GPIOB
+#define DEC_EN_GPIO_Port GPIOB
+#define LedA2_Pin GPIO_PIN_8
+#define LedA2_GPIO_Port GPIOB
+#define LedA3_Pin GPIO_PIN_9
+#define LedA3_GPIO_Port GPIOB
+
+#if defined(V1_1)
+#undef USB_DET_Pin
+#undef USB_DET_GPIO_Port
+#undef USB_DET_EXTI_IRQn
+#define USB_DET_Pin GPIO_PIN_3
+#define USB_DET_GPIO_Port GPIOB
+#define USB_DET_EXTI_IRQn EXTI3_IRQn
+#define LedA0_Pin GPIO_PIN_6
+#define LedA1_Pin GPIO_PIN_7
+#define DEC_EN_Pin GPIO_PIN_5
+#elif defined(V2_0)
+#define LedA0_Pin GPIO_PIN_3
+#define LedA1_Pin GPIO_PIN_4
+#define DEC_EN_Pin GPIO_PIN_5
+#elif defined(V2_1) || defined(V2_2)
+#define LedA0_Pin GPIO_PIN_3
+#define LedA1_Pin GPIO_PIN_5
+#define DEC_EN_Pin GPIO_PIN_4
+#endif
+
+#endif  // HITCON_HOST_MAIN_H_
@@ -0,0 +1,251 @@
+#ifndef HITCON_HOST_STM32F1XX_HAL_H_
+#define HITCON_HOST_STM32F1XX_HAL_H_
+
+// Host stand-in for the STM32F1 HAL. Only the types, fields and functions that
+// the Hitcon layer touches are provided. Peripherals don't do anything on
+// their own, the DMA/IRQ callbacks are driven by Host/HalStub.cc.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define __IO volatile
+
+typedef enum {
+  HAL_OK = 0x00U,
+  HAL_ERROR = 0x01U,
+  HAL_BUSY = 0x02U,
+  HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum { GPIO_PIN_RESET = 0u, GPIO_PIN_SET } GPIO_PinState;
+
+#define GPIO_PIN_0 ((uint16_t)0x0001)
+#define GPIO_PIN_1 ((uint16_t)0x0002)
+#define GPIO_PIN_2 ((uint16_t)0x0004)
+#define GPIO_PIN_3 ((uint16_t)0x0008)
+#define GPIO_PIN_4 ((uint16_t)0x0010)
+#define GPIO_PIN_5 ((uint16_t)0x0020)
+#define GPIO_PIN_6 ((uint16_t)0x0040)
+#define GPIO_PIN_7 ((uint16_t)0x0080)
+#define GPIO_PIN_8 ((uint16_t)0x0100)
+#define GPIO_PIN_9 ((uint16_t)0x0200)
+#define GPIO_PIN_10 ((uint16_t)0x0400)
+#define GPIO_PIN_11 ((uint16_t)0x0800)
+#define GPIO_PIN_12 ((uint16_t)0x1000)
+#define GPIO_PIN_13 ((uint16_t)0x2000)
+#define GPIO_PIN_14 ((uint16_t)0x4000)
+#define GPIO_PIN_15 ((uint16_t)0x8000)
+
+typedef struct {
+  __IO uint32_t CRL;
+  __IO uint32_t CRH;
+  __IO uint32_t IDR;
+  __IO uint32_t ODR;
+  __IO uint32_t BSRR;
+  __IO uint32_t BRR;
+  __IO uint32_t LCKR;
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef host_gpioa, host_gpiob, host_gpioc;
+#define GPIOA (&host_gpioa)
+#define GPIOB (&host_gpiob)
+#define GPIOC (&host_gpioc)
+
+typedef enum { EXTI3_IRQn = 9, EXTI15_10_IRQn = 40 } IRQn_Type;
+
+#ifdef __cplusplus
+// Reads follow the virtual clock at 12MHz HCLK, writes are ignored.
+struct HostCycleCounter {
+  operator uint32_t() const;
+  HostCycleCounter &operator=(uint32_t) { return *this; }
+};
+
+typedef struct {
+  __IO uint32_t CTRL;
+  HostCycleCounter CYCCNT;
+} DWT_Type;
+
+typedef struct {
+  __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type host_dwt;
+extern CoreDebug_Type host_core_debug;
+#define DWT (&host_dwt)
+#define CoreDebug (&host_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#endif
+
+typedef struct __DMA_HandleTypeDef {
+  void *Instance;
+  void (*XferCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+  void (*XferHalfCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+  void (*XferErrorCallback)(struct __DMA_HandleTypeDef *hdma);
+} DMA_HandleTypeDef;
+
+typedef struct {
+  __IO uint32_t CR1;
+  __IO uint32_t DIER;
+  __IO uint32_t CCR1;
+  __IO uint32_t CCR2;
+  __IO uint32_t CCR3;
+  __IO uint32_t CCR4;
+} TIM_TypeDef;
+
+typedef struct {
+  uint32_t Prescaler;
+  uint32_t Period;
+} TIM_Base_InitTypeDef;
+
+#define TIM_DMA_ID_UPDATE ((uint16_t)0x0000)
+#define TIM_DMA_ID_CC1 ((uint16_t)0x0001)
+#define TIM_DMA_ID_CC2 ((uint16_t)0x0002)
+#define TIM_DMA_ID_CC3 ((uint16_t)0x0003)
+#define TIM_DMA_ID_CC4 ((uint16_t)0x0004)
+
+typedef struct {
+  TIM_TypeDef *Instance;
+  TIM_Base_InitTypeDef Init;
+  DMA_HandleTypeDef *hdma[7];
+} TIM_HandleTypeDef;
+
+#define TIM_CHANNEL_1 0x00000000U
+#define TIM_CHANNEL_2 0x00000004U
+#define TIM_CHANNEL_3 0x00000008U
+#define TIM_CHANNEL_4 0x0000000CU
+
+#define TIM_DMA_UPDATE 0x00000100U
+#define TIM_DMA_CC1 0x00000200U
+#define TIM_DMA_CC2 0x00000400U
+#define TIM_DMA_CC3 0x00000800U
+
+#define __HAL_TIM_ENABLE_DMA(__HANDLE__, __DMA__) \
+  ((__HANDLE__)->Instance->DIER |= (__DMA__))
+#define __HAL_TIM_SET_COMPARE(__HANDLE__, __CHANNEL__, __COMPARE__) \
+  (*(__IO uint32_t *)(&((__HANDLE__)->Instance->CCR1) +             \
+                      ((__CHANNEL__) >> 2U)) = (__COMPARE__))
+
+typedef struct {
+  __IO uint32_t SR;
+  __IO uint32_t DR;
+} USART_TypeDef;
+
+typedef enum {
+  HAL_UART_STATE_RESET = 0x00U,
+  HAL_UART_STATE_READY = 0x20U,
+  HAL_UART_STATE_BUSY_RX = 0x22U
+} HAL_UART_StateTypeDef;
+
+typedef struct __UART_HandleTypeDef {
+  USART_TypeDef *Instance;
+  __IO HAL_UART_StateTypeDef RxState;
+} UART_HandleTypeDef;
+
+typedef struct __ADC_HandleTypeDef {
+  uint32_t Value;
+  void (*ConvCpltCallback)(struct __ADC_HandleTypeDef *hadc);
+} ADC_HandleTypeDef;
+
+typedef enum {
+  HAL_I2C_MASTER_TX_COMPLETE_CB_ID = 0x00U,
+  HAL_I2C_MASTER_RX_COMPLETE_CB_ID = 0x01U,
+  HAL_I2C_MEM_TX_COMPLETE_CB_ID = 0x06U,
+  HAL_I2C_MEM_RX_COMPLETE_CB_ID = 0x07U,
+  HAL_I2C_ERROR_CB_ID = 0x08U,
+} HAL_I2C_CallbackIDTypeDef;
+
+typedef struct __I2C_HandleTypeDef {
+  void (*MemTxCpltCallback)(struct __I2C_HandleTypeDef *hi2c);
+  void (*MemRxCpltCallback)(struct __I2C_HandleTypeDef *hi2c);
+  void (*MasterTxCpltCallback)(struct __I2C_HandleTypeDef *hi2c);
+  void (*MasterRxCpltCallback)(struct __I2C_HandleTypeDef *hi2c);
+  void (*ErrorCallback)(struct __I2C_HandleTypeDef *hi2c);
+} I2C_HandleTypeDef;
+
+typedef void (*pI2C_CallbackTypeDef)(I2C_HandleTypeDef *hi2c);
+
+#define I2C_MEMADD_SIZE_8BIT 0x00000001U
+
+typedef struct {
+  uint32_t State;
+} CRC_HandleTypeDef;
+
+typedef struct {
+  uint32_t TypeErase;
+  uint32_t Banks;
+  uint32_t PageAddress;
+  uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+#define FLASH_TYPEERASE_PAGES 0x00U
+#define FLASH_TYPEPROGRAM_WORD 0x02U
+#define FLASH_PAGE_SIZE 0x400U
+
+void __disable_irq(void);
+void __enable_irq(void);
+void HAL_DBGMCU_EnableDBGSleepMode(void);
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin,
+                       GPIO_PinState PinState);
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress,
+                                   uint32_t DstAddress, uint32_t DataLength);
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop_DMA(TIM_HandleTypeDef *htim,
+                                       uint32_t Channel);
+void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim);
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart,
+                                       const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart,
+                                      uint8_t *pData, uint16_t Size);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+void HAL_UART_AbortCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_AbortReceiveCpltCallback(UART_HandleTypeDef *huart);
+
+HAL_StatusTypeDef HAL_ADC_Start_IT(ADC_HandleTypeDef *hadc);
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef *hadc);
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_RegisterCallback(I2C_HandleTypeDef *hi2c,
+                                           HAL_I2C_CallbackIDTypeDef CallbackID,
+                                           pI2C_CallbackTypeDef pCallback);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c,
+                                       uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData,
+                                       uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c,
+                                      uint16_t DevAddress, uint16_t MemAddress,
+                                      uint16_t MemAddSize, uint8_t *pData,
+                                      uint16_t Size);
+
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[],
+                           uint32_t BufferLength);
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Program_IT(uint32_t TypeProgram, uint32_t Address,
+                                       uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef *pEraseInit);
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue);
+void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HITCON_HOST_STM32F1XX_HAL_H_
@@ -0,0 +1,9 @@
+#ifndef HITCON_HOST_STM32F1XX_HAL_I2C_H_
+#define HITCON_HOST_STM32F1XX_HAL_I2C_H_
+
+// Host stand-in for the CubeMX generated stm32f1xx_hal_i2c.h, see
+// Host/HalStub.cc.
+
+#include "stm32f1xx_hal.h"
+
+#endif  // HITCON_HOST_STM32F1XX_HAL_I2C_H_
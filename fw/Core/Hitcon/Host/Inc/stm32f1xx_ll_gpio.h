@@ -0,0 +1,11 @@
+#ifndef HITCON_HOST_STM32F1XX_LL_GPIO_H_
+#define HITCON_HOST_STM32F1XX_LL_GPIO_H_
+
+// Host stand-in for the CubeMX generated stm32f1xx_ll_gpio.h, see
+// Host/HalStub.cc.
+
+#include "stm32f1xx_hal.h"
+
+static inline void LL_GPIO_AF_RemapPartial2_TIM2(void) {}
+
+#endif  // HITCON_HOST_STM32F1XX_LL_GPIO_H_
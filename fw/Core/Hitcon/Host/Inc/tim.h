@@ -0,0 +1,26 @@
+#ifndef HITCON_HOST_TIM_H_
+#define HITCON_HOST_TIM_H_
+
+// Host stand-in for the CubeMX generated tim.h, see Host/HalStub.cc.
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern TIM_HandleTypeDef htim1;
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim3;
+extern TIM_HandleTypeDef htim4;
+
+extern DMA_HandleTypeDef hdma_tim2_ch3;
+extern DMA_HandleTypeDef hdma_tim2_ch1;
+extern DMA_HandleTypeDef hdma_tim3_ch3;
+extern DMA_HandleTypeDef hdma_tim4_ch2;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HITCON_HOST_TIM_H_
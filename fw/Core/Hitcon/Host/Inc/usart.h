@@ -0,0 +1,18 @@
+#ifndef HITCON_HOST_USART_H_
+#define HITCON_HOST_USART_H_
+
+// Host stand-in for the CubeMX generated usart.h, see Host/HalStub.cc.
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern UART_HandleTypeDef huart2;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HITCON_HOST_USART_H_
@@ -0,0 +1,18 @@
+#ifndef HITCON_HOST_USB_DEVICE_H_
+#define HITCON_HOST_USB_DEVICE_H_
+
+// Host stand-in for the CubeMX generated usb_device.h, see Host/HalStub.cc.
+
+#include "usbd_def.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HITCON_HOST_USB_DEVICE_H_
@@ -0,0 +1,10 @@
+#ifndef HITCON_HOST_USBD_CONF_H_
+#define HITCON_HOST_USBD_CONF_H_
+
+// Host stand-in for the CubeMX generated usbd_conf.h, see Host/HalStub.cc.
+
+#include "usbd_def.h"
+
+#define USBD_CUSTOMHID_OUTREPORT_BUF_SIZE 9U
+
+#endif  // HITCON_HOST_USBD_CONF_H_
@@ -0,0 +1,20 @@
+#ifndef HITCON_HOST_USBD_CUSTOM_HID_IF_H_
+#define HITCON_HOST_USBD_CUSTOM_HID_IF_H_
+
+// Host stand-in for the CubeMX generated usbd_custom_hid_if.h, see
+// Host/HalStub.cc.
+
+#include "usbd_conf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint8_t USBD_CUSTOM_HID_SendReport(USBD_HandleTypeDef *pdev, uint8_t *report,
+                                   uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HITCON_HOST_USBD_CUSTOM_HID_IF_H_
@@ -0,0 +1,26 @@
+#ifndef HITCON_HOST_USBD_DEF_H_
+#define HITCON_HOST_USBD_DEF_H_
+
+// Host stand-in for the CubeMX generated usbd_def.h, see Host/HalStub.cc.
+
+#include <stdint.h>
+
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+typedef enum {
+  USBD_OK = 0U,
+  USBD_BUSY,
+  USBD_EMEM,
+  USBD_FAIL,
+} USBD_StatusTypeDef;
+
+typedef struct _USBD_HandleTypeDef {
+  uint8_t dev_state;
+} USBD_HandleTypeDef;
+
+#endif  // HITCON_HOST_USBD_DEF_H_
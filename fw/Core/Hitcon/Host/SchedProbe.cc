@@ -0,0 +1,243 @@
+#ifdef HITCON_HOST_BUILD
+
+#include <Host/SchedProbe.h>
+#include <Host/VirtualClock.h>
+#include <Service/Sched/Scheduler.h>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace hitcon::service::sched;
+
+namespace hitcon {
+namespace host {
+
+namespace {
+
+uint64_t HostNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+}  // namespace
+
+SchedProbe g_sched_probe;
+
+SchedProbe::SchedProbe()
+    : stop_time(UINT64_MAX), stop_when_idle(false), task_cost_us(30),
+      task_host_scale(0), idle_time(0), dispatches(0), budget_queries(0),
+      ready_depth_max(0), delayed_depth_max(0) {}
+
+void SchedProbe::OnQueued(Task *task, uint64_t ready_time) {
+  TaskStats &s = stats[task];
+  s.pending = true;
+  s.ready_time = ready_time;
+}
+
+void SchedProbe::OnWoken(Task *task, uint64_t wake_time) {
+  TaskStats &s = stats[task];
+  // A re-enabled periodic task keeps its stale wake time, count from when it
+  // was enabled instead.
+  if (!s.pending || s.ready_time < wake_time) s.ready_time = wake_time;
+  s.pending = true;
+}
+
+void SchedProbe::OnStart(Task *task, size_t ready_depth,
+                         size_t delayed_depth) {
+  TaskStats &s = stats[task];
+  uint64_t now = g_virtual_clock.Now();
+  if (s.pending) {
+    uint64_t latency = now > s.ready_time ? now - s.ready_time : 0;
+    s.latency_sum += latency;
+    s.latency_max = std::max(s.latency_max, latency);
+    s.pending = false;
+  }
+  s.ready_depth_max = std::max(s.ready_depth_max, ready_depth);
+  ready_depth_max = std::max(ready_depth_max, ready_depth);
+  delayed_depth_max = std::max(delayed_depth_max, delayed_depth);
+  s.start_time = now;
+  s.step_time = now;
+  s.host_start_ns = HostNs();
+}
+
+void SchedProbe::ChargeStep(TaskStats &s) {
+  uint64_t host_ns = HostNs() - s.host_start_ns;
+  s.host_ns_sum += host_ns;
+  uint64_t cost =
+      task_cost_us + static_cast<uint64_t>(host_ns * task_host_scale / 1000);
+  // The task may have advanced the clock itself (HAL_Delay).
+  uint64_t end = std::max(g_virtual_clock.Now(), s.step_time + cost);
+  g_virtual_clock.AdvanceTo(end);
+  s.step_time = end;
+  s.host_start_ns = HostNs();
+}
+
+void SchedProbe::OnBudgetQuery(Task *task) {
+  if (!task) return;
+  TaskStats &s = stats[task];
+  ChargeStep(s);
+  s.budget_queries++;
+  budget_queries++;
+}
+
+void SchedProbe::OnEnd(Task *task) {
+  TaskStats &s = stats[task];
+  ChargeStep(s);
+  uint64_t end = s.step_time;
+  uint64_t exec = end - s.start_time;
+  s.runs++;
+  s.exec_sum += exec;
+  s.exec_max = std::max(s.exec_max, exec);
+  dispatches++;
+}
+
+void SchedProbe::OnIdle(bool has_delayed, uint64_t next_wake) {
+  uint64_t now = g_virtual_clock.Now();
+  if (stop_when_idle) {
+    stop_time = now;
+    return;
+  }
+  uint64_t target = std::min(g_virtual_clock.NextEvent(), stop_time);
+  if (has_delayed) target = std::min(target, next_wake);
+  if (target <= now) {
+    // A delayed task is due within the current millisecond tick.
+    target = (now / 1000 + 1) * 1000;
+  }
+  idle_time += target - now;
+  g_virtual_clock.AdvanceTo(target);
+}
+
+bool SchedProbe::ShouldStop() { return g_virtual_clock.Now() >= stop_time; }
+
+void DescribeAddress(const void *ptr, char *buf, size_t len) {
+  Dl_info info;
+  if (!dladdr(ptr, &info) || !info.dli_sname) {
+    snprintf(buf, len, "%p", ptr);
+    return;
+  }
+  int status = 0;
+  char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr,
+                                        &status);
+  const char *name = status == 0 ? demangled : info.dli_sname;
+  size_t off = reinterpret_cast<const char *>(ptr) -
+               reinterpret_cast<const char *>(info.dli_saddr);
+  if (off)
+    snprintf(buf, len, "%s+0x%zx", name, off);
+  else
+    snprintf(buf, len, "%s", name);
+  free(demangled);
+}
+
+void SchedProbe::Report(FILE *out) {
+  uint64_t total = g_virtual_clock.Now();
+  fprintf(out,
+          "virtual time %llu.%03llu ms, %llu dispatches, %llu budget steps, "
+          "idle %.1f%%\n",
+          (unsigned long long)(total / 1000),
+          (unsigned long long)(total % 1000), (unsigned long long)dispatches,
+          (unsigned long long)budget_queries,
+          total ? idle_time * 100.0 / total : 0.0);
+  // As the firmware counts it, to ms precision.
+  uint32_t idle_ms = scheduler.GetIdleTime();
+  fprintf(out, "scheduler idle %u ms in %u sleeps, duty cycle %.1f%%\n",
+          (unsigned)idle_ms, (unsigned)scheduler.GetIdleCount(),
+          total ? 100.0 - idle_ms * 100000.0 / total : 0.0);
+  fprintf(out, "max ready queue depth %zu, max delayed queue depth %zu\n",
+          ready_depth_max, delayed_depth_max);
+
+  std::vector<std::pair<std::string, const TaskStats *>> rows;
+  for (auto &it : stats) {
+    char name[96];
+    DescribeAddress(it.first, name, sizeof(name));
+    rows.push_back({name, &it.second});
+  }
+  std::sort(rows.begin(), rows.end());
+
+  fprintf(out, "%-44s %8s %9s %9s %9s %9s %5s\n", "task", "runs", "lat avg",
+          "lat max", "exec avg", "exec max", "depth");
+  for (auto &row : rows) {
+    const TaskStats &s = *row.second;
+    if (!s.runs) continue;
+    fprintf(out, "%-44s %8u %9llu %9llu %9llu %9llu %5zu\n", row.first.c_str(),
+            s.runs, (unsigned long long)(s.latency_sum / s.runs),
+            (unsigned long long)s.latency_max,
+            (unsigned long long)(s.exec_sum / s.runs),
+            (unsigned long long)s.exec_max, s.ready_depth_max);
+  }
+
+  const DeadlineMiss &miss = scheduler.GetLastDeadlineMiss();
+  fprintf(out, "add queue overflows %u, deadline misses %u\n",
+          (unsigned)scheduler.GetQueueOverflows(),
+          (unsigned)scheduler.GetDeadlineMisses());
+  if (miss.task) {
+    char name[96], offender[96];
+    DescribeAddress(miss.task, name, sizeof(name));
+    DescribeAddress(miss.offender, offender, sizeof(offender));
+    fprintf(out, "last miss at %u ms: %s, %u us late, longest run %s %u us\n",
+            (unsigned)miss.time, name, miss.lateCycles / 12, offender,
+            miss.offenderCycles / 12);
+  }
+
+#if SCHED_PROFILE
+  // What the firmware profiler saw, in us. It should agree with the table
+  // above, wait is counted from entering the ready heap.
+  Profiler &profiler = scheduler.GetProfiler();
+  fprintf(out, "\nfirmware profile (%zu entries)\n", profiler.size());
+  fprintf(out, "%-44s %8s %9s %9s %9s %9s %6s\n", "task", "runs", "wait avg",
+          "wait max", "exec avg", "exec max", "misses");
+  for (size_t i = 0; i < profiler.size(); i++) {
+    const TaskProfile &p = profiler.Get(i);
+    char name[96];
+    if (p.task)
+      DescribeAddress(p.task, name, sizeof(name));
+    else
+      snprintf(name, sizeof(name), "(other)");
+    fprintf(out, "%-44s %8u %9llu %9u %9llu %9u %6u\n", name,
+            (unsigned)p.runs, (unsigned long long)(p.waitTotal / p.runs / 12),
+            p.waitMax / 12, (unsigned long long)(p.execTotal / p.runs / 12),
+            p.execMax / 12, (unsigned)p.misses);
+  }
+#endif
+}
+
+}  // namespace host
+
+namespace service {
+namespace sched {
+
+void HostOnTaskQueued(Task *task) {
+  host::g_sched_probe.OnQueued(task, host::g_virtual_clock.Now());
+}
+
+void HostOnTaskWoken(DelayedTask *task, unsigned wakeTime) {
+  host::g_sched_probe.OnWoken(task, wakeTime * 1000ULL);
+}
+
+void HostOnTaskStart(Task *task, size_t readyDepth, size_t delayedDepth) {
+  host::g_sched_probe.OnStart(task, readyDepth, delayedDepth);
+}
+
+void HostOnTaskEnd(Task *task) { host::g_sched_probe.OnEnd(task); }
+
+void HostOnIdle(bool hasDelayed, unsigned nextWake) {
+  host::g_sched_probe.OnIdle(hasDelayed, nextWake * 1000ULL);
+}
+
+bool HostShouldStop() { return host::g_sched_probe.ShouldStop(); }
+
+void HostOnBudgetQuery(Task *task) {
+  host::g_sched_probe.OnBudgetQuery(task);
+}
+
+}  // namespace sched
+}  // namespace service
+}  // namespace hitcon
+
+#endif  // HITCON_HOST_BUILD
@@ -0,0 +1,101 @@
+#ifndef HITCON_HOST_SCHED_PROBE_H_
+#define HITCON_HOST_SCHED_PROBE_H_
+
+#include <Service/Sched/Task.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+
+namespace hitcon {
+namespace host {
+
+// Collects per task statistics from the scheduler hooks and charges each
+// dispatch to the virtual clock.
+class SchedProbe {
+ public:
+  struct TaskStats {
+    uint32_t runs = 0;
+    // Time from becoming ready (queued, or wake time for delayed tasks) until
+    // the dispatch, in us.
+    uint64_t latency_sum = 0;
+    uint64_t latency_max = 0;
+    // Virtual execution time, in us.
+    uint64_t exec_sum = 0;
+    uint64_t exec_max = 0;
+    // Host execution time, in ns.
+    uint64_t host_ns_sum = 0;
+    // Tasks waiting in the ready heap when this one was dispatched.
+    size_t ready_depth_max = 0;
+
+    bool pending = false;
+    uint64_t ready_time = 0;
+    uint64_t start_time = 0;
+    // Start of the current step, the dispatch or the last budget query.
+    uint64_t step_time = 0;
+    uint64_t host_start_ns = 0;
+    // RemainingBudget() calls.
+    uint32_t budget_queries = 0;
+  };
+
+  SchedProbe();
+
+  // Run() returns once the virtual clock reaches this, in us.
+  void SetStopTime(uint64_t us) { stop_time = us; }
+
+  // If set, Run() returns as soon as there's nothing ready to run, without
+  // advancing the virtual clock. For a caller that fires the events itself.
+  void SetStopWhenIdle(bool stop) { stop_when_idle = stop; }
+
+  // Each dispatch, and each step between RemainingBudget() calls within it,
+  // costs fixed_us plus the host execution time multiplied by host_scale
+  // (host ns -> target ns).
+  void SetTaskCost(uint32_t fixed_us, double host_scale) {
+    task_cost_us = fixed_us;
+    task_host_scale = host_scale;
+  }
+
+  void OnQueued(service::sched::Task *task, uint64_t ready_time);
+  void OnWoken(service::sched::Task *task, uint64_t wake_time);
+  void OnStart(service::sched::Task *task, size_t ready_depth,
+               size_t delayed_depth);
+  void OnEnd(service::sched::Task *task);
+  void OnBudgetQuery(service::sched::Task *task);
+  void OnIdle(bool has_delayed, uint64_t next_wake);
+  bool ShouldStop();
+
+  const std::map<service::sched::Task *, TaskStats> &GetStats() {
+    return stats;
+  }
+  uint64_t GetIdleTime() { return idle_time; }
+  uint64_t GetDispatches() { return dispatches; }
+  uint64_t GetBudgetQueries() { return budget_queries; }
+
+  void Report(FILE *out);
+
+ private:
+  // Advances the virtual clock by the cost of the step s is in.
+  void ChargeStep(TaskStats &s);
+
+  std::map<service::sched::Task *, TaskStats> stats;
+  uint64_t stop_time;
+  bool stop_when_idle;
+  uint32_t task_cost_us;
+  double task_host_scale;
+  uint64_t idle_time;
+  uint64_t dispatches;
+  uint64_t budget_queries;
+  size_t ready_depth_max;
+  size_t delayed_depth_max;
+};
+
+extern SchedProbe g_sched_probe;
+
+// Symbol name of the object at ptr, e.g. "hitcon::ir::irService+0x48".
+void DescribeAddress(const void *ptr, char *buf, size_t len);
+
+}  // namespace host
+}  // namespace hitcon
+
+#endif  // HITCON_HOST_SCHED_PROBE_H_
@@ -0,0 +1,69 @@
+#ifdef HITCON_HOST_BUILD
+
+#include <Host/VirtualClock.h>
+#include <Service/Sched/Checks.h>
+
+using namespace hitcon::service::sched;
+
+namespace hitcon {
+namespace host {
+
+VirtualClock g_virtual_clock;
+
+VirtualClock::VirtualClock()
+    : now(0), next_seq(0), events_fired(0), event_count(0) {}
+
+bool VirtualClock::Schedule(uint64_t when, event_callback_t cb, void *arg) {
+  if (event_count >= kMaxEvents) {
+    AssertOverflow();
+    return false;
+  }
+  if (when < now) when = now;
+  events[event_count++] = {when, next_seq++, cb, arg};
+  return true;
+}
+
+void VirtualClock::Cancel(event_callback_t cb, void *arg) {
+  for (size_t i = 0; i < event_count;) {
+    if (events[i].cb == cb && events[i].arg == arg) {
+      events[i] = events[--event_count];
+    } else {
+      i++;
+    }
+  }
+}
+
+uint64_t VirtualClock::NextEvent() {
+  uint64_t ret = UINT64_MAX;
+  for (size_t i = 0; i < event_count; i++) {
+    if (events[i].when < ret) ret = events[i].when;
+  }
+  return ret;
+}
+
+void VirtualClock::AdvanceTo(uint64_t when) {
+  while (true) {
+    // Few events are ever pending, a linear scan is good enough.
+    size_t best = event_count;
+    for (size_t i = 0; i < event_count; i++) {
+      if (events[i].when > when) continue;
+      if (best == event_count || events[i].when < events[best].when ||
+          (events[i].when == events[best].when &&
+           events[i].seq < events[best].seq)) {
+        best = i;
+      }
+    }
+    if (best == event_count) break;
+    Event ev = events[best];
+    events[best] = events[--event_count];
+    if (ev.when > now) now = ev.when;
+    events_fired++;
+    ev.cb(ev.arg);
+  }
+  if (when > now) now = when;
+}
+
+}  // namespace host
+}  // namespace hitcon
+
+#endif  // HITCON_HOST_BUILD
@@ -0,0 +1,62 @@
+#ifndef HITCON_HOST_VIRTUAL_CLOCK_H_
+#define HITCON_HOST_VIRTUAL_CLOCK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace hitcon {
+namespace host {
+
+typedef void (*event_callback_t)(void *arg);
+
+// Microsecond resolution virtual time for the host build.
+// HAL_GetTick() (and thus SysTimer::GetTime()) is derived from this, and all
+// "interrupts" (DMA half/complete, flash, I2C...) are one-shot events that
+// fire when the clock is advanced past them.
+class VirtualClock {
+ public:
+  static constexpr size_t kMaxEvents = 32;
+
+  VirtualClock();
+
+  uint64_t Now() { return now; }
+
+  // Schedule cb(arg) to be called at absolute time `when`. Events with the
+  // same time fire in the order they were scheduled.
+  bool Schedule(uint64_t when, event_callback_t cb, void *arg);
+
+  // Drop any pending event with the matching cb and arg.
+  void Cancel(event_callback_t cb, void *arg);
+
+  // Time of the earliest pending event, or UINT64_MAX if there's none.
+  uint64_t NextEvent();
+
+  // Move the clock forward to `when`, firing every event due on the way.
+  // Callbacks are allowed to schedule more events.
+  void AdvanceTo(uint64_t when);
+  void Advance(uint64_t delta) { AdvanceTo(now + delta); }
+
+  // How many events have fired.
+  size_t GetEventsFired() { return events_fired; }
+
+ private:
+  struct Event {
+    uint64_t when;
+    uint64_t seq;
+    event_callback_t cb;
+    void *arg;
+  };
+
+  uint64_t now;
+  uint64_t next_seq;
+  size_t events_fired;
+  Event events[kMaxEvents];
+  size_t event_count;
+};
+
+extern VirtualClock g_virtual_clock;
+
+}  // namespace host
+}  // namespace hitcon
+
+#endif  // HITCON_HOST_VIRTUAL_CLOCK_H_
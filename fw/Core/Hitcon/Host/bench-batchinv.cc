@@ -0,0 +1,134 @@
+#ifdef HITCON_HOST_BUILD
+
+// Times BatchInvService driven by the real scheduler, for batches of 1 up to
+// kBatchInvSize inversions mod the curve order. Each batch costs one
+// ModDivService run plus three multiplications per value, so the cost per
+// inversion should fall as the batch grows. Every inverse is checked.
+// It also checks that a callback can make the next request, as the ECC
+// routines do.
+//
+// Host wall time only ranks the batch sizes, on the badge compare the exec
+// column of the EcLogic tasks in the scheduler profile.
+
+#include <Host/HalStub.h>
+#include <Host/SchedProbe.h>
+#include <Logic/EcLogic.h>
+#include <Logic/ModArith.h>
+#include <Logic/pcg32.h>
+#include <Service/Sched/Scheduler.h>
+#include <stdio.h>
+#include <time.h>
+
+using hitcon::ecc::kEcJobPriority;
+using namespace hitcon::ecc::internal;
+using namespace hitcon::host;
+using hitcon::service::sched::scheduler;
+
+namespace {
+
+constexpr unsigned kIters = 2000;
+constexpr unsigned kChain = 8;
+constexpr MontParams kOrderMont = MakeMontParams(kCurveOrder);
+
+uint64_t g_values[kBatchInvSize];
+unsigned g_pending;
+bool g_ok;
+
+void OnInverted(void *index, void *inv) {
+  uint64_t x = g_values[reinterpret_cast<uintptr_t>(index)];
+  if (modmul_mont(x, *static_cast<uint64_t *>(inv), kOrderMont) != 1) {
+    printf("1 / %#llx came out as %#llx\n", (unsigned long long)x,
+           (unsigned long long)*static_cast<uint64_t *>(inv));
+    g_ok = false;
+  }
+  // The last one makes Run() return.
+  if (--g_pending == 0) g_sched_probe.SetStopTime(0);
+}
+
+uint64_t RandomValue(PCG32 &rng) {
+  return (static_cast<uint64_t>(rng.GetRandom()) << 32 | rng.GetRandom()) %
+             (kCurveOrder - 1) +
+         1;
+}
+
+PCG32 *g_chain_rng;
+
+// Requests the next inversion from inside the callback of the last one.
+void OnChained(void *index, void *inv) {
+  OnInverted(index, inv);
+  if (!g_pending) return;
+  g_values[0] = RandomValue(*g_chain_rng);
+  if (!g_batch_inv_service.start(g_values[0], kCurveOrder, &OnChained,
+                                 nullptr, kEcJobPriority)) {
+    printf("Request from a callback was refused\n");
+    g_ok = false;
+    g_sched_probe.SetStopTime(0);
+  }
+}
+
+bool ChainCheck(PCG32 &rng) {
+  g_ok = true;
+  g_chain_rng = &rng;
+  g_pending = kChain;
+  g_values[0] = RandomValue(rng);
+  g_batch_inv_service.start(g_values[0], kCurveOrder, &OnChained, nullptr,
+                            kEcJobPriority);
+  g_sched_probe.SetStopTime(UINT64_MAX);
+  scheduler.Run();
+  if (!g_ok) return false;
+  if (g_pending) {
+    printf("Chained requests stalled, %u left\n", g_pending);
+    return false;
+  }
+  printf("BatchInv %u requests chained from callbacks\n", kChain);
+  return true;
+}
+
+uint64_t NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+bool Bench(unsigned size, PCG32 &rng) {
+  g_ok = true;
+  uint64_t dispatches = g_sched_probe.GetDispatches();
+  uint64_t start = NowNs();
+  for (unsigned n = 0; n < kIters; n++) {
+    // All of them before the service runs, so they make one batch.
+    for (uintptr_t i = 0; i < size; i++) {
+      g_values[i] = RandomValue(rng);
+      g_batch_inv_service.start(g_values[i], kCurveOrder, &OnInverted,
+                                reinterpret_cast<void *>(i), kEcJobPriority);
+    }
+    g_pending = size;
+    g_sched_probe.SetStopTime(UINT64_MAX);
+    scheduler.Run();
+  }
+  double us = static_cast<double>(NowNs() - start) / kIters / size / 1000;
+  dispatches = g_sched_probe.GetDispatches() - dispatches;
+  if (!g_ok) return false;
+  printf("BatchInv size %u %9.2f us/inversion %6.2f dispatches/inversion\n",
+         size, us, static_cast<double>(dispatches) / kIters / size);
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  HalInit();
+  PCG32 rng(0xba7c4);
+  uint32_t batches = g_batch_inv_service.GetBatches();
+  for (unsigned size = 1; size <= kBatchInvSize; size++) {
+    if (!Bench(size, rng)) return 1;
+  }
+  batches = g_batch_inv_service.GetBatches() - batches;
+  if (batches != kIters * kBatchInvSize) {
+    printf("%u batches, should be one per Run()\n", (unsigned)batches);
+    return 1;
+  }
+  if (!ChainCheck(rng)) return 1;
+  return 0;
+}
+
+#endif  // HITCON_HOST_BUILD
@@ -0,0 +1,105 @@
+#ifdef HITCON_HOST_BUILD
+
+// Times PointMultService (k * G for a 56-bit k, as in signing) driven by the
+// real scheduler, for the field arithmetic selected by ECC_MONTGOMERY, both
+// through the generic path and the fixed-base comb. Also k * G + k2 * Q as
+// verify does it. `make test` builds it once with each, and checks the results
+// against known answers.
+//
+// Host wall time only ranks the two, on the badge compare the exec column of
+// the EcLogic tasks in the scheduler profile.
+
+#include <Host/HalStub.h>
+#include <Host/SchedProbe.h>
+#include <Logic/EcLogic.h>
+#include <Logic/ModArith.h>
+#include <Service/Sched/Scheduler.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+using hitcon::ecc::kEcJobPriority;
+using namespace hitcon::ecc::internal;
+using namespace hitcon::host;
+using hitcon::service::sched::scheduler;
+
+namespace {
+
+constexpr unsigned kIters = 20;
+constexpr uint64_t kScalar = 0x8d3a6c1f2e9b57;
+constexpr uint64_t kScalar2 = 0x3b6f1d0e5a7c29;
+// Compact form of kScalar * G, from the double-and-add implementation.
+const uint8_t kExpected[] = {0x82, 0xa6, 0x27, 0xdb, 0x19, 0xf2, 0x0e, 0x00};
+// Compact form of kScalar * G + kScalar2 * Q.
+const uint8_t kExpectedJoint[] = {0xa8, 0x7d, 0x63, 0xfa,
+                                  0x37, 0xfd, 0x3e, 0x01};
+
+const EcPoint kGenerator(0x9a77dc33b36acc, 0x279be90a95dbdd);
+// The server public key.
+const EcPoint kServerKey(0x05cb6b63de507e, 0x4df751a1388b25);
+
+EcPoint g_result;
+
+void OnMultDone(void *unused, void *point) {
+  g_result = *static_cast<EcPoint *>(point);
+  // Makes Run() return.
+  g_sched_probe.SetStopTime(0);
+}
+
+uint64_t NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+void StartGeneric() {
+  g_point_mult_service.start(kGenerator, kScalar, &OnMultDone, nullptr,
+                             kEcJobPriority);
+}
+
+void StartComb() {
+  g_point_mult_service.startGenerator(kScalar, &OnMultDone, nullptr,
+                                      kEcJobPriority);
+}
+
+void StartJoint() {
+  g_point_mult_service.startJoint(kGenerator, kScalar, kServerKey, kScalar2,
+                                  &OnMultDone, nullptr, kEcJobPriority);
+}
+
+bool Bench(const char *path, void (*start_mult)(), const uint8_t *expected) {
+  uint64_t dispatches = g_sched_probe.GetDispatches();
+  uint64_t start = NowNs();
+  for (unsigned i = 0; i < kIters; i++) {
+    g_sched_probe.SetStopTime(UINT64_MAX);
+    start_mult();
+    scheduler.Run();
+  }
+  double us = static_cast<double>(NowNs() - start) / kIters / 1000;
+  dispatches = (g_sched_probe.GetDispatches() - dispatches) / kIters;
+
+  uint8_t compact[hitcon::ECC_PUBKEY_SIZE] = {};
+  if (!g_result.getCompactForm(compact, sizeof(compact)) ||
+      memcmp(compact, expected, sizeof(compact)) != 0) {
+    printf("PointMult %s result doesn't match known answer:", path);
+    for (uint8_t b : compact) printf(" %02x", b);
+    printf("\n");
+    return false;
+  }
+  printf("PointMult %-10s %-8s %9.1f us/mult %6llu dispatches\n",
+         ECC_MONTGOMERY ? "montgomery" : "shiftadd", path, us,
+         (unsigned long long)dispatches);
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  HalInit();
+  if (!Bench("generic", &StartGeneric, kExpected)) return 1;
+  if (!Bench("comb", &StartComb, kExpected)) return 1;
+  if (!Bench("joint", &StartJoint, kExpectedJoint)) return 1;
+  return 0;
+}
+
+#endif  // HITCON_HOST_BUILD
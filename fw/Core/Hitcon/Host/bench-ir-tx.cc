@@ -0,0 +1,165 @@
+#ifdef HITCON_HOST_BUILD
+
+// Sends random packets through IrService driven by the real scheduler and
+// the DMA stubs, and checks the CCR3 waveform that comes out of the tx DMA
+// buffer against the per-pulse expansion PopulateTxDmaBuffer() used to do,
+// which is kept below as the reference. Then compares the time per refill,
+// for the same mix of sending and idle halves. The refill task is timed by
+// SchedProbe, so what an empty task costs there is taken off.
+//
+// Host wall time only ranks the two, on the badge compare the exec column of
+// the IrService tx task in the scheduler profile.
+
+#include <Host/HalStub.h>
+#include <Host/SchedProbe.h>
+#include <Logic/IrLogic.h>
+#include <Logic/pcg32.h>
+#include <Service/IrParam.h>
+#include <Service/IrService.h>
+#include <Service/Sched/Scheduler.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <vector>
+
+using namespace hitcon::ir;
+using namespace hitcon::host;
+using hitcon::service::sched::scheduler;
+
+namespace {
+
+constexpr unsigned kPackets = 200;
+constexpr unsigned kEmptyRuns = 5000;
+
+std::vector<uint16_t> g_sent;
+unsigned g_idle_halves;
+// Where the reference populates to, global so that it isn't optimized out.
+uint16_t g_old_half[IR_SERVICE_TX_SIZE];
+
+void OnTxHalf(const uint16_t *src, size_t len) {
+  g_sent.insert(g_sent.end(), src, src + len);
+  // Makes Run() return once the last half of the packet has gone out, that's
+  // two halves after it was populated.
+  if (irService.CanSendBufferNow() && ++g_idle_halves == 3) {
+    g_sched_probe.SetStopTime(0);
+  }
+}
+
+unsigned g_empty_runs;
+
+void Empty(void *self, void *unused);
+hitcon::service::sched::Task g_empty_task(100, &Empty, nullptr);
+
+void Empty(void *self, void *unused) {
+  if (++g_empty_runs < kEmptyRuns) {
+    scheduler.Queue(&g_empty_task, nullptr);
+  } else {
+    g_sched_probe.SetStopTime(0);
+  }
+}
+
+// Without the quiet time before and after.
+std::vector<uint16_t> Trim(const std::vector<uint16_t> &pulses) {
+  size_t begin = 0, end = pulses.size();
+  while (begin < end && !pulses[begin]) begin++;
+  while (end > begin && !pulses[end - 1]) end--;
+  return std::vector<uint16_t>(pulses.begin() + begin, pulses.begin() + end);
+}
+
+// The previous IrService::PopulateTxDmaBuffer() for one half while sending,
+// half 0 is the header and each one after it a byte.
+void OldPopulateSending(uint16_t *dst, const uint8_t *data, size_t ctr) {
+  if (ctr == 0) {
+    for (size_t i = 0; i < IR_SERVICE_TX_SIZE; i++) {
+      dst[i] = (-static_cast<int16_t>(IR_PACKET_HEADER[i / 8])) &
+               IR_PWM_TIM_CCR;
+    }
+    return;
+  }
+  constexpr size_t kBitsPerRun = IR_SERVICE_TX_SIZE / PULSE_PER_DATA_BIT;
+  size_t base_bit = (ctr - 1) * kBitsPerRun;
+  size_t i = 0;
+  for (size_t j = 0; j < kBitsPerRun; j++, base_bit++) {
+    int cbit = (data[base_bit / 8] >> (base_bit % 8)) & 0x01;
+    int16_t ccr_val = (-static_cast<int16_t>(cbit)) & IR_PWM_TIM_CCR;
+    for (size_t k = 0; k < PULSE_PER_DATA_BIT; k++, i++) {
+      dst[i] = ccr_val;
+    }
+  }
+}
+
+// And for one half while not sending.
+void OldPopulateIdle(uint16_t *dst) {
+  for (size_t i = 0; i < IR_SERVICE_TX_SIZE; i++) dst[i] = 0;
+}
+
+uint64_t NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+}  // namespace
+
+int main() {
+  HalInit();
+  g_ir_tx_observer = &OnTxHalf;
+  irService.Init();
+  PCG32 rng(0x7a5e);
+
+  uint64_t old_ns = 0;
+  size_t sending_halves = 0;
+  for (unsigned n = 0; n < kPackets; n++) {
+    uint8_t payload[MAX_PACKET_PAYLOAD_BYTES];
+    size_t len = 1 + rng.GetRandom() % (MAX_PACKET_PAYLOAD_BYTES - 1);
+    for (size_t i = 0; i < len; i++) payload[i] = rng.GetRandom();
+    IrPacket packet;
+    irLogic.EncodePacket(payload, len, packet);
+
+    g_sent.clear();
+    g_idle_halves = 0;
+    if (!irService.SendBuffer(packet.data_, packet.size_, true, false)) {
+      printf("SendBuffer() refused packet %u\n", n);
+      return 1;
+    }
+    g_sched_probe.SetStopTime(UINT64_MAX);
+    scheduler.Run();
+
+    std::vector<uint16_t> expected;
+    for (size_t ctr = 0; ctr <= packet.size_; ctr++) {
+      uint64_t start = NowNs();
+      OldPopulateSending(g_old_half, packet.data_, ctr);
+      old_ns += NowNs() - start;
+      expected.insert(expected.end(), g_old_half,
+                      g_old_half + IR_SERVICE_TX_SIZE);
+    }
+    sending_halves += packet.size_ + 1;
+    if (Trim(g_sent) != Trim(expected)) {
+      printf("Packet %u (%zu bytes) went out differently\n", n, len);
+      return 1;
+    }
+  }
+
+  const SchedProbe::TaskStats tx =
+      g_sched_probe.GetStats().at(&irService.dma_tx_populate_task);
+  scheduler.Queue(&g_empty_task, nullptr);
+  g_sched_probe.SetStopTime(UINT64_MAX);
+  scheduler.Run();
+  const SchedProbe::TaskStats &empty =
+      g_sched_probe.GetStats().at(&g_empty_task);
+  const double overhead = static_cast<double>(empty.host_ns_sum) / empty.runs;
+
+  for (size_t i = sending_halves; i < tx.runs; i++) {
+    uint64_t start = NowNs();
+    OldPopulateIdle(g_old_half);
+    old_ns += NowNs() - start;
+  }
+  printf("IrService tx %u packets %u refills: runs %6.1f ns/refill, "
+         "per pulse %6.1f ns/refill\n",
+         kPackets, (unsigned)tx.runs,
+         static_cast<double>(tx.host_ns_sum) / tx.runs - overhead,
+         static_cast<double>(old_ns) / tx.runs);
+  return 0;
+}
+
+#endif  // HITCON_HOST_BUILD
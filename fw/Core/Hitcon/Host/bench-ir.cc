@@ -0,0 +1,305 @@
+#ifdef HITCON_HOST_BUILD
+
+// Replays rx sample streams through IrLogic::OnBufferReceived() and times it
+// against the bit-at-a-time decoder it replaced, which is kept below as the
+// reference. The streams are what IrService transmits for random packets
+// (IR_PACKET_HEADER, then each bit DECODE_SAMPLE_RATIO samples long) at
+// random sample offsets, with single flipped samples that either decoder
+// should shrug off, and every eighth packet cut short by an undecodable bit.
+// Every fourth is sent with the fast profile instead (IR_PACKET_HEADER_FAST,
+// DECODE_SAMPLE_RATIO_FAST samples a bit), without the flips, which it can't
+// take. The table decoder has to deliver exactly the packets that went in
+// intact.
+// The bit serial one misses the fast ones, and some others after a size below
+// 2 or a bad size bit, so it only must not deliver anything else.
+//
+// Host wall time only ranks the two, on the badge compare the exec column of
+// the IrLogic task in the scheduler profile.
+
+#include <Logic/IrLogic.h>
+#include <Logic/crc32.h>
+#include <Logic/pcg32.h>
+#include <Service/IrParam.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <vector>
+
+using namespace hitcon::ir;
+
+namespace {
+
+constexpr unsigned kPackets = 400;
+constexpr unsigned kReplays = 20;
+
+struct Stream {
+  std::vector<uint8_t> samples;
+  // Payloads of the packets that should come out, in order.
+  std::vector<std::vector<uint8_t>> expected;
+};
+
+class Builder {
+ public:
+  explicit Builder(Stream &stream) : stream_(stream) {}
+
+  void Push(bool on) {
+    if (pos_ % 8 == 0) stream_.samples.push_back(0);
+    stream_.samples.back() |= on << (pos_ % 8);
+    pos_++;
+  }
+
+  size_t Position() { return pos_; }
+  void Flip(size_t pos) { stream_.samples[pos / 8] ^= 1 << (pos % 8); }
+
+ private:
+  Stream &stream_;
+  size_t pos_ = 0;
+};
+
+Stream MakeStream(PCG32 &rng) {
+  Stream stream;
+  Builder out(stream);
+  for (unsigned n = 0; n < kPackets; n++) {
+    // Quiet time, and so a random offset against the rx bytes.
+    unsigned gap = 24 + rng.GetRandom() % 64;
+    for (unsigned i = 0; i < gap; i++) out.Push(false);
+
+    const bool fast = n % 4 == 1;
+    for (uint8_t element : fast ? IR_PACKET_HEADER_FAST : IR_PACKET_HEADER) {
+      for (unsigned i = 0; i < PULSE_PER_HEADER_BIT * DECODE_SAMPLE_RATIO /
+                                   PULSE_PER_DATA_BIT;
+           i++) {
+        out.Push(element);
+      }
+    }
+
+    uint8_t payload[MAX_PACKET_PAYLOAD_BYTES];
+    size_t len = 1 + rng.GetRandom() % (MAX_PACKET_PAYLOAD_BYTES - 3);
+    for (size_t i = 0; i < len; i++) payload[i] = rng.GetRandom();
+    IrPacket packet;
+    irLogic.EncodePacket(payload, len, packet);
+
+    const bool cut = n % 8 == 7;
+    const size_t bad_bit = rng.GetRandom() % (packet.size_ * 8);
+    const unsigned ratio =
+        fast ? DECODE_SAMPLE_RATIO_FAST : DECODE_SAMPLE_RATIO;
+    for (size_t bit = 0; bit < packet.size_ * 8; bit++) {
+      const bool on = (packet.data_[bit / 8] >> (bit % 8)) & 1;
+      const size_t start = out.Position();
+      for (unsigned i = 0; i < ratio; i++) out.Push(on);
+      if (cut && bit == bad_bit) {
+        // As many on as off, and then the sender is gone.
+        for (unsigned i = 0; i < ratio / 2; i++) out.Flip(start + i);
+        break;
+      } else if (!fast && rng.GetRandom() % 16 == 0) {
+        out.Flip(start + rng.GetRandom() % DECODE_SAMPLE_RATIO);
+      }
+    }
+    if (!cut) stream.expected.emplace_back(payload, payload + len);
+  }
+  // Trailing quiet time, up to a whole number of rx buffers.
+  for (unsigned i = 0; i < 64; i++) out.Push(false);
+  while (stream.samples.size() % IR_SERVICE_RX_ON_BUFFER_SIZE) out.Push(false);
+  return stream;
+}
+
+std::vector<std::vector<uint8_t>> g_received;
+
+void Collect(const IrPacket &packet) {
+  // data_[0] is the size, which counts itself.
+  g_received.emplace_back(packet.data_ + 1, packet.data_ + packet.size_);
+}
+
+void OnPacket(void *unused, void *packet) {
+  Collect(*static_cast<IrPacket *>(packet));
+}
+
+uint8_t MergeChksum(uint32_t x) {
+  uint8_t ret = 0;
+  for (int i = 0; i < 32; i += 8) ret ^= (x >> i) & 0xff;
+  return ret;
+}
+
+// The previous IrLogic::OnBufferReceived(), one sample per iteration, minus
+// the task splitting and the suspender. It has no fast profile.
+class BitSerialDecoder {
+ public:
+  void OnBuffer(const uint8_t *buffer) {
+    for (size_t i = 0; i < IR_SERVICE_RX_ON_BUFFER_SIZE; i++) {
+      uint8_t current_byte = buffer[i];
+      for (uint8_t j = 0; j < 8; j++) {
+        uint8_t is_on = current_byte & 0x01;
+        current_byte >>= 1;
+        if (!Step(is_on)) return;
+      }
+    }
+  }
+
+ private:
+  enum { kStart, kSize, kData, kChksum, kReset };
+  size_t packet_buf_ = 0;
+  uint8_t state_ = kStart;
+  uint8_t bit_ = 0;
+  IrPacket rx_;
+
+  static uint8_t DecodeBit(uint8_t x) {
+    switch (__builtin_popcount(x & 0b1111)) {
+      case 0:
+      case 1:
+        return 0;
+      case 3:
+      case 4:
+        return 1;
+      default:
+        return 2;
+    }
+  }
+
+  // Return false to drop the rest of the buffer, as a bad size bit did.
+  bool Step(uint8_t is_on) {
+    switch (state_) {
+      case kStart:
+        packet_buf_ = packet_buf_ << 1 | is_on;
+        if ((packet_buf_ & IR_PACKET_HEADER_MASK) ==
+            (IR_PACKET_HEADER_PACKED & IR_PACKET_HEADER_MASK)) {
+          state_ = kSize;
+          rx_.size_ = 0;
+          packet_buf_ = 0;
+          bit_ = 0;
+        }
+        return true;
+      case kSize:
+        packet_buf_++;
+        bit_ = bit_ << 1 | is_on;
+        if ((packet_buf_ & 3) == 0) {
+          if (DecodeBit(bit_) == 2) {
+            state_ = kReset;
+            return false;
+          }
+          rx_.size_ |=
+              DecodeBit(bit_) << (packet_buf_ / DECODE_SAMPLE_RATIO - 1);
+          bit_ = 0;
+        }
+        if (packet_buf_ == DECODE_SAMPLE_RATIO * 8) {
+          if (rx_.size_ >= MAX_PACKET_PAYLOAD_BYTES) {
+            state_ = kReset;
+          } else {
+            rx_.data_[0] = rx_.size_;
+            state_ = kData;
+            packet_buf_ = 0;
+          }
+        }
+        return true;
+      case kData:
+      case kChksum: {
+        packet_buf_++;
+        bit_ = bit_ << 1 | is_on;
+        if (packet_buf_ % DECODE_SAMPLE_RATIO) return true;
+        uint8_t bit = DecodeBit(bit_);
+        if (bit == 2) {
+          state_ = kReset;
+          return true;
+        }
+        const size_t n = packet_buf_ / DECODE_SAMPLE_RATIO - 1;
+        if (state_ == kData) {
+          rx_.data_[n / 8 + 1] |= bit << (n % 8);
+          if (n / 8 + 1 == rx_.size_ - 2 && n % 8 == 7) state_ = kChksum;
+          return true;
+        }
+        rx_.data_[rx_.size_ - 1] |= bit << (n % IR_CHKSUM_SZ);
+        if (n % IR_CHKSUM_SZ == IR_CHKSUM_SZ - 1) {
+          packet_buf_ = 0;
+          state_ = kReset;
+          if (MergeChksum(crc32(rx_.data_, rx_.size_ - 1)) ==
+              rx_.data_[rx_.size_ - 1]) {
+            rx_.size_--;
+            Collect(rx_);
+          }
+        }
+        return true;
+      }
+      case kReset:
+      default:
+        state_ = kStart;
+        packet_buf_ = 0;
+        bit_ = 0;
+        rx_ = IrPacket();
+        return true;
+    }
+  }
+};
+
+uint64_t NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+bool CheckExact(const Stream &stream) {
+  if (g_received != stream.expected) {
+    printf("Table decoder got %zu of %zu packets, or wrong ones\n",
+           g_received.size(), stream.expected.size());
+    return false;
+  }
+  return true;
+}
+
+// Whether g_received is stream.expected with some packets left out.
+bool CheckSubset(const Stream &stream) {
+  size_t e = 0;
+  for (const auto &packet : g_received) {
+    while (e < stream.expected.size() && stream.expected[e] != packet) e++;
+    if (e == stream.expected.size()) {
+      printf("Bit serial decoder got a packet that wasn't sent\n");
+      return false;
+    }
+    e++;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  PCG32 rng(0x1dec0de);
+  Stream stream = MakeStream(rng);
+  const size_t buffers = stream.samples.size() / IR_SERVICE_RX_ON_BUFFER_SIZE;
+  irLogic.SetOnPacketReceived(&OnPacket, nullptr);
+
+  double table_ns = 0, serial_ns = 0;
+  size_t runs = 0;
+  for (unsigned replay = 0; replay < kReplays; replay++) {
+    g_received.clear();
+    uint64_t start = NowNs();
+    for (size_t i = 0; i < buffers; i++) {
+      irLogic.buffer_received_ctr = 0;
+      irLogic.OnBufferReceived(
+          &stream.samples[i * IR_SERVICE_RX_ON_BUFFER_SIZE]);
+      runs++;
+      if (irLogic.buffer_received_ctr != IR_SERVICE_RX_ON_BUFFER_SIZE) {
+        printf("Buffer %zu took more than one run\n", i);
+        return 1;
+      }
+    }
+    table_ns += NowNs() - start;
+    if (!CheckExact(stream)) return 1;
+
+    g_received.clear();
+    BitSerialDecoder serial;
+    start = NowNs();
+    for (size_t i = 0; i < buffers; i++) {
+      serial.OnBuffer(&stream.samples[i * IR_SERVICE_RX_ON_BUFFER_SIZE]);
+    }
+    serial_ns += NowNs() - start;
+    if (!CheckSubset(stream)) return 1;
+  }
+
+  const double total = static_cast<double>(buffers) * kReplays;
+  printf("IrLogic rx %zu packets: table %6.1f ns/buffer %4.2f runs/buffer, "
+         "bit serial %6.1f ns/buffer %zu packets\n",
+         stream.expected.size(), table_ns / total, runs / total,
+         serial_ns / total, g_received.size());
+  return 0;
+}
+
+#endif  // HITCON_HOST_BUILD
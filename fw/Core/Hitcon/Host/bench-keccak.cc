@@ -0,0 +1,73 @@
+#ifdef HITCON_HOST_BUILD
+
+// Times one Keccak-f[1600] permutation and one short SHA3-256 through the
+// _split API (the HashService path) for the backend selected by
+// KECCAK_INTERLEAVED. `make test` builds it once per backend.
+//
+// On a 64-bit host the plain lanes are native, so this mostly catches
+// regressions. On the badge compare the exec column of the hash task in the
+// scheduler profile.
+
+#include <Logic/keccak.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+namespace {
+
+constexpr unsigned kIters = 200000;
+
+uint64_t NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+double BenchPermutation() {
+  uint64_t s[25];
+  for (unsigned i = 0; i < 25; i++) s[i] = i * 0x0101010101010101ULL;
+  uint64_t start = NowNs();
+  for (unsigned i = 0; i < kIters; i++) keccakf(s);
+  double ns = static_cast<double>(NowNs() - start) / kIters;
+  // Keep the result alive.
+  if (s[0] == 0x1234) printf("!");
+  return ns;
+}
+
+double BenchHash() {
+  uint8_t msg[64];
+  memset(msg, 0xa3, sizeof(msg));
+  sha3_context c;
+  uint8_t sink = 0;
+  uint64_t start = NowNs();
+  for (unsigned n = 0; n < kIters / 4; n++) {
+    sha3_Init256(&c);
+    size_t done = 0, absorbed;
+    int round;
+    while ((round = sha3_UpdateBlock_split(&c, msg + done, sizeof(msg) - done,
+                                           &absorbed, 0)) != 0) {
+      done += absorbed;
+      while (round != 0)
+        round = sha3_UpdateBlock_split(&c, nullptr, 0, nullptr, round);
+    }
+    const void *hash = nullptr;
+    for (unsigned i = 0; i < KECCAK_ROUNDS + 2; i++) {
+      hash = sha3_Finalize_split(&c, i);
+    }
+    sink ^= static_cast<const uint8_t *>(hash)[0];
+  }
+  double ns = static_cast<double>(NowNs() - start) / (kIters / 4);
+  if (sink == 0x5a) printf("!");
+  return ns;
+}
+
+}  // namespace
+
+int main() {
+  const char *name = KECCAK_INTERLEAVED ? "interleaved" : "lanes";
+  printf("keccakf %-12s %7.1f ns/permutation %7.1f ns/sha3-256(64B)\n", name,
+         BenchPermutation(), BenchHash());
+  return 0;
+}
+
+#endif  // HITCON_HOST_BUILD
@@ -0,0 +1,346 @@
+#ifdef HITCON_HOST_BUILD
+
+// Benchmarks the scheduler heaps on the dispatch path, with the ready heap
+// and the delayed heap full (32 and 24 tasks, same as Scheduler), against the
+// previous linear search implementation. Also cross-checks that both heaps
+// pop in the same priority order, compares the delayed heap against the timer
+// wheel on expiry with periodic tasks, and checks the wheel's NextWake().
+
+#include <Service/Sched/DelayedTask.h>
+#include <Service/Sched/Ds/Heap.h>
+#include <Service/Sched/Ds/TimerWheel.h>
+#include <Service/Sched/Task.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace hitcon::service::sched;
+
+namespace {
+
+// Heap as it was before heapIdx: Remove() looks the element up with a scan.
+template <class T, unsigned capacity>
+class LinearHeap {
+  unsigned sz = 0;
+  T *storage[capacity];
+
+  unsigned GetIdx(T &t) {
+    for (unsigned i = 0; i < sz; ++i) {
+      if (t == *storage[i]) return i;
+    }
+    return sz;
+  }
+
+  void Heapify(unsigned i) {
+    while (i > 0) {
+      unsigned parIdx = heap::ParentIdx(i);
+      T **cur = &storage[i], **par = &storage[parIdx];
+      if (**cur < **par) {
+        T *tmp1 = *cur;
+        *cur = *par;
+        *par = tmp1;
+      }
+      i = parIdx;
+    }
+  }
+
+  void ReverseHeapify(unsigned i) {
+    while (heap::ChildIdx1(i) < sz) {
+      unsigned i1 = heap::ChildIdx1(i);
+      unsigned i2 = heap::ChildIdx2(i);
+      unsigned smallest = i;
+      if (i1 < sz && *storage[i1] < *storage[smallest]) smallest = i1;
+      if (i2 < sz && *storage[i2] < *storage[smallest]) smallest = i2;
+      if (i == smallest) break;
+      T *tmp1 = storage[i];
+      storage[i] = storage[smallest];
+      storage[smallest] = tmp1;
+      i = smallest;
+    }
+  }
+
+ public:
+  bool Add(T *t) {
+    if (sz >= capacity) return false;
+    storage[sz++] = t;
+    Heapify(sz - 1);
+    return true;
+  }
+
+  bool Remove(T *t) {
+    unsigned idx = GetIdx(*t);
+    if (idx == sz) return false;
+    storage[idx] = storage[--sz];
+    storage[sz] = nullptr;
+    ReverseHeapify(idx);
+    // The old code only sifted down, which can leave the heap unordered.
+    Heapify(idx < sz ? idx : 0);
+    return true;
+  }
+
+  T &Top() { return *storage[0]; }
+
+  unsigned size() { return sz; }
+};
+
+void Nop(void *, void *) {}
+
+uint64_t NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+constexpr unsigned kReady = 32;
+constexpr unsigned kDelayed = 24;
+constexpr unsigned kIters = 2000000;
+
+struct Tasks {
+  std::vector<std::unique_ptr<Task>> ready;
+  std::vector<std::unique_ptr<DelayedTask>> delayed;
+
+  Tasks() {
+    srand(1);
+    for (unsigned i = 0; i < kReady; i++) {
+      ready.emplace_back(new Task(100 + rand() % 900, &Nop, nullptr));
+    }
+    for (unsigned i = 0; i < kDelayed; i++) {
+      delayed.emplace_back(
+          new DelayedTask(800, &Nop, nullptr, 1 + rand() % 1000));
+    }
+  }
+};
+
+// One dispatch as Scheduler::Run() and DelayedHouseKeeping() do it: pop the
+// top ready task and requeue it, expire the top delayed task and rearm it,
+// and every 8th round cancel a random delayed task (DisablePeriodic()).
+template <class ReadyHeap, class DelayedHeap>
+unsigned Dispatch(ReadyHeap &ready, DelayedHeap &delayed, Tasks &tasks,
+                  unsigned i) {
+  Task &top = ready.Top();
+  unsigned sink = reinterpret_cast<uintptr_t>(&top) & 0xFF;
+  ready.Remove(&top);
+  ready.Add(&top);
+
+  DelayedTask &next = delayed.Top();
+  delayed.Remove(&next);
+  next.SetWakeTime(next.WakeTime() + 1 + (i * 7919) % 1000);
+  delayed.Add(&next);
+
+  if ((i & 7) == 0) {
+    DelayedTask *victim = tasks.delayed[(i * 31) % kDelayed].get();
+    delayed.Remove(victim);
+    delayed.Add(victim);
+  }
+  return sink;
+}
+
+template <class ReadyHeap, class DelayedHeap>
+double Bench(const char *name, Tasks &tasks) {
+  static ReadyHeap ready;
+  static DelayedHeap delayed;
+  for (auto &t : tasks.ready) ready.Add(t.get());
+  for (auto &t : tasks.delayed) delayed.Add(t.get());
+
+  unsigned sink = 0;
+  uint64_t start = NowNs();
+  for (unsigned i = 0; i < kIters; i++) {
+    sink += Dispatch(ready, delayed, tasks, i);
+  }
+  double ns = static_cast<double>(NowNs() - start) / kIters;
+  printf("%-12s %7.1f ns/dispatch (%u)\n", name, ns, sink & 1);
+  return ns;
+}
+
+// Pops both heaps in lockstep with random removals and checks that the tops
+// agree on priority.
+bool CrossCheck() {
+  std::vector<std::unique_ptr<Task>> tasks;
+  for (unsigned i = 0; i < kReady; i++) {
+    tasks.emplace_back(new Task(100 + rand() % 900, &Nop, nullptr));
+  }
+  static Heap<Task, kReady> a;
+  static LinearHeap<Task, kReady> b;
+  for (unsigned round = 0; round < 100000; round++) {
+    Task *t = tasks[rand() % kReady].get();
+    bool in_a = a.Remove(t);
+    bool in_b = b.Remove(t);
+    if (in_a != in_b) return false;
+    if (!in_a) {
+      a.Add(t);
+      b.Add(t);
+    }
+    if (a.size() != b.size()) return false;
+    if (a.size() && (a.Top() < b.Top() || b.Top() < a.Top())) return false;
+  }
+  return true;
+}
+
+using Wheel = TimerWheel<DelayedTask, 5, 4>;
+
+// Takes everything due at now off the delayed queue, the way
+// DelayedHouseKeeping() does it for each backend.
+template <unsigned capacity>
+void Expire(Heap<DelayedTask, capacity> &q, unsigned now,
+            std::vector<DelayedTask *> &out) {
+  while (q.size() && q.Top().WakeTime() <= now) {
+    DelayedTask *t = &q.Top();
+    q.Remove(t);
+    out.push_back(t);
+  }
+}
+
+void Expire(Wheel &q, unsigned now, std::vector<DelayedTask *> &out) {
+  q.Advance(now);
+  while (DelayedTask *t = q.PopExpired()) out.push_back(t);
+}
+
+struct PeriodicDelayed : DelayedTask {
+  unsigned period;
+
+  PeriodicDelayed(unsigned wake, unsigned period)
+      : DelayedTask(800, &Nop, nullptr, wake), period(period) {}
+};
+
+// Periodic tasks with a mix of periods, from 1ms up to beyond the range of
+// the wheel, with a random cancel and rearm every few ticks.
+struct PeriodicSet {
+  std::vector<std::unique_ptr<PeriodicDelayed>> tasks;
+
+  explicit PeriodicSet(unsigned n) {
+    static const unsigned kPeriods[] = {1, 5, 10, 20, 25, 100, 1000, 1200000};
+    for (unsigned i = 0; i < n; i++) {
+      unsigned period = kPeriods[rand() % 8];
+      tasks.emplace_back(new PeriodicDelayed(rand() % period, period));
+    }
+  }
+};
+
+// Runs ticks 1ms apart, rearms everything that expired and returns how many
+// expired. If log is given, every batch is appended to it, sorted.
+template <class Queue>
+unsigned RunTicks(Queue &q, PeriodicSet &set, unsigned ticks,
+                  std::vector<DelayedTask *> *log) {
+  for (auto &t : set.tasks) q.Add(t.get());
+  std::vector<DelayedTask *> batch;
+  unsigned expired = 0;
+  for (unsigned now = 0; now < ticks; now++) {
+    batch.clear();
+    Expire(q, now, batch);
+    expired += batch.size();
+    for (DelayedTask *t : batch) {
+      t->SetWakeTime(t->WakeTime() + static_cast<PeriodicDelayed *>(t)->period);
+      q.Add(t);
+    }
+    if (now % 3 == 0) {
+      DelayedTask *victim = set.tasks[(now * 31) % set.tasks.size()].get();
+      if (q.Remove(victim)) q.Add(victim);
+    }
+    if (log) {
+      std::sort(batch.begin(), batch.end());
+      log->insert(log->end(), batch.begin(), batch.end());
+      log->push_back(nullptr);
+    }
+  }
+  for (auto &t : set.tasks) q.Remove(t.get());
+  return expired;
+}
+
+// The wheel and the heap must expire the same tasks on the same ticks.
+bool WheelCheck() {
+  srand(2);
+  PeriodicSet set(kDelayed);
+  std::vector<unsigned> wake;
+  for (auto &t : set.tasks) wake.push_back(t->WakeTime());
+  static Heap<DelayedTask, kDelayed> heap;
+  std::vector<DelayedTask *> a, b;
+  RunTicks(heap, set, 3000000, &a);
+  for (unsigned i = 0; i < kDelayed; i++) set.tasks[i]->SetWakeTime(wake[i]);
+  static Wheel wheel;
+  RunTicks(wheel, set, 3000000, &b);
+  return a == b;
+}
+
+// NextWake() must never be later than the earliest wake time still in the
+// wheel, with random Add() and Advance() calls that reach every level.
+bool NextWakeCheck() {
+  srand(4);
+  std::vector<std::unique_ptr<DelayedTask>> tasks;
+  for (unsigned i = 0; i < 16; i++) {
+    tasks.emplace_back(new DelayedTask(800, &Nop, nullptr, 0));
+  }
+  static const unsigned kRanges[] = {40, 2000, 70000, 1200000};
+  static Wheel wheel;
+  unsigned now = 0;
+  for (unsigned round = 0; round < 200000; round++) {
+    DelayedTask *t = tasks[rand() % tasks.size()].get();
+    if (!wheel.Contains(t)) {
+      t->SetWakeTime(now + 1 + rand() % kRanges[rand() % 4]);
+      wheel.Add(t);
+    } else {
+      now += rand() % 50;
+      wheel.Advance(now);
+      while (DelayedTask *e = wheel.PopExpired()) {
+        if (e->WakeTime() > now) return false;
+      }
+    }
+    if (!wheel.size()) continue;
+    unsigned earliest = ~0u;
+    for (auto &p : tasks) {
+      if (wheel.Contains(p.get())) {
+        earliest = std::min(earliest, p->WakeTime());
+      }
+    }
+    if (wheel.NextWake() > earliest) return false;
+  }
+  for (auto &p : tasks) wheel.Remove(p.get());
+  return true;
+}
+
+template <class Queue>
+void BenchDelayed(const char *name, unsigned n) {
+  srand(3);
+  PeriodicSet set(n);
+  static Queue q;
+  constexpr unsigned kTicks = 200000;
+  uint64_t start = NowNs();
+  unsigned expired = RunTicks(q, set, kTicks, nullptr);
+  double ns = static_cast<double>(NowNs() - start);
+  printf("%-12s %3u tasks %7.1f ns/tick %7.1f ns/expiry\n", name, n,
+         ns / kTicks, ns / expired);
+}
+
+}  // namespace
+
+int main() {
+  if (!CrossCheck()) {
+    printf("FAIL: heap order mismatch\n");
+    return 1;
+  }
+  if (!WheelCheck()) {
+    printf("FAIL: timer wheel expiry mismatch\n");
+    return 1;
+  }
+  if (!NextWakeCheck()) {
+    printf("FAIL: timer wheel NextWake() past a pending expiry\n");
+    return 1;
+  }
+  Tasks tasks;
+  double linear =
+      Bench<LinearHeap<Task, kReady>, LinearHeap<DelayedTask, kDelayed>>(
+          "linear scan", tasks);
+  double intrusive =
+      Bench<Heap<Task, kReady>, Heap<DelayedTask, kDelayed>>("heapIdx", tasks);
+  printf("speedup %.2fx\n", linear / intrusive);
+  BenchDelayed<Heap<DelayedTask, kDelayed>>("heap", kDelayed);
+  BenchDelayed<Wheel>("wheel", kDelayed);
+  BenchDelayed<Heap<DelayedTask, 128>>("heap", 128);
+  BenchDelayed<Wheel>("wheel", 128);
+  return 0;
+}
+
+#endif  // HITCON_HOST_BUILD
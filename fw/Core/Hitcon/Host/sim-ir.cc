@@ -0,0 +1,644 @@
+#ifdef HITCON_HOST_BUILD
+
+// Simulates a hall of badges around base stations, all sharing the IR air
+// channel. Every node runs its own IrService (tx waveform, carrier sense,
+// collision abort and backoff) and IrLogic (decoding, load factor), fed by
+// the real scheduler. The medium ORs the carrier of every transmitter in
+// range of a receiver, sample by sample, so overlapping packets collide the
+// way they would on air, and flips random samples in the rx halves that
+// have a carrier for the bit errors, as a weak signal would.
+//
+// IrController needs the rest of the badge, so its retransmit logic is
+// modelled here with its constants: each badge offers proximity sized
+// packets at random, at the given rate, and MaintainQueued() sends them once
+// a RoutineTask() at most. Base stations acknowledge every one they decode.
+//
+// For each number of badges, offered load, sample error rate, with base
+// stations starting FEC or not and allowed the fast profile or not, it prints
+// the packets that made it to a base station, goodput, latency from offer to
+// ack, retransmits and collision aborts, the acks that went out with the fast
+// profile, and the air time against the load factor the badges measured. The
+// MAC parameters are in IrParam.h and IrController.h, change them there and
+// run it again.
+//
+// Usage: sim-ir [-n badges,...] [-l packets_per_s,...] [-t seconds]
+//               [-b base_stations] [-r range_m] [-e sample_error,...]
+//               [-f fec,...] [-p base_station_fast,...]
+//               [-w retry_wait_min,spread] [-s seed]
+
+#include <Host/SchedProbe.h>
+#include <Host/VirtualClock.h>
+#include <Logic/IrController.h>
+#include <Logic/IrLogic.h>
+#include <Logic/RandomPool.h>
+#include <Logic/pcg32.h>
+#include <Service/IrParam.h>
+#include <Service/IrService.h>
+#include <Service/Sched/Scheduler.h>
+#include <main.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace hitcon::ir;
+using hitcon::service::sched::scheduler;
+
+namespace hitcon {
+namespace host {
+
+namespace {
+
+// The medium is simulated in tx pulses (38kHz). The tx DMA interrupt of a
+// node comes every half buffer, that's a slot, and rx every two.
+constexpr unsigned kSlotPulses = IR_SERVICE_TX_SIZE;
+constexpr unsigned kPulsesPerSample =
+    IR_SERVICE_TX_RATE_HZ / IR_SERVICE_RX_RATE_HZ;
+constexpr unsigned kRxHalfPulses = IR_SERVICE_RX_SIZE * kPulsesPerSample;
+static_assert(kRxHalfPulses == 2 * kSlotPulses);
+
+// What each node sent recently, a bit per pulse, by pulse number.
+constexpr unsigned kRingWords = 16;
+constexpr unsigned kRingPulses = kRingWords * 64;
+static_assert(kRingPulses >= 2 * kRxHalfPulses + kSlotPulses);
+
+constexpr size_t kProximityLen = IR_DATA_HEADER_SIZE + sizeof(ProximityPacket);
+constexpr size_t kAckLen = IR_DATA_HEADER_SIZE + sizeof(AcknowledgePacket);
+// What SignedPacketService asks for.
+constexpr uint8_t kRetries = 3;
+// Acks a base station holds on to while the air is busy.
+constexpr size_t kAckQueueSize = 8;
+
+struct Config {
+  unsigned badges = 8;
+  // Packets offered per second per badge.
+  double load = 0.2;
+  double seconds = 60;
+  unsigned bases = 2;
+  // How far a node can be heard, in m.
+  double range = 4;
+  // Chance of each rx sample coming out flipped, while there's a carrier.
+  double sample_error = 1e-4;
+  // Base stations send with IrLogic::SetTxFec(), badges once they hear one.
+  bool fec = false;
+  // Base stations send with IrLogic::SetTxFast(), badges near one follow.
+  bool fast = false;
+  unsigned retry_min = kRetransmitWaitMin;
+  unsigned retry_spread = kRetransmitWaitSpread;
+  uint64_t seed = 1;
+};
+
+// A slot of IrController::queued_packets_, minus the hashing.
+struct QueuedPacket {
+  uint8_t status = kRetransmitStatusSlotUnused;
+  uint8_t retries = 0;
+  uint16_t time_to_retry = 0;
+  uint16_t nonce = 0;
+  bool sent = false;
+  // By any base station.
+  bool delivered = false;
+  uint64_t offered_us = 0;
+};
+
+uint64_t ReadRing(const uint64_t *ring, uint64_t pulse) {
+  const unsigned idx = pulse % kRingPulses, w = idx / 64, b = idx % 64;
+  uint64_t bits = ring[w] >> b;
+  if (b) bits |= ring[(w + 1) % kRingWords] << (64 - b);
+  return bits;
+}
+
+void WriteRing(uint64_t *ring, uint64_t pulse, uint64_t bits) {
+  const unsigned idx = pulse % kRingPulses, w = idx / 64, b = idx % 64;
+  if (!b) {
+    ring[w] = bits;
+    return;
+  }
+  const uint64_t low = (1ULL << b) - 1;
+  uint64_t &next = ring[(w + 1) % kRingWords];
+  ring[w] = (ring[w] & low) | bits << b;
+  next = (next & ~low) | bits >> (64 - b);
+}
+
+void PutLe(uint8_t *dst, uint32_t x, size_t len) {
+  for (size_t i = 0; i < len; i++) dst[i] = x >> (i * 8);
+}
+
+uint32_t GetLe(const uint8_t *src, size_t len) {
+  uint32_t x = 0;
+  for (size_t i = 0; i < len; i++)
+    x |= static_cast<uint32_t>(src[i]) << (i * 8);
+  return x;
+}
+
+}  // namespace
+
+class IrAirSim {
+ public:
+  explicit IrAirSim(const Config &config);
+
+  void Run();
+  void Report();
+
+ private:
+  struct Node {
+    IrService svc;
+    IrLogic logic;
+    IrAirSim *sim;
+    unsigned id;
+    bool base;
+    double x, y;
+    // Where in each slot its DMA interrupts come, in pulses.
+    unsigned phase;
+    // Which slots end an rx half.
+    unsigned rx_parity;
+    int tx_side, rx_side;
+    uint64_t next_routine_us, next_ctrl_us, next_offer_us;
+    uint64_t ring[kRingWords];
+    // First pulse after the last one it sent.
+    uint64_t on_until;
+    bool active;
+
+    // Badges.
+    QueuedPacket queued[RETX_QUEUE_SIZE];
+    int current_tx_slot;
+    uint16_t next_nonce;
+
+    // Base stations, the packet_hash of each.
+    uint8_t acks[kAckQueueSize][PACKET_HASH_LEN];
+    size_t ack_count;
+  };
+
+  struct Stats {
+    uint64_t offered = 0, queue_full = 0;
+    uint64_t sends = 0, retransmits = 0, aborts = 0;
+    uint64_t delivered = 0, acked = 0, failed = 0, pending = 0;
+    uint64_t acks_sent = 0, acks_dropped = 0, fast_acks = 0;
+    // Rx samples at the base stations, and how many had a carrier.
+    uint64_t samples = 0, carrier = 0;
+    std::vector<uint32_t> latency_ms;
+  };
+
+  Config config;
+  PCG32 rng;
+  uint64_t start_us;
+  uint32_t error_threshold;
+  std::vector<std::unique_ptr<Node>> nodes;
+  // By phase, so the interrupts are handled in time order.
+  std::vector<Node *> order;
+  // hears[a * n + b]: a receives what b sends.
+  std::vector<uint8_t> hears;
+  // Nodes that may have sent something in the last rx half.
+  std::vector<Node *> active;
+  Stats stats;
+
+  uint64_t NowUs(uint64_t pulse) {
+    return start_us + pulse * 1000000 / IR_SERVICE_TX_RATE_HZ;
+  }
+
+  void Step(Node &n, uint64_t slot);
+  void RefillTx(Node &n, uint64_t pulse);
+  void FillRx(Node &n, uint64_t pulse);
+  void Offer(Node &n, uint64_t now_us);
+  void MaintainQueued(Node &n, uint64_t now_us);
+  void SendAck(Node &n);
+  // Returns 0 if busy, 1 if sent, 2 if sent with the fast profile.
+  int Send(Node &n, const uint8_t *data, size_t len);
+
+  static void OnPacket(void *node, void *packet);
+  void OnPacket(Node &n, const IrPacket &packet);
+};
+
+IrAirSim::IrAirSim(const Config &config)
+    : config(config), rng(config.seed), start_us(g_virtual_clock.Now()),
+      error_threshold(config.sample_error * 4294967296.0) {
+  g_fast_random_pool.Seed(config.seed);
+  const unsigned count = config.bases + config.badges;
+  for (unsigned i = 0; i < count; i++) {
+    // Value-initialized, so the DMA buffers start out zero like in .bss.
+    nodes.emplace_back(new Node());
+    Node &n = *nodes.back();
+    n.sim = this;
+    n.id = i;
+    n.base = i < config.bases;
+    if (n.base) {
+      // In a row, far enough apart that their badges don't hear each other.
+      n.x = i * 3 * config.range;
+      n.y = 0;
+    } else {
+      // Around one of them, at most range away.
+      const Node &base = *nodes[i % config.bases];
+      const double r =
+          config.range * sqrt((rng.GetRandom() + 0.5) / 4294967296.0);
+      const double a = 2 * M_PI * rng.GetRandom() / 4294967296.0;
+      n.x = base.x + r * cos(a);
+      n.y = base.y + r * sin(a);
+    }
+    n.phase = rng.GetRandom() % kSlotPulses;
+    n.rx_parity = rng.GetRandom() % 2;
+    n.next_routine_us =
+        start_us + rng.GetRandom() % (IR_SERVICE_ROUTINE_MS * 1000);
+    n.next_ctrl_us = start_us + rng.GetRandom() % (kRoutineIntervalMs * 1000);
+    n.next_offer_us = UINT64_MAX;
+    if (!n.base && config.load > 0) n.next_offer_us = start_us;
+    n.current_tx_slot = -1;
+    n.next_nonce = rng.GetRandom();
+    n.svc.SetOnBufferReceived((callback_t)&IrLogic::OnBufferReceivedEnqueueTask,
+                              &n.logic);
+    n.logic.SetOnPacketReceived(&IrAirSim::OnPacket, &n);
+    n.logic.SetTxFec(n.base && config.fec);
+    n.logic.SetTxFast(n.base && config.fast);
+    order.push_back(&n);
+  }
+  std::sort(order.begin(), order.end(),
+            [](Node *a, Node *b) { return a->phase < b->phase; });
+
+  hears.resize(count * count);
+  for (unsigned a = 0; a < count; a++) {
+    for (unsigned b = 0; b < count; b++) {
+      const double dx = nodes[a]->x - nodes[b]->x,
+                   dy = nodes[a]->y - nodes[b]->y;
+      hears[a * count + b] =
+          a != b && dx * dx + dy * dy <= config.range * config.range;
+    }
+  }
+
+  // Run() returns whenever the nodes are done with what the last interrupt
+  // queued, and the dispatches take no virtual time.
+  g_sched_probe.SetStopWhenIdle(true);
+  g_sched_probe.SetTaskCost(0, 0);
+}
+
+void IrAirSim::Run() {
+  const uint64_t slots =
+      config.seconds * IR_SERVICE_TX_RATE_HZ / kSlotPulses;
+  for (uint64_t slot = 0; slot < slots; slot++) {
+    // Nobody reads further back than an rx half.
+    const uint64_t oldest = slot * kSlotPulses;
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [oldest](Node *n) {
+                                  if (n->on_until + kRxHalfPulses > oldest)
+                                    return false;
+                                  n->active = false;
+                                  return true;
+                                }),
+                 active.end());
+    for (Node *n : order) Step(*n, slot);
+  }
+  for (auto &n : nodes) {
+    if (n->base) continue;
+    for (const QueuedPacket &p : n->queued) {
+      if (p.status != kRetransmitStatusSlotUnused) stats.pending++;
+    }
+  }
+}
+
+void IrAirSim::Step(Node &n, uint64_t slot) {
+  const uint64_t pulse = slot * kSlotPulses + n.phase;
+  const uint64_t now_us = NowUs(pulse);
+  g_virtual_clock.AdvanceTo(now_us);
+
+  while (now_us >= n.next_routine_us) {
+    n.svc.Routine(nullptr);
+    n.next_routine_us += IR_SERVICE_ROUTINE_MS * 1000;
+  }
+  if (n.base) {
+    SendAck(n);
+  } else {
+    while (now_us >= n.next_offer_us) {
+      Offer(n, n.next_offer_us);
+      // Poisson arrivals.
+      const double u = (rng.GetRandom() + 0.5) / 4294967296.0;
+      n.next_offer_us += static_cast<uint64_t>(-log(u) / config.load * 1e6);
+    }
+    while (now_us >= n.next_ctrl_us) {
+      MaintainQueued(n, now_us);
+      n.next_ctrl_us += kRoutineIntervalMs * 1000;
+    }
+  }
+
+  // The tx half that just went out is refilled, it's on air one slot later.
+  n.svc.PopulateTxDmaBuffer(reinterpret_cast<void *>(n.tx_side));
+  RefillTx(n, pulse + kSlotPulses);
+  n.tx_side ^= 1;
+
+  if (slot % 2 != n.rx_parity) return;
+  FillRx(n, pulse);
+  const bool sending = n.svc.tx_state >> 24 >= 3;
+  n.svc.PullRxDmaBuffer(reinterpret_cast<void *>(n.rx_side));
+  if (sending && n.svc.tx_state >> 24 == 2) stats.aborts++;
+  n.rx_side ^= 1;
+  if (!n.svc.rx_on_buffer_callback_finished) {
+    // Let it decode, and maybe answer.
+    g_sched_probe.SetStopTime(UINT64_MAX);
+    scheduler.Run();
+  }
+}
+
+void IrAirSim::RefillTx(Node &n, uint64_t pulse) {
+  const uint16_t *ccr = reinterpret_cast<const uint16_t *>(
+      &n.svc.tx_dma_buffer[n.tx_side * IR_SERVICE_TX_SIZE / 2]);
+  uint64_t bits[2] = {};
+  for (unsigned i = 0; i < kSlotPulses; i++) {
+    if (ccr[i]) bits[i / 64] |= 1ULL << (i % 64);
+  }
+  WriteRing(n.ring, pulse, bits[0]);
+  WriteRing(n.ring, pulse + 64, bits[1]);
+  if (!(bits[0] | bits[1])) return;
+  n.on_until = pulse + kSlotPulses;
+  if (!n.active) {
+    n.active = true;
+    active.push_back(&n);
+  }
+}
+
+void IrAirSim::FillRx(Node &n, uint64_t pulse) {
+  // The rx half that ended just now.
+  const uint64_t first = pulse - kRxHalfPulses;
+  uint64_t air[kRxHalfPulses / 64] = {};
+  const unsigned count = nodes.size();
+  for (const Node *t : active) {
+    if (t->on_until <= first || !hears[n.id * count + t->id]) continue;
+    for (unsigned k = 0; k < kRxHalfPulses / 64; k++) {
+      air[k] |= ReadRing(t->ring, first + k * 64);
+    }
+  }
+  uint64_t any = 0;
+  for (uint64_t bits : air) any |= bits;
+  uint16_t *dst = &n.svc.rx_dma_buffer[n.rx_side * IR_SERVICE_RX_SIZE];
+  for (unsigned i = 0; i < IR_SERVICE_RX_SIZE; i++) {
+    const unsigned p = i * kPulsesPerSample;
+    bool on = (air[p / 64] >> (p % 64)) & 1;
+    if (n.base) {
+      stats.samples++;
+      stats.carrier += on;
+    }
+    if (any && rng.GetRandom() < error_threshold) on = !on;
+    // The receiver pulls the pin low on a carrier.
+    dst[i] = on ? 0xFFFF & ~IrRx_Pin : 0xFFFF;
+  }
+}
+
+void IrAirSim::Offer(Node &n, uint64_t now_us) {
+  stats.offered++;
+  for (QueuedPacket &p : n.queued) {
+    if (p.status != kRetransmitStatusSlotUnused) continue;
+    p.status = kRetransmitStatusWaitTxSlot;
+    p.retries = kRetries;
+    p.nonce = n.next_nonce++;
+    p.sent = false;
+    p.delivered = false;
+    p.offered_us = now_us;
+    return;
+  }
+  stats.queue_full++;
+}
+
+// IrController::MaintainQueued() from kRetransmitStatusWaitTxSlot on.
+void IrAirSim::MaintainQueued(Node &n, uint64_t now_us) {
+  if (n.svc.CanSendBufferNow()) n.current_tx_slot = -1;
+
+  for (size_t j = 0; j < RETX_QUEUE_SIZE; j++) {
+    size_t i = (j + (g_fast_random_pool.GetRandom() % RETX_QUEUE_SIZE)) %
+               RETX_QUEUE_SIZE;
+    QueuedPacket &p = n.queued[i];
+    if (p.status == kRetransmitStatusWaitTxSlot) {
+      if (n.current_tx_slot != -1) continue;
+      IrData data = {.ttl = 0, .type = packet_type::kProximity};
+      ProximityPacket &prox = data.opaq.proximity;
+      PutLe(prox.user, n.id, IR_USERNAME_LEN);
+      PutLe(prox.nonce, p.nonce, sizeof(prox.nonce));
+      for (uint8_t &b : prox.sig) b = rng.GetRandom();
+      if (!Send(n, reinterpret_cast<uint8_t *>(&data), kProximityLen)) {
+        continue;
+      }
+      n.current_tx_slot = i;
+      p.status = kRetransmitStatusWaitAck;
+      p.time_to_retry = config.retry_min +
+                        g_fast_random_pool.GetRandom() % config.retry_spread;
+      stats.sends++;
+      if (p.sent) stats.retransmits++;
+      p.sent = true;
+    } else if (p.status == kRetransmitStatusWaitAck) {
+      if (p.time_to_retry) {
+        p.time_to_retry--;
+      } else if (p.retries) {
+        p.retries--;
+        p.status = kRetransmitStatusWaitTxSlot;
+      } else {
+        p.status = kRetransmitStatusSlotUnused;
+        stats.failed++;
+      }
+    }
+  }
+}
+
+void IrAirSim::SendAck(Node &n) {
+  if (!n.ack_count) return;
+  IrData data = {.ttl = 0, .type = packet_type::kAcknowledge};
+  memcpy(data.opaq.acknowledge.packet_hash, n.acks[0], PACKET_HASH_LEN);
+  const int sent = Send(n, reinterpret_cast<uint8_t *>(&data), kAckLen);
+  if (!sent) return;
+  stats.acks_sent++;
+  stats.fast_acks += sent == 2;
+  n.ack_count--;
+  memmove(n.acks[0], n.acks[1], n.ack_count * PACKET_HASH_LEN);
+}
+
+// IrLogic::SendPacket() on this node.
+int IrAirSim::Send(Node &n, const uint8_t *data, size_t len) {
+  if (!n.svc.CanSendBufferNow()) return 0;
+  IrPacket packet;
+  n.logic.EncodePacket(const_cast<uint8_t *>(data), len, packet);
+  const bool fast = n.logic.UseFastPhy();
+  if (!n.svc.SendBuffer(packet.data_, packet.size_, true, fast)) return 0;
+  return fast ? 2 : 1;
+}
+
+void IrAirSim::OnPacket(void *node, void *packet) {
+  Node *n = static_cast<Node *>(node);
+  n->sim->OnPacket(*n, *static_cast<IrPacket *>(packet));
+}
+
+void IrAirSim::OnPacket(Node &n, const IrPacket &packet) {
+  const IrData &data = *reinterpret_cast<const IrData *>(&packet.data_[1]);
+  const size_t len = packet.size_ - 1;
+  // The user and nonce of a proximity packet make up the hash of its ack.
+  if (n.base && data.type == packet_type::kProximity && len == kProximityLen) {
+    const ProximityPacket &prox = data.opaq.proximity;
+    const uint32_t user = GetLe(prox.user, IR_USERNAME_LEN);
+    const uint16_t nonce = GetLe(prox.nonce, sizeof(prox.nonce));
+    if (user < nodes.size()) {
+      for (QueuedPacket &p : nodes[user]->queued) {
+        if (p.status != kRetransmitStatusSlotUnused && p.nonce == nonce &&
+            !p.delivered) {
+          p.delivered = true;
+          stats.delivered++;
+        }
+      }
+    }
+    if (n.ack_count == kAckQueueSize) {
+      stats.acks_dropped++;
+      return;
+    }
+    memcpy(n.acks[n.ack_count], prox.user, IR_USERNAME_LEN);
+    memcpy(n.acks[n.ack_count] + IR_USERNAME_LEN, prox.nonce,
+           sizeof(prox.nonce));
+    n.ack_count++;
+  } else if (!n.base && data.type == packet_type::kAcknowledge &&
+             len == kAckLen) {
+    // IrController::OnAcknowledgePacket()
+    const uint8_t *hash = data.opaq.acknowledge.packet_hash;
+    if (GetLe(hash, IR_USERNAME_LEN) != n.id) return;
+    const uint16_t nonce = GetLe(hash + IR_USERNAME_LEN, 2);
+    for (QueuedPacket &p : n.queued) {
+      if ((p.status == kRetransmitStatusWaitTxSlot ||
+           p.status == kRetransmitStatusWaitAck) &&
+          p.nonce == nonce) {
+        p.status = kRetransmitStatusSlotUnused;
+        stats.acked++;
+        stats.latency_ms.push_back((g_virtual_clock.Now() - p.offered_us) /
+                                   1000);
+      }
+    }
+  }
+}
+
+void IrAirSim::Report() {
+  std::vector<uint32_t> &lat = stats.latency_ms;
+  std::sort(lat.begin(), lat.end());
+  auto percentile = [&lat](unsigned p) -> unsigned {
+    return lat.empty() ? 0 : lat[(lat.size() - 1) * p / 100];
+  };
+  unsigned lf = 0;
+  for (auto &n : nodes) {
+    if (!n->base) lf += n->logic.GetLoadFactor();
+  }
+  printf("%6u %6.2f %6.4f %3s %4.0f%% %7llu %6llu %6llu %6llu %6.1f%% %8.1f "
+         "%6llu %6llu %7llu %6u %6u %6u %5.1f%% %4u%%\n",
+         config.badges, config.load, config.sample_error,
+         config.fec ? "on" : "off",
+         stats.acks_sent ? 100.0 * stats.fast_acks / stats.acks_sent : 0.0,
+         (unsigned long long)stats.offered,
+         (unsigned long long)stats.sends,
+         (unsigned long long)stats.retransmits,
+         (unsigned long long)stats.aborts,
+         stats.offered ? 100.0 * stats.delivered / stats.offered : 0.0,
+         static_cast<double>(stats.delivered) * kProximityLen / config.seconds,
+         (unsigned long long)stats.acked, (unsigned long long)stats.failed,
+         (unsigned long long)stats.pending,
+         percentile(50), percentile(90), percentile(99),
+         stats.samples ? 100.0 * stats.carrier / stats.samples : 0.0,
+         config.badges ? lf / config.badges : 0);
+}
+
+}  // namespace host
+}  // namespace hitcon
+
+using namespace hitcon::host;
+
+namespace {
+
+std::vector<double> ParseList(const char *arg) {
+  std::vector<double> values;
+  char *end;
+  while (*arg) {
+    values.push_back(strtod(arg, &end));
+    if (end == arg) break;
+    arg = *end == ',' ? end + 1 : end;
+  }
+  return values;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Config config;
+  std::vector<double> badges = {8, 32};
+  std::vector<double> loads = {0.05, 0.2};
+  std::vector<double> errors = {config.sample_error};
+  std::vector<double> fecs = {0};
+  std::vector<double> fasts = {0};
+  int opt;
+  while ((opt = getopt(argc, argv, "n:l:t:b:r:e:f:p:w:s:")) != -1) {
+    switch (opt) {
+      case 'n':
+        badges = ParseList(optarg);
+        break;
+      case 'l':
+        loads = ParseList(optarg);
+        break;
+      case 't':
+        config.seconds = atof(optarg);
+        break;
+      case 'b':
+        config.bases = atoi(optarg);
+        break;
+      case 'r':
+        config.range = atof(optarg);
+        break;
+      case 'e':
+        errors = ParseList(optarg);
+        break;
+      case 'f':
+        fecs = ParseList(optarg);
+        break;
+      case 'p':
+        fasts = ParseList(optarg);
+        break;
+      case 'w': {
+        std::vector<double> wait = ParseList(optarg);
+        if (wait.size() != 2 || wait[1] < 1) return 1;
+        config.retry_min = wait[0];
+        config.retry_spread = wait[1];
+        break;
+      }
+      case 's':
+        config.seed = strtoull(optarg, nullptr, 0);
+        break;
+      default:
+        fprintf(stderr,
+                "usage: %s [-n badges,...] [-l packets_per_s,...] [-t s] "
+                "[-b bases] [-r range_m] [-e sample_error,...] [-f fec,...] "
+                "[-p fast,...] [-w min,spread] [-s seed]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+  if (config.bases < 1) return 1;
+
+  printf("IR air sim: %.0f s, %u base stations, range %.1f m, retry after "
+         "%u+%u routines\n",
+         config.seconds, config.bases, config.range, config.retry_min,
+         config.retry_spread);
+  printf("badges load/s  error fec fast%% offered   sent   retx aborts  "
+         "deliv%%  goodput  acked failed pending    p50    p90    p99   air%%  "
+         "lf%%\n");
+  printf("                           acks                                   "
+         "        B/s                           latency ms\n");
+  for (double n : badges) {
+    for (double load : loads) {
+      for (double error : errors) {
+        for (double fec : fecs) {
+          for (double fast : fasts) {
+            config.badges = n;
+            config.load = load;
+            config.sample_error = error;
+            config.fec = fec;
+            config.fast = fast;
+            IrAirSim sim(config);
+            sim.Run();
+            sim.Report();
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+#endif  // HITCON_HOST_BUILD
@@ -0,0 +1,93 @@
+#ifdef HITCON_HOST_BUILD
+
+// Runs the whole badge (hitcon_run()) headless against the HAL stubs for a
+// span of virtual time, then prints per task latency and queue depth.
+//
+// Usage: test-host [-t virtual_ms] [-c cost_us_per_task] [-s host_scale]
+
+#include <Hitcon.h>
+#include <Host/HalStub.h>
+#include <Host/SchedProbe.h>
+#include <Host/VirtualClock.h>
+#include <Logic/EcLogic.h>
+#include <Service/HashService.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace hitcon::host;
+
+namespace {
+
+// my_assert() fails by writing to nullptr, print where that happened.
+void OnSegv(int sig) {
+  void *frames[32];
+  int n = backtrace(frames, 32);
+  fprintf(stderr, "SIGSEGV at virtual time %llu us\n",
+          (unsigned long long)g_virtual_clock.Now());
+  backtrace_symbols_fd(frames, n, STDERR_FILENO);
+  _exit(128 + sig);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  unsigned run_ms = 10000;
+  unsigned cost_us = 30;
+  double host_scale = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:c:s:")) != -1) {
+    switch (opt) {
+      case 't':
+        run_ms = atoi(optarg);
+        break;
+      case 'c':
+        cost_us = atoi(optarg);
+        break;
+      case 's':
+        host_scale = atof(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-t ms] [-c cost_us] [-s host_scale]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+
+  signal(SIGSEGV, &OnSegv);
+  HalInit();
+  g_sched_probe.SetStopTime(run_ms * 1000ULL);
+  g_sched_probe.SetTaskCost(cost_us, host_scale);
+  hitcon_run();
+  g_sched_probe.Report(stdout);
+
+  const hitcon::hash::HashQueueStats &hash =
+      hitcon::hash::g_hash_service.GetQueueStats();
+  printf("hash queue: %u done, %u rejected, max depth %u, wait avg %u ms "
+         "max %u ms\n",
+         (unsigned)hash.completed, (unsigned)hash.rejected,
+         (unsigned)hash.maxDepth,
+         hash.completed ? (unsigned)(hash.totalWait / hash.completed) : 0,
+         (unsigned)hash.maxWait);
+
+  const hitcon::ecc::PresigStats &presig =
+      hitcon::ecc::g_ec_logic.GetPresigStats();
+  printf("presig pool: %u/%u ready, %u made, %u used, %u missed\n",
+         (unsigned)hitcon::ecc::g_ec_logic.GetPresigCount(),
+         (unsigned)hitcon::ecc::kPresigPoolSize, (unsigned)presig.generated,
+         (unsigned)presig.used, (unsigned)presig.missed);
+
+  const hitcon::ecc::EcQueueStats &ecc =
+      hitcon::ecc::g_ec_logic.GetQueueStats();
+  printf("ecc queue: %u done, %u rejected, max depth %u, wait avg %u ms "
+         "max %u ms\n",
+         (unsigned)ecc.completed, (unsigned)ecc.rejected,
+         (unsigned)ecc.maxDepth,
+         ecc.completed ? (unsigned)(ecc.totalWait / ecc.completed) : 0,
+         (unsigned)ecc.maxWait);
+  return 0;
+}
+
+#endif  // HITCON_HOST_BUILD
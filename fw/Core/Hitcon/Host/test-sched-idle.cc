@@ -0,0 +1,72 @@
+#ifdef HITCON_HOST_BUILD
+
+// Checks that Scheduler::Idle() wakes up in time for a delayed task that is
+// still filed above level 0 of the timer wheel, while an earlier filed one
+// sits in level 0 past the next cascade. Each task has to run on its wake
+// tick.
+
+#include <Host/HalStub.h>
+#include <Host/SchedProbe.h>
+#include <Host/VirtualClock.h>
+#include <Service/Sched/DelayedTask.h>
+#include <Service/Sched/Scheduler.h>
+#include <Service/Sched/SysTimer.h>
+#include <stdio.h>
+
+using namespace hitcon::host;
+using namespace hitcon::service::sched;
+
+namespace {
+
+// The wheel has 32 ticks per level 0 round. far is 33 ticks out, so it goes
+// to level 1, near is filed on tick 29 for 40, so it goes to level 0.
+constexpr unsigned kFar = 33;
+constexpr unsigned kTrigger = 29;
+constexpr unsigned kNear = 40;
+
+unsigned g_start;
+uint64_t g_ran_us[3];
+
+void OnRun(void *index, void *) {
+  g_ran_us[reinterpret_cast<uintptr_t>(index)] = g_virtual_clock.Now();
+}
+
+DelayedTask g_far(800, &OnRun, reinterpret_cast<void *>(0), 0);
+DelayedTask g_near(800, &OnRun, reinterpret_cast<void *>(1), 0);
+
+void OnTrigger(void *, void *) {
+  OnRun(reinterpret_cast<void *>(2), nullptr);
+  g_near.SetWakeTime(g_start + kNear);
+  scheduler.Queue(&g_near, nullptr);
+}
+
+DelayedTask g_trigger(800, &OnTrigger, nullptr, 0);
+
+bool CheckRan(const char *name, unsigned index, unsigned offset) {
+  uint64_t want = (g_start + offset) * 1000ULL;
+  if (g_ran_us[index] >= want && g_ran_us[index] < want + 1000) return true;
+  printf("FAIL: %s due at %u ms ran at %llu us\n", name, offset,
+         (unsigned long long)(g_ran_us[index] - g_start * 1000ULL));
+  return false;
+}
+
+}  // namespace
+
+int main() {
+  HalInit();
+  g_start = SysTimer::GetTime();
+  g_far.SetWakeTime(g_start + kFar);
+  g_trigger.SetWakeTime(g_start + kTrigger);
+  scheduler.Queue(&g_far, nullptr);
+  scheduler.Queue(&g_trigger, nullptr);
+  g_sched_probe.SetStopTime((g_start + 2 * kNear) * 1000ULL);
+  scheduler.Run();
+  bool ok = CheckRan("trigger", 2, kTrigger);
+  ok &= CheckRan("far", 0, kFar);
+  ok &= CheckRan("near", 1, kNear);
+  if (!ok) return 1;
+  printf("Idle() woke on time for both wheel levels\n");
+  return 0;
+}
+
+#endif  // HITCON_HOST_BUILD
@@ -1,4 +1,5 @@
 #include <Logic/EcLogic.h>
+#include <Logic/ModArith.h>
 #include <Logic/RandomPool.h>
 #include <Service/HashService.h>
 #include <Service/PerBoardData.h>
@@ -22,114 +23,138 @@ namespace internal {
 #define UINT64_MSB (1ULL << 63)
 
 // Hardcoded curve parameters
-static const EllipticCurve g_curve(0x5e924cd447a56b, 0x892f0a953f589b);
-static const EcPoint g_generator({0x9a77dc33b36acc, 0xbcffb098340493},
-                                 {0x279be90a95dbdd, 0xbcffb098340493});
-static const uint64_t g_curveOrder = 0xbcffb09c43733d;
+static constexpr EllipticCurve g_curve(0x5e924cd447a56b, 0x892f0a953f589b);
+static constexpr uint64_t g_generatorX = 0x9a77dc33b36acc;
+static constexpr uint64_t g_generatorY = 0x279be90a95dbdd;
+static const EcPoint g_generator(g_generatorX, g_generatorY);
+static constexpr MontParams g_fieldMont = MakeMontParams(kFieldPrime);
+static constexpr MontParams g_orderMont = MakeMontParams(kCurveOrder);
+static const FieldNum g_curveA = FieldNum::FromPlain(g_curve.A);
+static const FieldNum g_fieldOne = FieldNum::FromPlain(1);
 // TODO: use GetPerBoardSecret to set the private key
-static const EcPoint g_serverPubKey({0x05cb6b63de507e, 0xbcffb098340493},
-                                    {0x4df751a1388b25, 0xbcffb098340493});
+static const EcPoint g_serverPubKey(0x05cb6b63de507e, 0x4df751a1388b25);
 
-constexpr inline uint64_t modneg(const uint64_t x, const uint64_t m) {
-  return m - (x % m);
-}
-
-constexpr inline uint64_t modadd(const uint64_t a, const uint64_t b,
-                                 const uint64_t m) {
-  if (a > UINT64_MAX - b)
-    return modneg((modneg(a, m) + modneg(b, m)) % m, m);
-  else
-    return (a + b) % m;
-}
-
-constexpr inline uint64_t modsub(const uint64_t a, const uint64_t b,
-                                 const uint64_t m) {
-  if (a >= b)
-    return a - b;
-  else
-    return a + m - b;
+template <uint64_t M>
+constexpr const MontParams &ModMont() {
+  static_assert(M == kFieldPrime || M == kCurveOrder, "Not a curve modulus");
+  return M == kCurveOrder ? g_orderMont : g_fieldMont;
 }
 
 inline uint64_t modmul(uint64_t a, uint64_t b, uint64_t m) {
-  uint64_t res = 0;
-  for (int i = 0; i < 64; ++i) {
-    res = modadd(res, res, m);
-    if (b & UINT64_MSB) res = modadd(res, a, m);
-    b <<= 1;
+#if ECC_MONTGOMERY
+  // For ModDivService, which takes m at run time but is only ever given the
+  // order or p. b has to be reduced, a doesn't.
+  if (m == kCurveOrder || m == kFieldPrime) {
+    if (b >= m) b %= m;
+    return modmul_mont(a, b, m == kCurveOrder ? g_orderMont : g_fieldMont);
   }
+#endif
+  return modmul_shiftadd(a, b, m);
+}
+
+template <uint64_t M>
+ModNum<M>::ModNum(uint64_t val) : val(val) {
+  if (val < M) return;
+#if ECC_MONTGOMERY
+  // val / R * R^2 / R, two multiply rows instead of a division.
+  this->val = montmul(montmul(val, 1, ModMont<M>()), ModMont<M>().r2,
+                      ModMont<M>());
+#else
+  this->val = val % M;
+#endif
+}
+
+// Both operands are below M < 2^56, so none of these overflow.
+template <uint64_t M>
+ModNum<M> ModNum<M>::operator-() const {
+  ModNum res;
+  res.val = val ? M - val : 0;
   return res;
 }
 
-uint64_t extgcd(uint64_t ppr, uint64_t pr) {
-  // return only coefficient of a
-  // only works under mod pr
-  // ignores division by zeroes
-  uint64_t m = pr;
-  uint64_t ppx = 1;
-  uint64_t px = 0;
-  while (pr != 1) {
-    uint64_t q = ppr / pr;
-    uint64_t r = ppr % pr;
-    uint64_t x = modsub(ppx, modmul(q, px, m), m);
-    ppr = pr;
-    pr = r;
-    ppx = px;
-    px = x;
-  }
-  return px;
+template <uint64_t M>
+ModNum<M> ModNum<M>::operator+(const ModNum &other) const {
+  ModNum res;
+  res.val = val + other.val;
+  if (res.val >= M) res.val -= M;
+  return res;
 }
 
-ModNum::ModNum(uint64_t val, uint64_t mod) : val(val), mod(mod) {}
-
-ModNum ModNum::operator=(const ModNum &other) {
-  val = other.val;
-  mod = other.mod;
-  return *this;
+template <uint64_t M>
+ModNum<M> ModNum<M>::operator-(const ModNum &other) const {
+  ModNum res;
+  res.val = modsub(val, other.val, M);
+  return res;
 }
 
-ModNum ModNum::operator=(const uint64_t other) {
-  val = other % mod;
-  return *this;
+template <uint64_t M>
+ModNum<M> ModNum<M>::operator*(const ModNum &other) const {
+  ModNum res;
+#if ECC_MONTGOMERY
+  res.val = modmul_mont(val, other.val, ModMont<M>());
+#else
+  res.val = modmul_shiftadd(val, other.val, M);
+#endif
+  return res;
 }
 
-ModNum ModNum::operator-() const { return ModNum(modneg(val, mod), mod); }
+template class ModNum<kFieldPrime>;
+template class ModNum<kCurveOrder>;
 
-ModNum ModNum::operator+(const ModNum &other) const {
-  return ModNum(modadd(val, other.val, mod), mod);
+FieldNum FieldNum::FromPlain(uint64_t x) {
+#if ECC_MONTGOMERY
+  return FromMont(tomont(x, g_fieldMont));
+#else
+  return FromMont(x % kFieldPrime);
+#endif
 }
 
-ModNum operator+(const uint64_t a, const ModNum &b) {
-  return ModNum(a, b.mod) + b;
+FieldNum FieldNum::FromMont(uint64_t mont) {
+  FieldNum res;
+  res.mont = mont;
+  return res;
 }
 
-ModNum ModNum::operator-(const ModNum &other) const {
-  uint64_t a = val, b = other.val, m = mod;
-  return ModNum(modsub(a, b, m), m);
+uint64_t FieldNum::ToPlain() const {
+#if ECC_MONTGOMERY
+  return frommont(mont, g_fieldMont);
+#else
+  return mont;
+#endif
 }
 
-ModNum ModNum::operator*(const ModNum &other) const {
-  uint64_t a = val, b = other.val, m = mod;
-  return ModNum(modmul(a, b, m), m);
+// Both operands are below p < 2^56, so none of these overflow. Negation is
+// the same in either form.
+FieldNum FieldNum::operator-() const {
+  return FromMont(mont ? kFieldPrime - mont : 0);
 }
 
-ModNum operator*(const uint64_t a, const ModNum &b) {
-  return ModNum(a, b.mod) * b;
+FieldNum FieldNum::operator+(const FieldNum &other) const {
+  uint64_t sum = mont + other.mont;
+  return FromMont(sum >= kFieldPrime ? sum - kFieldPrime : sum);
 }
 
-bool ModNum::operator==(const ModNum &other) const {
-  return val == other.val && mod == other.mod;
+FieldNum FieldNum::operator-(const FieldNum &other) const {
+  return FromMont(modsub(mont, other.mont, kFieldPrime));
 }
 
-bool ModNum::operator==(const uint64_t other) const { return val == other; }
+FieldNum FieldNum::operator*(const FieldNum &other) const {
+#if ECC_MONTGOMERY
+  return FromMont(montmul(mont, other.mont, g_fieldMont));
+#else
+  return FromMont(modmul_shiftadd(mont, other.mont, kFieldPrime));
+#endif
+}
 
 ModDivService g_mod_div_service;
 
 ModDivService::ModDivService()
-    : routineTask(803, (callback_t)&ModDivService::routineFunc, this),
-      finalizeTask(803, (callback_t)&ModDivService::finalize, this) {}
+    : res(0),
+      routineTask(803, (task_callback_t)&ModDivService::routineFunc, this) {}
 
 void ModDivService::start(uint64_t a, uint64_t b, uint64_t m,
-                          callback_t callback, void *callbackArg1) {
+                          callback_t callback, void *callbackArg1,
+                          unsigned prio) {
   this->callback = callback;
   this->callbackArg1 = callbackArg1;
   context.a = a;
@@ -138,36 +163,110 @@ void ModDivService::start(uint64_t a, uint64_t b, uint64_t m,
   context.pr = m;
   context.ppx = 1;
   context.px = 0;
-  context.res = 0;
-  scheduler.Queue(&routineTask, this);
+  routineTask.SetPriority(prio);
+  routineTask.Start(this);
+}
+
+void ModDivService::routineFunc(void *unused) {
+  CO_BEGIN(routineTask);
+  while (context.pr != 1) {
+    {
+      uint64_t q = context.ppr / context.pr;
+      uint64_t r = context.ppr % context.pr;
+      uint64_t x =
+          modsub(context.ppx, modmul(q, context.px, context.m), context.m);
+      context.ppr = context.pr;
+      context.pr = r;
+      context.ppx = context.px;
+      context.px = x;
+    }
+    if (!scheduler.RemainingBudget()) CO_YIELD(routineTask);
+  }
+  CO_END(routineTask);
+  res = modmul(context.a, context.px, context.m);
+  callback(callbackArg1, &res);
 }
 
-void ModDivService::routineFunc() {
-  if (context.pr == 1) {
-    context.res = modmul(context.a, context.px, context.m);
-    scheduler.Queue(&finalizeTask, this);
-    return;
+BatchInvService g_batch_inv_service;
+
+BatchInvService::BatchInvService()
+    : count(0), batchSize(0), running(false), batches(0), inversions(0),
+      routineTask(804, (task_callback_t)&BatchInvService::routineFunc, this) {}
+
+bool BatchInvService::start(uint64_t x, uint64_t m, callback_t callback,
+                            void *callbackArg1, unsigned prio) {
+  if (count == kBatchInvSize) return false;
+  // A 0 would zero the whole product.
+  x = m == kCurveOrder ? ModNum<kCurveOrder>(x).val
+                       : ModNum<kFieldPrime>(x).val;
+  if (x == 0) return false;
+  requests[count++] = Request{x, m, callback, callbackArg1, prio};
+  // Otherwise routineFunc() gets to it after the current batch. count alone
+  // can't tell, a callback of the last batch sees it back at 1.
+  if (!running) {
+    running = true;
+    routineTask.SetPriority(prio);
+    routineTask.Start(nullptr);
   }
-  uint64_t q = context.ppr / context.pr;
-  uint64_t r = context.ppr % context.pr;
-  uint64_t x = modsub(context.ppx, modmul(q, context.px, context.m), context.m);
-  context.ppr = context.pr;
-  context.pr = r;
-  context.ppx = context.px;
-  context.px = x;
-  scheduler.Queue(&routineTask, this);
-}
-
-void ModDivService::finalize() {
-  ModNum res(context.res, context.m);
-  callback(callbackArg1, &res);
+  return true;
+}
+
+void BatchInvService::routineFunc(void *result) {
+  CO_BEGIN(routineTask);
+  while (count) {
+    {
+      // Everything up front that's mod the same m.
+      const uint64_t m = requests[0].m;
+      unsigned prio = requests[0].prio;
+      prefix[0] = requests[0].x;
+      for (batchSize = 1; batchSize < count && requests[batchSize].m == m;
+           batchSize++) {
+        prefix[batchSize] =
+            modmul(prefix[batchSize - 1], requests[batchSize].x, m);
+        if (requests[batchSize].prio < prio) prio = requests[batchSize].prio;
+      }
+      // Not queued while it runs.
+      routineTask.SetPriority(prio);
+    }
+    CO_AWAIT(routineTask,
+             g_mod_div_service.start(1, prefix[batchSize - 1], requests[0].m,
+                                     &CoTask::Resume, &routineTask,
+                                     routineTask.GetPriority()));
+    {
+      // inv is 1 / (x0 * ... * xi), walking i down.
+      const uint64_t m = requests[0].m;
+      uint64_t inv = *static_cast<uint64_t *>(result);
+      for (uint8_t i = batchSize - 1; i > 0; i--) {
+        prefix[i] = modmul(inv, prefix[i - 1], m);
+        inv = modmul(inv, requests[i].x, m);
+      }
+      prefix[0] = inv;
+      batches++;
+      inversions += batchSize;
+
+      // Take the batch out first, the callbacks may make new requests.
+      Request done[kBatchInvSize];
+      const uint8_t size = batchSize;
+      memcpy(done, requests, sizeof(Request) * size);
+      count -= size;
+      memmove(requests, requests + size, sizeof(Request) * count);
+      for (uint8_t i = 0; i < size; i++) {
+        done[i].callback(done[i].callbackArg1, &prefix[i]);
+      }
+    }
+  }
+  running = false;
+  CO_END(routineTask);
 }
 
-EllipticCurve::EllipticCurve(const uint64_t A, const uint64_t B) : A(A), B(B) {}
+EcPoint::EcPoint() : isInf(true) {}
 
-EcPoint::EcPoint() : x{0, 0}, y{0, 0}, isInf(true) {}
+EcPoint::EcPoint(const ModNum<kFieldPrime> &x, const ModNum<kFieldPrime> &y)
+    : isInf(false), x(FieldNum::FromPlain(x.val)),
+      y(FieldNum::FromPlain(y.val)) {}
 
-EcPoint::EcPoint(const ModNum &x, const ModNum &y) : x(x), y(y), isInf(false) {}
+EcPoint::EcPoint(const FieldNum &x, const FieldNum &y)
+    : isInf(false), x(x), y(y) {}
 
 EcPoint EcPoint::operator=(const EcPoint &other) {
   isInf = other.isInf;
@@ -186,7 +285,7 @@ bool EcPoint::operator==(const EcPoint &other) const {
   return x == other.x && y == other.y;
 }
 
-uint64_t EcPoint::xval() const { return x.val; }
+uint64_t EcPoint::xval() const { return x.ToPlain(); }
 
 bool EcPoint::identity() const { return isInf; }
 
@@ -205,9 +304,10 @@ bool EcPoint::getCompactForm(uint8_t *buffer, size_t len) const {
 
   // Copy the x-coordinate value (uint64_t) into the buffer.
   // Note: We assume the environment is little-endian.
-  memcpy(buffer, &(x.val), sizeof(uint64_t));
+  uint64_t xPlain = x.ToPlain();
+  memcpy(buffer, &xPlain, sizeof(uint64_t));
 
-  uint8_t sign_bit = y.val & 1;
+  uint8_t sign_bit = y.ToPlain() & 1;
 
   // The sign bit is stored in the MSB of the last byte
   // of the output buffer. Since we copied sizeof(uint64_t) bytes, the last
@@ -223,72 +323,227 @@ bool EcPoint::getCompactForm(uint8_t *buffer, size_t len) const {
   return true;
 }
 
-PointAddContext::PointAddContext() : l(0, 1) {}
-
 PointAddService g_point_add_service;
 
 PointAddService::PointAddService()
-    : routineTask(802, (callback_t)&PointAddService::routineFunc, this),
-      finalizeTask(802, (callback_t)&PointAddService::finalize, this),
-      genXTask(802, (callback_t)&PointAddService::genX, this),
-      genYTask(802, (callback_t)&PointAddService::genY, this) {}
+    : routineTask(802, (task_callback_t)&PointAddService::routineFunc, this) {
+}
 
 void PointAddService::start(const EcPoint &a, const EcPoint &b,
-                            callback_t callback, void *callbackArg1) {
+                            callback_t callback, void *callbackArg1,
+                            unsigned prio) {
   context.a = a;
   context.b = b;
   this->callback = callback;
   this->callbackArg1 = callbackArg1;
-  scheduler.Queue(&routineTask, this);
+  routineTask.SetPriority(prio);
+  routineTask.Start(this);
 }
 
-void PointAddService::routineFunc() {
-  if (context.a.identity()) {
-    context.res = context.b;
-    scheduler.Queue(&finalizeTask, this);
-  } else if (context.b.identity()) {
-    context.res = context.a;
-    scheduler.Queue(&finalizeTask, this);
-  } else if (context.a == -context.b) {
-    context.res = EcPoint();
-    scheduler.Queue(&finalizeTask, this);
-  } else if (context.a == context.b) {
+void PointAddService::startSlope() {
+  if (context.a == context.b) {
     // double the point
     // Original formula is 3 * x^2 + A, but we do the addition 3 times instead
     // to avoid the expensive multiplication.
-    ModNum l_top = context.a.x * context.a.x;
-    l_top = l_top + l_top + l_top + ModNum(g_curve.A, l_top.mod);
+    FieldNum l_top = context.a.x * context.a.x;
+    l_top = l_top + l_top + l_top + g_curveA;
     // Same applies here, original formula is 2 * y
-    ModNum l_bot = context.a.y + context.a.y;
-    g_mod_div_service.start(l_top.val, l_bot.val, l_top.mod,
-                            (callback_t)&PointAddService::onDivDone, this);
+    FieldNum l_bot = context.a.y + context.a.y;
+    // Dividing the Montgomery form of the top by the plain bottom leaves the
+    // quotient in Montgomery form.
+    g_mod_div_service.start(l_top.mont, l_bot.ToPlain(), kFieldPrime,
+                            &CoTask::Resume, &routineTask,
+                            routineTask.GetPriority());
   } else {
     // intersect directly
-    ModNum l_top = context.b.y - context.a.y;
-    ModNum l_bot = context.b.x - context.a.x;
-    g_mod_div_service.start(l_top.val, l_bot.val, l_top.mod,
-                            (callback_t)&PointAddService::onDivDone, this);
+    FieldNum l_top = context.b.y - context.a.y;
+    FieldNum l_bot = context.b.x - context.a.x;
+    g_mod_div_service.start(l_top.mont, l_bot.ToPlain(), kFieldPrime,
+                            &CoTask::Resume, &routineTask,
+                            routineTask.GetPriority());
   }
 }
 
-void PointAddService::onDivDone(ModNum *l) {
-  context.l = *l;
-  scheduler.Queue(&genXTask, this);
+void PointAddService::routineFunc(uint64_t *l) {
+  CO_BEGIN(routineTask);
+  if (context.a.identity()) {
+    context.res = context.b;
+  } else if (context.b.identity()) {
+    context.res = context.a;
+  } else if (context.a == -context.b) {
+    context.res = EcPoint();
+  } else {
+    CO_AWAIT(routineTask, startSlope());
+    context.l = FieldNum::FromMont(*l);
+    context.res.isInf = false;
+    context.res.x = context.l * context.l - context.a.x - context.b.x;
+    context.res.y = context.l * (context.a.x - context.res.x) - context.a.y;
+  }
+  CO_END(routineTask);
+  callback(callbackArg1, &context.res);
+}
+
+JacobianPoint::JacobianPoint() {}
+
+JacobianPoint::JacobianPoint(const EcPoint &p) : X(p.x), Y(p.y) {
+  if (!p.isInf) Z = g_fieldOne;
+}
+
+bool JacobianPoint::identity() const { return Z == FieldNum(); }
+
+// The formulas are dbl-2007-bl and madd-2007-bl from the Explicit-Formulas
+// Database (hyperelliptic.org/EFD), the curve's A isn't -3 so no shortcut
+// there.
+void JacobianPoint::Double() {
+  FieldNum XX = X * X;
+  FieldNum YY = Y * Y;
+  FieldNum YYYY = YY * YY;
+  FieldNum ZZ = Z * Z;
+  // S = 4 * X * YY
+  FieldNum S = (X + YY) * (X + YY) - XX - YYYY;
+  S = S + S;
+  // M = 3 * XX + A * ZZ^2
+  FieldNum M = XX + XX + XX + g_curveA * ZZ * ZZ;
+  FieldNum T = M * M - S - S;
+  // Z3 = 2 * Y * Z, which also keeps the identity at Z = 0.
+  Z = (Y + Z) * (Y + Z) - YY - ZZ;
+  X = T;
+  FieldNum Y8 = YYYY + YYYY;
+  Y8 = Y8 + Y8;
+  Y8 = Y8 + Y8;
+  Y = M * (S - T) - Y8;
+}
+
+void JacobianPoint::AddAffine(const EcPoint &p) {
+  if (p.isInf) return;
+  if (identity()) {
+    *this = JacobianPoint(p);
+    return;
+  }
+  FieldNum Z1Z1 = Z * Z;
+  FieldNum H = p.x * Z1Z1 - X;
+  FieldNum r = p.y * Z * Z1Z1 - Y;
+  if (H == FieldNum()) {
+    // Same x, so p is either this point or its negation.
+    if (r == FieldNum())
+      Double();
+    else
+      *this = JacobianPoint();
+    return;
+  }
+  FieldNum HH = H * H;
+  FieldNum I = HH + HH;
+  I = I + I;
+  FieldNum J = H * I;
+  r = r + r;
+  FieldNum V = X * I;
+  X = r * r - J - V - V;
+  FieldNum YJ = Y * J;
+  Y = r * (V - X) - YJ - YJ;
+  Z = (Z + H) * (Z + H) - Z1Z1 - HH;
+}
+
+EcPoint JacobianPoint::ToAffine(const FieldNum &zinv) const {
+  if (identity()) return EcPoint();
+  FieldNum zinv2 = zinv * zinv;
+  return EcPoint(X * zinv2, Y * zinv2 * zinv);
+}
+
+namespace {
+
+// Fixed-base comb (Lim-Lee) for multiples of G. The scalar, below the order
+// and so 56 bits, is cut into kCombTeeth rows of kCombCols bits. Entry j - 1
+// of the table is the sum of 2^(t * kCombCols) * G over the bits t set in j,
+// so one doubling and one lookup handle a bit of every row at once.
+constexpr unsigned kCombTeeth = ECC_COMB_TEETH;
+constexpr unsigned kCombCols = (56 + kCombTeeth - 1) / kCombTeeth;
+constexpr unsigned kCombSize = (1u << kCombTeeth) - 1;
+static_assert(kCombTeeth >= 1 && kCombTeeth <= 8, "ECC_COMB_TEETH");
+static_assert(kCurveOrder >> 56 == 0, "The comb covers 56 bit scalars");
+
+// Affine points with plain coordinates, only for building the table at
+// compile time.
+struct ConstPoint {
+  uint64_t x, y;
+  bool inf;
+};
+
+constexpr ConstPoint ConstAdd(const ConstPoint &a, const ConstPoint &b) {
+  if (a.inf) return b;
+  if (b.inf) return a;
+  const uint64_t p = kFieldPrime;
+  uint64_t l = 0;
+  if (a.x == b.x) {
+    if (a.y != b.y || a.y == 0) return ConstPoint{0, 0, true};
+    uint64_t xx = modmul_mont(a.x, a.x, g_fieldMont);
+    uint64_t top = modadd(modadd(modadd(xx, xx, p), xx, p), g_curve.A, p);
+    l = modmul_mont(top, modinv_prime(modadd(a.y, a.y, p), g_fieldMont),
+                    g_fieldMont);
+  } else {
+    l = modmul_mont(modsub(b.y, a.y, p),
+                    modinv_prime(modsub(b.x, a.x, p), g_fieldMont),
+                    g_fieldMont);
+  }
+  uint64_t x = modsub(modsub(modmul_mont(l, l, g_fieldMont), a.x, p), b.x, p);
+  uint64_t y =
+      modsub(modmul_mont(l, modsub(a.x, x, p), g_fieldMont), a.y, p);
+  return ConstPoint{x, y, false};
+}
+
+// In the form FieldNum keeps.
+struct CombEntry {
+  uint64_t x, y;
+};
+
+struct CombTable {
+  CombEntry entries[kCombSize];
+};
+
+constexpr CombTable MakeCombTable() {
+  ConstPoint sums[kCombSize] = {};
+  ConstPoint row{g_generatorX, g_generatorY, false};
+  for (unsigned t = 0; t < kCombTeeth; t++) {
+    // row is 2^(t * kCombCols) * G, the entries with t as the top bit are row
+    // plus the ones before them.
+    const unsigned bit = 1u << t;
+    sums[bit - 1] = row;
+    for (unsigned j = bit + 1; j < 2 * bit; j++) {
+      sums[j - 1] = ConstAdd(row, sums[j - bit - 1]);
+    }
+    for (unsigned i = 0; i < kCombCols; i++) row = ConstAdd(row, row);
+  }
+  CombTable table = {};
+  for (unsigned j = 0; j < kCombSize; j++) {
+#if ECC_MONTGOMERY
+    table.entries[j] = {tomont(sums[j].x, g_fieldMont),
+                        tomont(sums[j].y, g_fieldMont)};
+#else
+    table.entries[j] = {sums[j].x, sums[j].y};
+#endif
+  }
+  return table;
 }
 
-void PointAddService::genX() {
-  context.res.x = context.l * context.l - context.a.x - context.b.x;
-  scheduler.Queue(&genYTask, this);
+constexpr CombTable g_combTable = MakeCombTable();
+
+// Entry index for column col of the scalar k, 0 if all its bits are clear.
+unsigned CombIndex(uint64_t k, unsigned col) {
+  unsigned idx = 0;
+  for (unsigned t = 0; t < kCombTeeth; t++) {
+    idx |= ((k >> (t * kCombCols + col)) & 1) << t;
+  }
+  return idx;
 }
 
-void PointAddService::genY() {
-  context.res.y = context.l * (context.a.x - context.res.x) - context.a.y;
-  scheduler.Queue(&finalizeTask, this);
+EcPoint CombPoint(unsigned idx) {
+  const CombEntry &e = g_combTable.entries[idx - 1];
+  return EcPoint(FieldNum::FromMont(e.x), FieldNum::FromMont(e.y));
 }
 
-void PointAddService::finalize() { callback(callbackArg1, &context.res); }
+}  // namespace
 
-PointMultContext::PointMultContext() : p(g_generator), res(g_generator) {}
+PointMultContext::PointMultContext()
+    : mode(kGeneric), p(g_generator), res(g_generator) {}
 
 PointMultService g_point_mult_service;
 
@@ -296,40 +551,100 @@ PointMultService::PointMultService()
     : routineTask(801, (task_callback_t)&PointMultService::routineFunc,
                   (void *)this) {}
 
-void PointMultService::routineFunc() {
-  if (context.i == 128) {
-    callback(callbackArg1, &context.res);
-  } else {
-    if (context.i & 1) {
-      if (context.times & UINT64_MSB)
-        g_point_add_service.start(context.p, context.res,
-                                  (callback_t)&PointMultService::onAddDone,
-                                  this);
-      else
-        scheduler.Queue(&routineTask, this);
+void PointMultService::addForBit() {
+  const unsigned bit = context.steps - 1 - context.i;
+  switch (context.mode) {
+    case PointMultContext::kGeneric:
+      if (context.times & UINT64_MSB) context.sum.AddAffine(context.p);
       context.times <<= 1;
-    } else {
-      g_point_add_service.start(context.res, context.res,
-                                (callback_t)&PointMultService::onAddDone, this);
+      break;
+    case PointMultContext::kFixedBase: {
+      unsigned idx = CombIndex(context.times, bit);
+      if (idx) context.sum.AddAffine(CombPoint(idx));
+      break;
     }
-    ++context.i;
+    case PointMultContext::kJoint:
+      switch ((context.times >> bit & 1) | (context.times2 >> bit & 1) << 1) {
+        case 1:
+          context.sum.AddAffine(context.p);
+          break;
+        case 2:
+          context.sum.AddAffine(context.q);
+          break;
+        case 3:
+          context.sum.AddAffine(context.pq);
+          break;
+      }
+      break;
   }
 }
 
-void PointMultService::onAddDone(EcPoint *res) {
-  context.res = *res;
-  scheduler.Queue(&routineTask, this);
+void PointMultService::routineFunc(void *result) {
+  CO_BEGIN(routineTask);
+  if (context.mode == PointMultContext::kJoint) {
+    CO_AWAIT(routineTask,
+             g_point_add_service.start(context.p, context.q, &CoTask::Resume,
+                                       &routineTask,
+                                       routineTask.GetPriority()));
+    context.pq = *static_cast<EcPoint *>(result);
+  }
+  for (context.i = 0; context.i < context.steps; ++context.i) {
+    context.sum.Double();
+    addForBit();
+    if (!scheduler.RemainingBudget()) CO_YIELD(routineTask);
+  }
+  if (context.sum.identity()) {
+    context.res = EcPoint();
+  } else {
+    // Like the slope in PointAddService, one in Montgomery form over the plain
+    // Z leaves 1 / Z in Montgomery form.
+    CO_AWAIT(routineTask,
+             g_mod_div_service.start(g_fieldOne.mont,
+                                     context.sum.zcoord().ToPlain(),
+                                     kFieldPrime, &CoTask::Resume,
+                                     &routineTask, routineTask.GetPriority()));
+    context.res = context.sum.ToAffine(
+        FieldNum::FromMont(*static_cast<uint64_t *>(result)));
+  }
+  CO_END(routineTask);
+  callback(callbackArg1, &context.res);
 }
 
 void PointMultService::start(const EcPoint &p, uint64_t times,
-                             callback_t callback, void *callbackArg1) {
+                             callback_t callback, void *callbackArg1,
+                             unsigned prio) {
+  context.mode = PointMultContext::kGeneric;
   context.p = p;
   context.times = times;
   context.i = 0;
+  context.steps = 64;
+  context.sum = JacobianPoint();
   context.res = EcPoint();
   this->callback = callback;
   this->callbackArg1 = callbackArg1;
-  scheduler.Queue(&routineTask, this);
+  routineTask.SetPriority(prio);
+  routineTask.Start(this);
+}
+
+void PointMultService::startGenerator(uint64_t times, callback_t callback,
+                                      void *callbackArg1, unsigned prio) {
+  // times * G only depends on times mod the order, which fits the comb.
+  start(g_generator, ScalarNum(times).val, callback, callbackArg1, prio);
+  // The routine has only been queued so far.
+  context.mode = PointMultContext::kFixedBase;
+  context.steps = kCombCols;
+}
+
+void PointMultService::startJoint(const EcPoint &p, uint64_t times,
+                                  const EcPoint &q, uint64_t times2,
+                                  callback_t callback, void *callbackArg1,
+                                  unsigned prio) {
+  // Reduced like in startGenerator(), the scalars are 56 bits.
+  start(p, ScalarNum(times).val, callback, callbackArg1, prio);
+  context.mode = PointMultContext::kJoint;
+  context.q = q;
+  context.times2 = ScalarNum(times2).val;
+  context.steps = 56;
 }
 
 }  // namespace internal
@@ -347,135 +662,235 @@ void Signature::fromBuffer(const uint8_t *buffer) {
 }
 
 EcContext::EcContext()
-    : r(0, g_curveOrder), s(0, g_curveOrder), u1(0, g_curveOrder),
-      u2(0, g_curveOrder) {}
+    : k{}, presig{}, presigWant(0), presigMade(0), presigned(false) {}
 
 bool EcLogic::StartSign(uint8_t const *message, uint32_t len,
                         callback_t callback, void *callbackArg1) {
-  if (busy) return false;
   if (!publicKeyReady) return false;
-  if (!g_hash_service.StartHash(message, len,
-                                (callback_t)&EcLogic::onSignHashFinish, this))
-    return false;
-  busy = true;
-  this->callback = callback;
-  this->callback_arg1 = callbackArg1;
-  return true;
+  return queueJob(EcJob::kSign, message, len, callback, callbackArg1);
 }
 
 bool EcLogic::StartVerify(uint8_t const *message, uint32_t len,
                           uint8_t *signature, callback_t callback,
                           void *callbackArg1) {
-  if (busy) return false;
-  if (!g_hash_service.StartHash(message, len,
-                                (callback_t)&EcLogic::onVerifyHashFinish, this))
-    return false;
-  busy = true;
-  // Init the context
-  tmpSignature.fromBuffer(signature);
-  context.r = tmpSignature.r;
-  context.s = tmpSignature.s;
-  this->callback = callback;
-  this->callback_arg1 = callbackArg1;
+  EcJob *job =
+      queueJob(EcJob::kVerify, message, len, callback, callbackArg1);
+  if (!job) return false;
+  Signature sig;
+  sig.fromBuffer(signature);
+  job->r = sig.r;
+  job->s = sig.s;
   return true;
 }
 
-void EcLogic::onSignHashFinish(HashResult *hashResult) {
-  context.z = reinterpret_cast<uint64_t *>(hashResult->digest)[0];
-  scheduler.Queue(&genRandTask, this);
-}
-
-void EcLogic::onVerifyHashFinish(HashResult *HashResult) {
-  context.z = reinterpret_cast<uint64_t *>(HashResult->digest)[0];
-  // u1 = z / s
-  g_mod_div_service.start(context.z, context.s.val, g_curveOrder,
-                          (callback_t)&EcLogic::onU1Generated, this);
+EcJob *EcLogic::queueJob(enum EcJob::kind kind, uint8_t const *message,
+                         uint32_t len, callback_t callback,
+                         void *callbackArg1) {
+  if (jobCount == kEcJobQueueSize ||
+      !g_hash_service.StartHash(message, len,
+                                (callback_t)&EcLogic::onHashFinish, this)) {
+    queueStats.rejected++;
+    return nullptr;
+  }
+  // HashService only calls back after StartHash() returns.
+  EcJob &job = jobs[(jobHead + jobCount) % kEcJobQueueSize];
+  job = EcJob{kind, 0, 0, 0, callback, callbackArg1, SysTimer::GetTime()};
+  jobCount++;
+  if (jobCount > queueStats.maxDepth) queueStats.maxDepth = jobCount;
+  return &job;
 }
 
-void EcLogic::genRand() {
-  context.k =
-      g_fast_random_pool.GetRandom() << 32 | g_fast_random_pool.GetRandom();
-  // r = k * G
-  g_point_mult_service.start(g_generator, context.k,
-                             (callback_t)&EcLogic::onRGenerated, this);
+void EcLogic::onHashFinish(HashResult *hashResult) {
+  EcJob &job = jobs[(jobHead + jobsHashed) % kEcJobQueueSize];
+  job.z = reinterpret_cast<uint64_t *>(hashResult->digest)[0];
+  jobsHashed++;
+  startNextJob();
 }
 
-void EcLogic::onRGenerated(EcPoint *p) {
-  context.r = p->xval();
-  if (context.r == 0)
-    scheduler.Queue(&genRandTask, this);
-  else {
-    ModNum a = (context.z + privateKey * context.r);
+void EcLogic::startNextJob() {
+  // The oldest job is hashed first, so it's the one to go.
+  if (busy || jobsHashed == 0) return;
+  busy = true;
+  EcJob &job = jobs[jobHead];
+  uint32_t wait = SysTimer::GetTime() - job.submitTime;
+  queueStats.totalWait += wait;
+  if (wait > queueStats.maxWait) queueStats.maxWait = wait;
+
+  context.z = job.z;
+  if (job.kind == EcJob::kVerify) {
+    context.r = job.r;
+    context.s = job.s;
+    verifyTask.Rewind();
+    CoTask::Resume(&verifyTask, nullptr);
+    return;
+  }
+  // Take it out of the pool now, so that it can't be handed out twice.
+  context.presigned = presigCount > 0;
+  if (context.presigned) {
+    presigCount--;
+    context.presig[0] = presigPool[presigCount];
+    presigPool[presigCount] = Presig{0, 0};
+    presigStats.used++;
+  } else {
+    presigStats.missed++;
+  }
+  signTask.Rewind();
+  CoTask::Resume(&signTask, nullptr);
+}
+
+void EcLogic::finishJob(void *result) {
+  // Pop it first, the callback may queue another job.
+  EcJob job = jobs[jobHead];
+  jobs[jobHead] = EcJob{};
+  jobHead = (jobHead + 1) % kEcJobQueueSize;
+  jobCount--;
+  jobsHashed--;
+  queueStats.completed++;
+  busy = false;
+  job.callback(job.callbackArg1, result);
+  startNextJob();
+  schedulePresigFill();
+}
+
+void EcLogic::signRoutine(void *result) {
+  CO_BEGIN(signTask);
+  while (true) {
+    if (!context.presigned) {
+      // Lands in context.presig[0].
+      CO_AWAIT(signTask, startPresig(1, &CoTask::Resume, &signTask,
+                                     signTask.GetPriority()));
+    }
+    context.presigned = false;
+    context.r = context.presig[0].r;
     // s = (z + r * d) / k
-    g_mod_div_service.start(a.val, context.k, a.mod,
-                            (callback_t)&EcLogic::onSGenerated, this);
+    context.s = ScalarNum(context.presig[0].kInv) *
+                (context.z + privateKey * context.r);
+    context.presig[0] = Presig{0, 0};
+    if (!(context.s == 0)) break;
   }
-}
-
-void EcLogic::onSGenerated(ModNum *s) {
-  context.s = *s;
-  if (context.s == 0)
-    scheduler.Queue(&genRandTask, this);
-  else
-    scheduler.Queue(&finalizeTask, this);
-}
-
-void EcLogic::finalizeSign() {
+  CO_END(signTask);
   tmpSignature.r = context.r.val;
   tmpSignature.s = context.s.val;
-  callback(callback_arg1, &tmpSignature);
-  busy = false;
-}
-
-void EcLogic::onU1Generated(ModNum *u1) {
-  context.u1 = *u1;
-  // u2 = r / s
-  g_mod_div_service.start(context.r.val, context.s.val, g_curveOrder,
-                          (callback_t)&EcLogic::onU2Generated, this);
+  finishJob(&tmpSignature);
+}
+
+void EcLogic::startPresig(uint8_t count, callback_t callback,
+                          void *callbackArg1, unsigned prio) {
+  context.presigWant = count;
+  presigCallback = callback;
+  presigCallbackArg1 = callbackArg1;
+  presigTask.SetPriority(prio);
+  presigTask.Start(nullptr);
+}
+
+void EcLogic::presigRoutine(void *result) {
+  CO_BEGIN(presigTask);
+  for (context.presigMade = 0; context.presigMade < context.presigWant;
+       context.presigMade++) {
+    do {
+      context.k[context.presigMade] =
+          static_cast<uint64_t>(g_fast_random_pool.GetRandom()) << 32 |
+          g_fast_random_pool.GetRandom();
+      // r = k * G
+      CO_AWAIT(presigTask, g_point_mult_service.startGenerator(
+                               context.k[context.presigMade], &CoTask::Resume,
+                               &presigTask, presigTask.GetPriority()));
+      context.r = static_cast<EcPoint *>(result)->xval();
+    } while (context.r == 0 || ScalarNum(context.k[context.presigMade]) == 0);
+    context.presig[context.presigMade].r = context.r.val;
+  }
+  // All the 1 / k in one batch, onKInverted() resumes us after the last.
+  context.presigMade = 0;
+  CO_AWAIT(presigTask, startKInversions());
+  CO_END(presigTask);
+  // Kept in the context, the callback may only get to it in a later task.
+  presigCallback(presigCallbackArg1, context.presig);
+}
+
+void EcLogic::startKInversions() {
+  static_assert(kPresigPoolSize <= kBatchInvSize, "k's don't fit a batch");
+  for (uint8_t i = 0; i < context.presigWant; i++) {
+    g_batch_inv_service.start(context.k[i], kCurveOrder,
+                              (callback_t)&EcLogic::onKInverted, this,
+                              presigTask.GetPriority());
+  }
 }
 
-void EcLogic::onU2Generated(ModNum *u2) {
-  context.u2 = *u2;
-  // normally, the next step is P = u1 * G + u2 * pub
-  // but we do it separately:
-  // m = u1 * G
-  // n = u2 * pub
-  // P = m + n
-  g_point_mult_service.start(g_generator, context.u1.val,
-                             (callback_t)&EcLogic::onMGenerated, this);
+void EcLogic::onKInverted(uint64_t *kInv) {
+  context.presig[context.presigMade].kInv = *kInv;
+  context.k[context.presigMade] = 0;
+  if (++context.presigMade == context.presigWant)
+    CoTask::Resume(&presigTask, nullptr);
 }
 
-void EcLogic::onMGenerated(EcPoint *m) {
-  context.m = *m;
-  // n = u2 * pub
-  g_point_mult_service.start(g_serverPubKey, context.u2.val,
-                             (callback_t)&EcLogic::onNGenerated, this);
+void EcLogic::schedulePresigFill() {
+  if (presigFillQueued || jobCount || presigCount == kPresigPoolSize) return;
+  presigFillQueued = true;
+  scheduler.Queue(&presigFillTask, nullptr);
 }
 
-void EcLogic::onNGenerated(EcPoint *n) {
-  // P = m + n
-  g_point_add_service.start(context.m, *n, (callback_t)&EcLogic::finalizeVerify,
-                            this);
+void EcLogic::presigFillFunc(void *unused) {
+  presigFillQueued = false;
+  // A sign or verify got in first, it queues us again once it's done.
+  if (busy || jobCount || presigCount == kPresigPoolSize) return;
+  busy = true;
+  // The whole room at once, so that they share an inversion.
+  startPresig(kPresigPoolSize - presigCount,
+              (callback_t)&EcLogic::onPresigFilled, this,
+              presigFillTask.GetPriority());
 }
 
-void EcLogic::finalizeVerify(EcPoint *P) {
+void EcLogic::onPresigFilled(Presig *presig) {
+  for (uint8_t i = 0; i < context.presigWant; i++) {
+    presigPool[presigCount++] = presig[i];
+    presig[i] = Presig{0, 0};
+    presigStats.generated++;
+  }
+  busy = false;
+  // Jobs that came in meanwhile go before the next one.
+  startNextJob();
+  schedulePresigFill();
+}
+
+void EcLogic::verifyRoutine(void *result) {
+  CO_BEGIN(verifyTask);
+  // Neither can be 0 in a valid signature, and 1 / s wouldn't exist.
+  if (!(context.r == 0 || context.s == 0)) {
+    // u1 = z / s and u2 = r / s, with one inversion for both.
+    CO_AWAIT(verifyTask,
+             g_batch_inv_service.start(context.s.val, kCurveOrder,
+                                       &CoTask::Resume, &verifyTask,
+                                       verifyTask.GetPriority()));
+    context.u2 = *static_cast<uint64_t *>(result);
+    context.u1 = context.z * context.u2;
+    context.u2 = context.u2 * context.r;
+    // P = u1 * G + u2 * pub
+    CO_AWAIT(verifyTask, g_point_mult_service.startJoint(
+                             g_generator, context.u1.val, g_serverPubKey,
+                             context.u2.val, &CoTask::Resume, &verifyTask,
+                             verifyTask.GetPriority()));
+  }
+  CO_END(verifyTask);
   // P == identity -> signature is invalid
   // otherwise, check if r == P.x
-  callback(callback_arg1,
-           (void *)(!P->identity() && context.r.val == P->xval()));
-  busy = false;
+  EcPoint *P = static_cast<EcPoint *>(result);
+  finishJob((void *)(P && !P->identity() && context.r.val == P->xval()));
 }
 
 void EcLogic::onPubkeyDone(EcPoint *p) {
   // Ensure the derived point is not the point at infinity
   // A private key of 0 or a multiple of the curve order would result in
   // infinity
+  busy = false;
   if (!p->identity()) {
     bool ret = p->getCompactForm(publicKey, ECC_PUBKEY_SIZE);
     if (ret) publicKeyReady = true;
   } else {
     publicKeyReady = false;
   }
+  // Nothing else was allowed to use PointMultService until now.
+  startNextJob();
+  if (publicKeyReady) schedulePresigFill();
 }
 
 const uint8_t *EcLogic::GetPublicKey() {
@@ -486,15 +901,25 @@ const uint8_t *EcLogic::GetPublicKey() {
 }
 
 EcLogic::EcLogic()
-    : privateKey(0), publicKeyReady(0), busy(false),
-      genRandTask(800, (callback_t)&EcLogic::genRand, this),
-      finalizeTask(800, (callback_t)&EcLogic::finalizeSign, this) {}
+    : privateKey(0), publicKeyReady(0), busy(false), jobHead(0), jobCount(0),
+      jobsHashed(0), queueStats{}, presigCount(0),
+      presigStats{}, presigCallback(nullptr), presigCallbackArg1(nullptr),
+      presigFillTask(kPresigFillPriority,
+                     (task_callback_t)&EcLogic::presigFillFunc, this),
+      presigFillQueued(false),
+      signTask(kEcJobPriority, (task_callback_t)&EcLogic::signRoutine, this),
+      verifyTask(kEcJobPriority, (task_callback_t)&EcLogic::verifyRoutine,
+                 this),
+      presigTask(kEcJobPriority, (task_callback_t)&EcLogic::presigRoutine,
+                 this) {}
 
 void EcLogic::SetPrivateKey(uint64_t privkey) {
   privateKey = privkey;
-  privateKey = privateKey % g_curveOrder;
-  g_point_mult_service.start(g_generator, privateKey,
-                             (callback_t)&EcLogic::onPubkeyDone, this);
+  privateKey = ScalarNum(privateKey).val;
+  // Holds off jobs and presig fills until onPubkeyDone().
+  busy = true;
+  g_point_mult_service.startGenerator(
+      privateKey, (callback_t)&EcLogic::onPubkeyDone, this, kEcJobPriority);
 }
 
 }  // namespace ecc
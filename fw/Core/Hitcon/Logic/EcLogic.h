@@ -2,35 +2,94 @@
 #define SERVICE_EC_LOGIC_H_
 #include <Service/EcParams.h>
 #include <Service/HashService.h>
-#include <Service/Sched/Task.h>
+#include <Service/Sched/CoTask.h>
 #include <Util/callback.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+// Teeth of the fixed-base comb used for multiples of the generator. The
+// table in flash has 2^ECC_COMB_TEETH - 1 points of 16 bytes each, and a
+// multiplication does ceil(56 / ECC_COMB_TEETH) doublings. 4 costs 240 bytes
+// for 14 doublings, 6 costs 1008 bytes for 10.
+#ifndef ECC_COMB_TEETH
+#define ECC_COMB_TEETH 4
+#endif
+
 namespace hitcon {
 
 namespace ecc {
 
+// How many presignatures EcLogic keeps ready for StartSign().
+constexpr size_t kPresigPoolSize = 2;
+
+// Priorities of the sign and verify jobs, and of the presignature pool fill,
+// see Scheduler.h. The services below run at the priority they're started
+// with, so the fill doesn't get ahead of other background tasks.
+constexpr unsigned kEcJobPriority = 800;
+constexpr unsigned kPresigFillPriority = 1000;
+
 namespace internal {
 
+// The only two moduli there are: the prime of the field the curve is over,
+// and the order of the generator, which the scalars are taken mod.
+constexpr uint64_t kFieldPrime = 0xbcffb098340493;
+constexpr uint64_t kCurveOrder = 0xbcffb09c43733d;
+
+/**
+ * A plain value mod M, M is kFieldPrime or kCurveOrder (the members are only
+ * instantiated for those). With M fixed at compile time, adding is a
+ * conditional subtraction and multiplying goes through the Montgomery
+ * constants for M, there's no 64-bit division anywhere.
+ */
+template <uint64_t M>
 class ModNum {
-  friend ModNum operator+(const uint64_t a, const ModNum &b);
-  friend ModNum operator*(const uint64_t a, const ModNum &b);
+  friend ModNum operator+(const uint64_t a, const ModNum &b) {
+    return ModNum(a) + b;
+  }
+  friend ModNum operator*(const uint64_t a, const ModNum &b) {
+    return ModNum(a) * b;
+  }
 
  public:
-  ModNum(uint64_t val, uint64_t mod);
+  constexpr ModNum() : val(0) {}
+  // Any 64-bit val, it's reduced mod M.
+  ModNum(uint64_t val);
 
-  ModNum operator=(const uint64_t other);
-  ModNum operator=(const ModNum &other);
   ModNum operator-() const;
   ModNum operator+(const ModNum &other) const;
   ModNum operator-(const ModNum &other) const;
   ModNum operator*(const ModNum &other) const;
-  bool operator==(const ModNum &other) const;
-  bool operator==(const uint64_t other) const;
+  bool operator==(const ModNum &other) const { return val == other.val; }
+  bool operator==(const uint64_t other) const { return val == other; }
 
   uint64_t val;
-  uint64_t mod;
+};
+
+// A scalar, mod the order of the generator.
+using ScalarNum = ModNum<kCurveOrder>;
+
+/**
+ * An element of the field the curve is over, i.e. a point coordinate.
+ * It's kept in Montgomery form (mont = x * 2^64 mod p) when ECC_MONTGOMERY is
+ * set, so a multiplication is a couple of 32x32->64 multiply rows and no
+ * division. EcPoint converts from and to plain values, nothing outside of
+ * EcPoint and PointAddService sees the Montgomery form.
+ */
+class FieldNum {
+ public:
+  constexpr FieldNum() : mont(0) {}
+
+  static FieldNum FromPlain(uint64_t x);
+  static FieldNum FromMont(uint64_t mont);
+  uint64_t ToPlain() const;
+
+  FieldNum operator-() const;
+  FieldNum operator+(const FieldNum &other) const;
+  FieldNum operator-(const FieldNum &other) const;
+  FieldNum operator*(const FieldNum &other) const;
+  bool operator==(const FieldNum &other) const { return mont == other.mont; }
+
+  uint64_t mont;
 };
 
 /**
@@ -43,38 +102,91 @@ struct ModDivContext {
   uint64_t ppr, pr;
   uint64_t ppx, px;
   uint64_t a;
-  uint64_t res;
 };
 
+// The start() of each service below takes the priority to run at, see
+// Scheduler.h. A service that starts another passes its own on.
 class ModDivService {
  public:
   void start(uint64_t a, uint64_t b, uint64_t m, callback_t callback,
-             void *callbackArg1);
+             void *callbackArg1, unsigned prio);
   ModDivService();
 
  private:
   callback_t callback;
   void *callbackArg1;
   ModDivContext context;
-  service::sched::Task routineTask;
-  service::sched::Task finalizeTask;
-  void routineFunc();
-  void finalize();
+  // Passed to the callback, lives until the next start().
+  uint64_t res;
+  service::sched::CoTask routineTask;
+  void routineFunc(void *unused);
 };
 
 extern ModDivService g_mod_div_service;
 
+// How many inversions BatchInvService takes at a time.
+constexpr size_t kBatchInvSize = 4;
+
+/**
+ * Inverts several values mod the same m with one ModDivService run
+ * (Montgomery's trick): it inverts the product of all of them, then gets
+ * each inverse back out with two multiplications. Requests made before the
+ * service gets to run, or while a batch is being inverted, go in the same
+ * (next) batch. Nothing else may use ModDivService while a batch is running.
+ */
+class BatchInvService {
+ public:
+  // x^-1 mod m, for m kFieldPrime or kCurveOrder. The callback gets a
+  // uint64_t pointer to it, only valid during the callback. Callbacks are
+  // called in the order of the requests.
+  // Return false if there are kBatchInvSize requests already, or x is 0 mod m.
+  // A batch runs at the most urgent prio of its requests, except that one
+  // already queued keeps that of its first request until it gets to run.
+  bool start(uint64_t x, uint64_t m, callback_t callback, void *callbackArg1,
+             unsigned prio);
+  BatchInvService();
+
+  // ModDivService runs, and the inversions they stood in for.
+  uint32_t GetBatches() { return batches; }
+  uint32_t GetInversions() { return inversions; }
+
+ private:
+  struct Request {
+    uint64_t x, m;
+    callback_t callback;
+    void *callbackArg1;
+    unsigned prio;
+  };
+  // The first batchSize of them are being inverted, the rest wait.
+  Request requests[kBatchInvSize];
+  uint8_t count;
+  uint8_t batchSize;
+  // routineTask is started and hasn't run out of requests yet.
+  bool running;
+  // x0 * ... * xi, then the inverse of xi.
+  uint64_t prefix[kBatchInvSize];
+  uint32_t batches;
+  uint32_t inversions;
+  service::sched::CoTask routineTask;
+  void routineFunc(void *result);
+};
+
+extern BatchInvService g_batch_inv_service;
+
 struct EllipticCurve {
-  EllipticCurve(const uint64_t A, const uint64_t B);
+  constexpr EllipticCurve(const uint64_t A, const uint64_t B) : A(A), B(B) {}
   const uint64_t A, B;
 };
 
 class EcPoint {
   friend class PointAddService;
+  friend class JacobianPoint;
 
  public:
   EcPoint();
-  EcPoint(const ModNum &x, const ModNum &y);
+  // x and y are plain values mod p.
+  EcPoint(const ModNum<kFieldPrime> &x, const ModNum<kFieldPrime> &y);
+  EcPoint(const FieldNum &x, const FieldNum &y);
   EcPoint operator=(const EcPoint &other);
   EcPoint operator-() const;
   bool operator==(const EcPoint &other) const;
@@ -97,7 +209,32 @@ class EcPoint {
 
  private:
   bool isInf;
-  ModNum x, y;
+  FieldNum x, y;
+};
+
+/**
+ * A point in Jacobian coordinates, (X, Y, Z) stands for (X / Z^2, Y / Z^3).
+ * Doubling and adding need no division this way, so a whole PointMult only
+ * does one, in ToAffine(). Z is 0 for the identity.
+ */
+class JacobianPoint {
+ public:
+  // The identity.
+  JacobianPoint();
+  explicit JacobianPoint(const EcPoint &p);
+
+  bool identity() const;
+
+  void Double();
+  // Add a point in affine coordinates.
+  void AddAffine(const EcPoint &p);
+
+  const FieldNum &zcoord() const { return Z; }
+  // The same point in affine coordinates, zinv is 1 / Z.
+  EcPoint ToAffine(const FieldNum &zinv) const;
+
+ private:
+  FieldNum X, Y, Z;
 };
 
 /**
@@ -110,81 +247,156 @@ struct PointAddContext {
   EcPoint b;
   EcPoint res;
   // Storage for the slope.
-  ModNum l;
-  PointAddContext();
+  FieldNum l;
 };
 
 class PointAddService {
  public:
   void start(const EcPoint &a, const EcPoint &b, callback_t callback,
-             void *callbackArg1);
+             void *callbackArg1, unsigned prio);
   PointAddService();
 
  private:
   callback_t callback;
   void *callbackArg1;
   PointAddContext context;
-  service::sched::Task routineTask;
-  service::sched::Task finalizeTask;
-  service::sched::Task genXTask;
-  service::sched::Task genYTask;
-  void routineFunc();
-  void genX();
-  void genY();
-  void onDivDone(ModNum *l);
-  void finalize();
+  service::sched::CoTask routineTask;
+  void routineFunc(uint64_t *l);
+  // Start the division for the slope.
+  void startSlope();
 };
 
 extern PointAddService g_point_add_service;
 
 /**
- * Context for res = p * times.
+ * Context for res = p * times, or p * times + q * times2.
  * We do this similarly to modular exponentiation, where we iterate through 64
- * bits and do a point addition according to each bit.
+ * bits and do a point addition according to each bit. The sum is kept in
+ * Jacobian coordinates, so there's only one division, at the end.
+ * For two scalars, both go through the same doublings (Shamir's trick), and
+ * each bit pair adds p, q or p + q.
  */
 struct PointMultContext {
+  enum mode {
+    kGeneric,
+    // p is G and the comb table is used instead.
+    kFixedBase,
+    kJoint,
+  } mode;
   EcPoint p;
   uint64_t times;
+  /* --- Only for kJoint --- */
+  EcPoint q;
+  uint64_t times2;
+  EcPoint pq;
+  // The running sum, converted to res once all bits are done.
+  JacobianPoint sum;
   EcPoint res;
-  // The iterator.
+  // The iterator, and how many doublings there are.
   uint8_t i;
+  uint8_t steps;
   PointMultContext();
 };
 
 class PointMultService {
  public:
   void start(const EcPoint &p, uint64_t times, callback_t callback,
-             void *callbackArg1);
+             void *callbackArg1, unsigned prio);
+  // Same as start() with the generator as p, but with a fraction of the
+  // doublings.
+  void startGenerator(uint64_t times, callback_t callback, void *callbackArg1,
+                      unsigned prio);
+  // p * times + q * times2, with about as many doublings as one start().
+  void startJoint(const EcPoint &p, uint64_t times, const EcPoint &q,
+                  uint64_t times2, callback_t callback, void *callbackArg1,
+                  unsigned prio);
   PointMultService();
 
  private:
   callback_t callback;
   void *callbackArg1;
   PointMultContext context;
-  service::sched::Task routineTask;
-  void routineFunc();
-  void onAddDone(EcPoint *res);
+  service::sched::CoTask routineTask;
+  // result is whatever the last CO_AWAIT() produced.
+  void routineFunc(void *result);
+  // Add whatever bit context.i of the scalar(s) calls for.
+  void addForBit();
 };
 
 extern PointMultService g_point_mult_service;
 
+/**
+ * The part of a signature that doesn't depend on the message: r = (k * G).x
+ * and 1 / k mod the order for a random k. k itself isn't kept.
+ * Must only ever be used for one signature, reusing it leaks the private key.
+ */
+struct Presig {
+  uint64_t r;
+  uint64_t kInv;
+};
+
 struct EcContext {
   // hash of the message
   uint64_t z;
   // signature
-  ModNum r, s;
+  ScalarNum r, s;
   /* --- Signing context --- */
-  // a random value
-  uint64_t k;
+  // Random values, only while presigs are being made.
+  uint64_t k[kPresigPoolSize];
+  // The presigs being made, then presig[0] is the one this signature uses,
+  // taken from the pool or made on the spot.
+  Presig presig[kPresigPoolSize];
+  // How many presigs are being made, and done with so far.
+  uint8_t presigWant;
+  uint8_t presigMade;
+  bool presigned;
   /* --- Verifying context --- */
-  ModNum u1, u2;
-  // temporal storage for a point
-  EcPoint m;
+  ScalarNum u1, u2;
   EcContext();
 };
 
+// A StartSign() or StartVerify() request, from when it's accepted until its
+// callback returns.
+struct EcJob {
+  enum kind { kSign, kVerify } kind;
+  // Hash of the message, set once HashService is done with it.
+  uint64_t z;
+  // The signature to check, verify only.
+  uint64_t r, s;
+  callback_t callback;
+  void *callbackArg1;
+  // SysTimer::GetTime() when the request was accepted.
+  unsigned submitTime;
+};
+
 }  // namespace internal
 
+// How many sign / verify requests EcLogic takes at a time, including the one
+// being computed. The others are hashed in the meantime.
+constexpr size_t kEcJobQueueSize = 3;
+
+// Job queue statistics, times are in SysTimer units (ms).
+struct EcQueueStats {
+  uint32_t completed;
+  // StartSign() / StartVerify() calls turned down because either the job
+  // queue or HashService's was full.
+  uint32_t rejected;
+  // Jobs accepted and not done yet, at most kEcJobQueueSize.
+  uint32_t maxDepth;
+  // From StartSign() / StartVerify() until the job's scalar multiplication
+  // begins, hashing included.
+  uint32_t totalWait;
+  uint32_t maxWait;
+};
+
+struct PresigStats {
+  uint32_t generated;
+  // Signatures that took a presignature from the pool, and ones that found it
+  // empty and had to do k * G then and there.
+  uint32_t used;
+  uint32_t missed;
+};
+
 struct Signature {
   uint64_t r, s;
 
@@ -231,7 +443,7 @@ class EcLogic {
   const uint8_t *GetPublicKey();
 
   /**
-   * Start the signing process and mark this API as busy.
+   * Queue a signing job.
    *
    * @param message:      the message to sign. The contents should be intact
    *                      until sign finishes.
@@ -242,13 +454,19 @@ class EcLogic {
    * @param callbackArg1: The first argument to the callback. Normally a
    *                      pointer to "this" if the callback is a method, and
    *                      nullptr if the callback is a function.
-   * @return              whether the job is successfully queued.
+   * @return              whether the job is successfully queued. If not,
+   *                      the queue is full and the caller should retry later.
+   *
+   * Jobs run one after another in the order they're accepted, up to
+   * kEcJobQueueSize at a time. The message is hashed right away, while the
+   * jobs before it are still being computed. If there's a presignature in
+   * the pool when the job's turn comes, the signature is done then and there.
    */
   bool StartSign(uint8_t const *message, uint32_t len, callback_t callback,
                  void *callbackArg1);
 
   /**
-   * Start the verification process and mark this API as busy.
+   * Queue a verification job, it shares the queue with StartSign().
    * This will only verify the signature against the server public key.
    *
    * @param message:      the message to verify. The contents should be intact
@@ -269,12 +487,22 @@ class EcLogic {
   bool StartVerify(uint8_t const *message, uint32_t len, uint8_t *signature,
                    callback_t callback, void *callbackArg1);
 
+  /**
+   * Presignatures ready for StartSign(), at most kPresigPoolSize. The pool is
+   * refilled in the background whenever the scheduler has nothing else to do.
+   */
+  size_t GetPresigCount() { return presigCount; }
+  const PresigStats &GetPresigStats() { return presigStats; }
+
+  // Jobs accepted and not done yet, including the one being computed.
+  size_t GetQueueDepth() { return jobCount; }
+  const EcQueueStats &GetQueueStats() { return queueStats; }
+
  private:
   /**
-   * Indicates whether a sign / verify operation is running.
-   * If a task is active, this flag is set to true, and further requests to sign
-   * / verify will fail. If neither sign nor verify is running, this flag should
-   * be set to false.
+   * Indicates whether signTask, verifyTask, a background presigTask or the
+   * public key derivation is running. They share PointMultService, so the
+   * next job waits until this is false again.
    */
   bool busy;
   /**
@@ -283,10 +511,8 @@ class EcLogic {
   uint64_t tmpRandValue;
   /**
    * Temporary storage of signature.
-   * For the signing process, the data only lives since the signature completes
-   * (at the end of doSign) till the callback returns. For the verification
-   * process, the data lives since StartVerify is called till the callback
-   * returns.
+   * The data only lives since the signature completes (at the end of
+   * signRoutine) till the callback returns.
    */
   ecc::Signature tmpSignature;
 
@@ -303,25 +529,55 @@ class EcLogic {
 
   hitcon::ecc::internal::EcContext context;
 
-  void genRand();
-  void onSignHashFinish(hitcon::hash::HashResult *hashResult);
-  void onVerifyHashFinish(hitcon::hash::HashResult *hashResult);
-  void onRGenerated(internal::EcPoint *p);
-  void onSGenerated(internal::ModNum *s);
-  void finalizeSign();
-  void onU1Generated(internal::ModNum *u1);
-  void onU2Generated(internal::ModNum *u2);
-  void onMGenerated(internal::EcPoint *m);
-  void onNGenerated(internal::EcPoint *n);
-  void finalizeVerify(internal::EcPoint *P);
+  // Ring of accepted jobs, jobs[jobHead] is the oldest. The first jobsHashed
+  // of them have their hash, HashService finishes them in order.
+  internal::EcJob jobs[kEcJobQueueSize];
+  uint8_t jobHead;
+  uint8_t jobCount;
+  uint8_t jobsHashed;
+  EcQueueStats queueStats;
+
+  internal::Presig presigPool[kPresigPoolSize];
+  uint8_t presigCount;
+  PresigStats presigStats;
+  // Where presigTask reports to.
+  callback_t presigCallback;
+  void *presigCallbackArg1;
+  // The background refill, at kPresigFillPriority.
+  service::sched::Task presigFillTask;
+  bool presigFillQueued;
+
+  // Add a job and start hashing its message, nullptr if there's no room.
+  internal::EcJob *queueJob(enum internal::EcJob::kind kind,
+                            uint8_t const *message, uint32_t len,
+                            callback_t callback, void *callbackArg1);
+  void onHashFinish(hitcon::hash::HashResult *hashResult);
+  // Start the oldest job if it's hashed and nothing is running.
+  void startNextJob();
+  // Retire the running job and hand result to its callback.
+  void finishJob(void *result);
+  // The bodies of signTask and verifyTask, they start once the hash is done.
+  // result is whatever the last CO_AWAIT() produced.
+  void signRoutine(void *result);
+  void verifyRoutine(void *result);
+
+  // Make count presigs at prio, the callback gets a pointer to
+  // context.presig. The 1 / k of all of them take a single inversion.
+  void startPresig(uint8_t count, callback_t callback, void *callbackArg1,
+                   unsigned prio);
+  void presigRoutine(void *result);
+  void startKInversions();
+  void onKInverted(uint64_t *kInv);
+  // Queue presigFillTask if the pool has room.
+  void schedulePresigFill();
+  void presigFillFunc(void *unused);
+  void onPresigFilled(internal::Presig *presig);
 
   void onPubkeyDone(internal::EcPoint *p);
 
-  callback_t callback;
-  void *callback_arg1;
-
-  service::sched::Task genRandTask;
-  service::sched::Task finalizeTask;
+  service::sched::CoTask signTask;
+  service::sched::CoTask verifyTask;
+  service::sched::CoTask presigTask;
 };
 
 extern EcLogic g_ec_logic;
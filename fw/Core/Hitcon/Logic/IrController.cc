@@ -31,12 +31,12 @@ static char SURPRISE_NAME[] = "You got pwned!";
 IrController irController;
 
 IrController::IrController()
-    : routine_task(950, (callback_t)&IrController::RoutineTask, this, 1000),
+    : routine_task(950, (callback_t)&IrController::RoutineTask, this,
+                   kRoutineIntervalMs),
       broadcast_task(800, (callback_t)&IrController::BroadcastIr, this),
       showtext_task(800, (callback_t)&IrController::ShowText, this),
       send_lock(true), recv_lock(true), disable_broadcast(false),
-      received_packet_cnt(0), priority_data_len_(0), current_hashing_slot(-1),
-      current_tx_slot(-1) {}
+      received_packet_cnt(0), priority_data_len_(0), current_tx_slot(-1) {}
 
 void IrController::ShowText(void* arg) {
   struct ShowPacket* pkt = reinterpret_cast<struct ShowPacket*>(arg);
@@ -116,20 +116,18 @@ void IrController::RoutineTask(void* unused) {
   MaintainQueued();
 }
 
-void IrController::OnPacketHashResult(void* arg_ptr) {
-  my_assert(current_hashing_slot != -1);
-  my_assert(current_hashing_slot < RETX_QUEUE_SIZE);
+void IrController::OnPacketHashResult(RetransmittableIrPacket* packet,
+                                      void* arg_ptr) {
+  my_assert((packet->status & kRetransmitStatusMask) ==
+            kRetransmitStatusWaitHashDone);
   hitcon::hash::HashResult* hash_result =
       reinterpret_cast<hitcon::hash::HashResult*>(arg_ptr);
-  memcpy(&(queued_packets_[current_hashing_slot].hash[0]), hash_result->digest,
-         PACKET_HASH_LEN);
+  memcpy(&(packet->hash[0]), hash_result->digest, PACKET_HASH_LEN);
   my_assert(PACKET_HASH_LEN <= hash_result->size);
-  uint8_t status = queued_packets_[current_hashing_slot].status;
+  uint8_t status = packet->status;
   // Update status to Waiting for IrController's tx slot
   status = (status & (~kRetransmitStatusMask)) | kRetransmitStatusWaitTxSlot;
-  queued_packets_[current_hashing_slot].status =
-      status;  // Update the struct member
-  current_hashing_slot = -1;
+  packet->status = status;  // Update the struct member
 }
 
 bool IrController::SendPacketWithRetransmit(uint8_t* data, size_t len,
@@ -175,24 +173,20 @@ void IrController::MaintainQueued() {
     if (current_status == kRetransmitStatusSlotUnused) {
       // Slot is unused. Do nothing.
     } else if (current_status == kRetransmitStatusWaitHashAvail) {
-      // Waiting for hash processor to be available.
-      if (current_hashing_slot == -1) {
-        // Start hashing the payload.
-        bool ret = hitcon::hash::g_hash_service.StartHash(
-            pckt_data, pckt_size, (callback_t)&IrController::OnPacketHashResult,
-            this);
-        if (ret) {
-          // Hashing started successfully. Update status to Waiting for hash
-          // processor to finish.
-          queued_packets_[i].status =
-              (queued_packets_[i].status & ~kRetransmitStatusMask) |
-              kRetransmitStatusWaitHashDone;
-          current_hashing_slot =
-              i;  // Mark this slot as being currently hashed.
-        }
-        // If ret is false, hash service was busy, will try again next
-        // RoutineTask cycle.
+      // Waiting for hash processor to take the request. The slot itself is
+      // the callback argument, so any number of slots can be hashing.
+      bool ret = hitcon::hash::g_hash_service.StartHash(
+          pckt_data, pckt_size, (callback_t)&IrController::OnPacketHashResult,
+          &queued_packets_[i]);
+      if (ret) {
+        // Hashing request accepted. Update status to Waiting for hash
+        // processor to finish.
+        queued_packets_[i].status =
+            (queued_packets_[i].status & ~kRetransmitStatusMask) |
+            kRetransmitStatusWaitHashDone;
       }
+      // If ret is false, hash service queue was full, will try again next
+      // RoutineTask cycle.
     } else if (current_status == kRetransmitStatusWaitHashDone) {
       // Waiting for hash processor to finish.
       // The OnPacketHashResult callback will change the status to
@@ -220,7 +214,8 @@ void IrController::MaintainQueued() {
               kRetransmitStatusWaitAck;
           // Set the timer for waiting for an acknowledgment packet.
           queued_packets_[i].time_to_retry =
-              600 + 200 - (g_fast_random_pool.GetRandom() % 400);
+              kRetransmitWaitMin +
+              g_fast_random_pool.GetRandom() % kRetransmitWaitSpread;
         }
         // If ret is false, irLogic was busy, will try again next RoutineTask
         // cycle.
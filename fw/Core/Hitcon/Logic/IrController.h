@@ -152,6 +152,13 @@ struct IrData {
 
 constexpr size_t RETX_QUEUE_SIZE = 4;
 
+// IrController::RoutineTask() runs this often, in ms.
+constexpr unsigned kRoutineIntervalMs = 1000;
+// A packet that isn't acknowledged is sent again after kRetransmitWaitMin
+// plus a random 0 to kRetransmitWaitSpread - 1 RoutineTask() runs.
+constexpr uint16_t kRetransmitWaitMin = 401;
+constexpr uint16_t kRetransmitWaitSpread = 400;
+
 constexpr uint8_t kRetransmitLimitMask = 0x07;
 constexpr uint8_t kRetransmitStatusMask = 0xe0;
 constexpr uint8_t kRetransmitStatusSlotUnused = 0x00;
@@ -229,10 +236,9 @@ class IrController {
   size_t priority_data_len_;
 
   RetransmittableIrPacket queued_packets_[RETX_QUEUE_SIZE];
-  int current_hashing_slot;
   int current_tx_slot;
 
-  // Called every 1s.
+  // Called every kRoutineIntervalMs.
   void RoutineTask(void* unused);
 
   // Called on every packet.
@@ -250,8 +256,9 @@ class IrController {
 
   // Called when we received an acknowledgment packet.
   void OnAcknowledgePacket(AcknowledgePacket* pckt);
-  // Called by HashProcessor when hashing finished.
-  void OnPacketHashResult(void* hash_result);
+  // Called by HashProcessor when hashing the packet finished.
+  static void OnPacketHashResult(RetransmittableIrPacket* packet,
+                                 void* hash_result);
 
   // Called whenever we've some acknowledged packet.
   void OnAcknowledgeTag(AckTag tag);
@@ -1,6 +1,7 @@
 #include "IrLogic.h"
 
 #include <Logic/IrLogic.h>
+#include <Logic/ReedSolomon.h>
 #include <Logic/XBoardLogic.h>
 #include <Logic/XBoardRecvFn.h>
 #include <Logic/crc32.h>
@@ -18,11 +19,17 @@ namespace hitcon {
 namespace ir {
 
 IrLogic irLogic;
-service::sched::Task OnBufferReceivedTask(
-    490, (service::sched::task_callback_t)&IrLogic::OnBufferReceived, &irLogic);
 
 IrLogic::IrLogic()
-    : lf_total_period(0), lf_nonzero_period(0), lowpass_loadfactor(0) {}
+    : tx_fec(false), tx_fast(false), rx_good_packets(0), rx_bad_packets(0),
+      rx_fast_packets(0), lf_total_period(0), lf_nonzero_period(0),
+      lowpass_loadfactor(0),
+      buffer_received_task(
+          490, (service::sched::task_callback_t)&IrLogic::OnBufferReceived,
+          this),
+      packet_state(0), rx_fast(false), header_window(0), sample_carry(0),
+      sample_carry_n(0), bit_acc(0), bit_n(0), data_pos(0), data_end(0),
+      rx_erasure_n(0) {}
 
 void IrLogic::Init() {
   // Set callback
@@ -30,38 +37,83 @@ void IrLogic::Init() {
       (callback_t)&IrLogic::OnBufferReceivedEnqueueTask, this);
 }
 
-size_t packet_buf{0};
-uint8_t packet_state{0};
+namespace {
 
 enum PACKET_STATE {
   STATE_START = 0,
   STATE_SIZE = 1,
+  // The data, checksum and parity if any.
   STATE_DATA = 2,
-  STATE_CHKSUM = 3,
-  STATE_RESET = 4,
 };
 
-enum BIT_STATE {
-  BIT_OFF = 0,
-  BIT_ON = 1,
-  BIT_INVALID = 2,
+// Each rx byte is 8 samples, the oldest in bit 0, and a data bit is
+// DECODE_SAMPLE_RATIO of them, or DECODE_SAMPLE_RATIO_FAST. Once lined up, a
+// byte is exactly two bits, or four.
+static_assert(DECODE_SAMPLE_RATIO == 4, "The decode table takes 4x samples");
+static_assert(DECODE_SAMPLE_RATIO_FAST == 2, "And the fast one 2x samples");
+
+// Entry i holds the bits decoded from the samples i, the first one in bit 0,
+// and a flag for each invalid one from DECODE_FIRST_INVALID up. A bit is 1 with
+// threshold or more of its samples on, 0 with that many off, and invalid
+// otherwise, as 0.
+constexpr uint8_t DECODE_FIRST_INVALID = 1 << 4;
+
+struct DecodeTable {
+  uint8_t entry[256];
 };
 
-static uint8_t decode_bit(uint8_t x) {
-  uint8_t cnt = __builtin_popcount(x & 0b1111);
-  switch (cnt) {
-    case 0:
-    case 1:
-      return BIT_OFF;
-    case 3:
-    case 4:
-      return BIT_ON;
-    case 2:
-    default:
-      return BIT_INVALID;
+constexpr DecodeTable MakeDecodeTable(unsigned ratio, unsigned threshold) {
+  DecodeTable table = {};
+  for (unsigned i = 0; i < 256; i++) {
+    for (unsigned bit = 0; bit < 8 / ratio; bit++) {
+      const unsigned on =
+          __builtin_popcount((i >> (bit * ratio)) & ((1 << ratio) - 1));
+      if (on >= threshold) {
+        table.entry[i] |= 1 << bit;
+      } else if (ratio - on < threshold) {
+        table.entry[i] |= DECODE_FIRST_INVALID << bit;
+      }
+    }
   }
+  return table;
 }
 
+constexpr DecodeTable kDecodeTable =
+    MakeDecodeTable(DECODE_SAMPLE_RATIO, DECODE_SAMPLE_RATIO_THRESHOLD);
+constexpr DecodeTable kDecodeTableFast = MakeDecodeTable(
+    DECODE_SAMPLE_RATIO_FAST, DECODE_SAMPLE_RATIO_THRESHOLD_FAST);
+
+constexpr unsigned BitLength(size_t x) { return x ? 1 + BitLength(x >> 1) : 0; }
+
+constexpr uint32_t ReverseBits(uint32_t x, unsigned n) {
+  uint32_t res = 0;
+  for (unsigned i = 0; i < n; i++) res |= ((x >> i) & 1) << (n - 1 - i);
+  return res;
+}
+
+// IR_PACKET_HEADER_PACKED has the newest sample in bit 0, header_window has
+// the oldest at the bottom, so these are flipped around.
+constexpr unsigned kHeaderSamples = BitLength(IR_PACKET_HEADER_MASK);
+constexpr uint32_t kHeaderMask =
+    ReverseBits(IR_PACKET_HEADER_MASK, kHeaderSamples);
+constexpr uint32_t kHeaderBits = ReverseBits(
+    IR_PACKET_HEADER_PACKED & IR_PACKET_HEADER_MASK, kHeaderSamples);
+// The header ending on the first sample of the newest byte starts here.
+constexpr unsigned kHeaderFirstShift = 24 - (kHeaderSamples - 1);
+static_assert(kHeaderSamples <= 25, "The header has to fit the window");
+
+constexpr unsigned kFastHeaderSamples = BitLength(IR_PACKET_HEADER_FAST_MASK);
+constexpr uint32_t kFastHeaderMask =
+    ReverseBits(IR_PACKET_HEADER_FAST_MASK, kFastHeaderSamples);
+constexpr uint32_t kFastHeaderBits = ReverseBits(
+    IR_PACKET_HEADER_FAST_PACKED & IR_PACKET_HEADER_FAST_MASK,
+    kFastHeaderSamples);
+constexpr unsigned kFastHeaderFirstShift = 24 - (kFastHeaderSamples - 1);
+// So the quiet check below covers it too.
+static_assert(kFastHeaderFirstShift >= kHeaderFirstShift);
+
+}  // namespace
+
 static uint8_t merge_chksum(uint32_t x) {
   uint8_t ret = 0;
   for (int i = 0; i < 32; i += 8) {
@@ -72,7 +124,7 @@ static uint8_t merge_chksum(uint32_t x) {
 
 void IrLogic::OnBufferReceivedEnqueueTask(uint8_t *buffer) {
   buffer_received_ctr = 0;
-  service::sched::scheduler.Queue(&OnBufferReceivedTask, buffer);
+  service::sched::scheduler.Queue(&buffer_received_task, buffer);
 
   static_assert(IR_SERVICE_RX_ON_BUFFER_SIZE % IR_LOADFACTOR_PERIOD == 0);
   static_assert(IR_LOADFACTOR_PERIOD % sizeof(uint32_t) == 0);
@@ -109,128 +161,192 @@ void IrLogic::OnBufferReceived(uint8_t *buffer) {
 
   // Here is a DOS feature that if someone send a packet_header
   // then it can cause decode + receive fail
-  static uint8_t bit{0};
   for (size_t i = 0; i < IR_SERVICE_RX_BUFFER_PER_RUN &&
                      buffer_received_ctr < IR_SERVICE_RX_ON_BUFFER_SIZE;
        i++, buffer_received_ctr++) {
-    my_assert(buffer_received_ctr < IR_SERVICE_RX_ON_BUFFER_SIZE);
-    uint8_t current_byte = buffer[buffer_received_ctr];
-    for (uint8_t j = 0; j < 8; j++) {
-      uint8_t is_on = current_byte & 0x01;
-      current_byte = current_byte >> 1;
-      switch (packet_state) {
-        case STATE_START:
-          packet_buf <<= 1;
-          packet_buf |= is_on;
-          if ((packet_buf & IR_PACKET_HEADER_MASK) ==
-              (IR_PACKET_HEADER_PACKED & IR_PACKET_HEADER_MASK)) {
-            packet_state = STATE_SIZE;
-            g_suspender.IncBlocker();
-            rx_packet.size_ = 0;
-            packet_buf = 0;
-            bit = 0;
-          }
-          break;
-        case STATE_SIZE:
-          // here, denote packet_buf as n of consumed size bit
-          packet_buf++;
-          bit <<= 1;
-          bit |= is_on;
-          if ((packet_buf & 3) == 0) {
-            if (decode_bit(bit) == BIT_INVALID) {
-              // decode error
-              packet_state = STATE_RESET;
-              return;
-            }
-            const uint8_t bitpos = (packet_buf / DECODE_SAMPLE_RATIO - 1);
-            rx_packet.size_ |= decode_bit(bit) << bitpos;
-            bit = 0;
-          }
-          // end of size section (decode ratio * 1 byte)
-          if (packet_buf == DECODE_SAMPLE_RATIO * 8) {
-            if (rx_packet.size_ >= MAX_PACKET_PAYLOAD_BYTES) {
-              // Packet too large.
-              packet_state = STATE_RESET;
-            } else {
-              rx_packet.data_[0] = rx_packet.size_;
-              packet_state = STATE_DATA;
-              packet_buf = 0;
-            }
-          }
-          break;
-        case STATE_DATA:
-          // here, denote packet_buf as n of consumed data bit
-          packet_buf++;
-          bit <<= 1;
-          bit |= is_on;
-          if ((packet_buf % DECODE_SAMPLE_RATIO) == 0) {
-            if (decode_bit(bit) == BIT_INVALID) {
-              // decode error
-              packet_state = STATE_RESET;
-              break;
-            }
-            const uint8_t pos = (packet_buf / DECODE_SAMPLE_RATIO - 1) / 8 + 1;
-            const uint8_t bitpos = (packet_buf / DECODE_SAMPLE_RATIO - 1) % 8;
-            rx_packet.data_[pos] |= decode_bit(bit) << bitpos;
-            if (pos == rx_packet.size_ - 2 && bitpos == 7) {
-              // packet data end
-              // double buffering
-              // Full packet found, restarting.
-              packet_state = STATE_CHKSUM;
-              break;
-            }
-          }
-          break;
-        case STATE_CHKSUM:
-          packet_buf++;
-          bit <<= 1;
-          bit |= is_on;
-          if ((packet_buf % DECODE_SAMPLE_RATIO) == 0) {
-            if (decode_bit(bit) == BIT_INVALID) {
-              packet_state = STATE_RESET;
-              break;
-            }
-            const uint8_t bitpos =
-                (packet_buf / DECODE_SAMPLE_RATIO - 1) % IR_CHKSUM_SZ;
-            rx_packet.data_[rx_packet.size_ - 1] |= decode_bit(bit) << bitpos;
-            if (bitpos == IR_CHKSUM_SZ - 1) {
-              // packet_end
-              packet_buf = 0;
-              packet_state = STATE_RESET;
-
-              // if valid packet
-              const uint32_t chksum =
-                  merge_chksum(crc32(rx_packet.data_, rx_packet.size_ - 1));
-              if (chksum == rx_packet.data_[rx_packet.size_ - 1]) {
-                // pop checksum
-                rx_packet.data_[rx_packet.size_ - 1] = '\0';
-                rx_packet.size_--;
-                rx_packet.data_[0] = rx_packet.size_;
-                rx_packet_ctrler = rx_packet;
-                callback(callback_arg,
-                         reinterpret_cast<void *>(&rx_packet_ctrler));
-              }
-            }
-          }
-          break;
-        case STATE_RESET:
-          packet_state = STATE_START;
-          g_suspender.DecBlocker();
-          packet_buf = 0;
-          bit = 0;
-          memset(&rx_packet, 0, sizeof(IrPacket));
-          break;
-
-        default:
-          break;
-      }
+    const uint8_t current_byte = buffer[buffer_received_ctr];
+    if (packet_state == STATE_START) {
+      SearchHeader(current_byte);
+      continue;
     }
+    // Line the samples up with the bits, the first few are left from the
+    // byte before.
+    const uint16_t samples = sample_carry | current_byte << sample_carry_n;
+    sample_carry = samples >> 8;
+    DecodeSamples(samples & 0xff,
+                  rx_fast ? 8 / DECODE_SAMPLE_RATIO_FAST
+                          : 8 / DECODE_SAMPLE_RATIO);
   }
   if (buffer_received_ctr < IR_SERVICE_RX_ON_BUFFER_SIZE) {
-    service::sched::scheduler.Queue(&OnBufferReceivedTask, buffer);
+    service::sched::scheduler.Queue(&buffer_received_task, buffer);
   }
 }
 
+void IrLogic::SearchHeader(uint8_t samples) {
+  header_window = header_window >> 8 | static_cast<uint32_t>(samples) << 24;
+  // All quiet, which is most of the time.
+  if (!(header_window >> kHeaderFirstShift)) return;
+  for (uint8_t last = 0; last < 8; last++) {
+    bool fast = false;
+    if (((header_window >> (kHeaderFirstShift + last)) & kHeaderMask) !=
+        kHeaderBits) {
+      if (((header_window >> (kFastHeaderFirstShift + last)) &
+           kFastHeaderMask) != kFastHeaderBits)
+        continue;
+      fast = true;
+    }
+    StartPacket(fast);
+    // The samples after the header in this byte are data already.
+    sample_carry = samples >> last >> 1;
+    sample_carry_n = 7 - last;
+    const uint8_t ratio = fast ? DECODE_SAMPLE_RATIO_FAST : DECODE_SAMPLE_RATIO;
+    const uint8_t bits = sample_carry_n / ratio;
+    if (bits) {
+      const uint8_t first = sample_carry & ((1 << (bits * ratio)) - 1);
+      sample_carry >>= bits * ratio;
+      sample_carry_n -= bits * ratio;
+      DecodeSamples(first, bits);
+    }
+    return;
+  }
+}
+
+void IrLogic::StartPacket(bool fast) {
+  packet_state = STATE_SIZE;
+  rx_fast = fast;
+  g_suspender.IncBlocker();
+  rx_packet.size_ = 0;
+  bit_acc = 0;
+  bit_n = 0;
+  rx_erasure_n = 0;
+}
+
+void IrLogic::DecodeSamples(uint8_t samples, uint8_t count) {
+  const uint8_t decoded =
+      (rx_fast ? kDecodeTableFast : kDecodeTable).entry[samples];
+  if (decoded & (((1 << count) - 1) * DECODE_FIRST_INVALID)) {
+    DecodeWithInvalid(decoded, count);
+    return;
+  }
+  bit_acc |= (decoded & ((1 << count) - 1)) << bit_n;
+  bit_n += count;
+  if (bit_n >= 8) {
+    const uint8_t byte = bit_acc;
+    bit_acc >>= 8;
+    bit_n -= 8;
+    if (!OnPacketByte(byte)) EndPacket();
+  }
+}
+
+void IrLogic::DecodeWithInvalid(uint8_t decoded, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    if (decoded & (DECODE_FIRST_INVALID << i)) {
+      // decode error, with FEC it's an erasure of this byte instead, and the
+      // bit is the 0 the table has for it.
+      const bool fec = packet_state == STATE_DATA && data_end > rx_packet.size_;
+      const bool new_byte =
+          !rx_erasure_n || rx_erasures[rx_erasure_n - 1] != data_pos;
+      if (!fec || (new_byte && rx_erasure_n == IR_FEC_PARITY)) {
+        if (packet_state == STATE_DATA) CountPacket(false);
+        EndPacket();
+        return;
+      }
+      if (new_byte) rx_erasures[rx_erasure_n++] = data_pos;
+    }
+    bit_acc |= ((decoded >> i) & 1) << bit_n;
+    if (++bit_n == 8) {
+      const uint8_t byte = bit_acc;
+      bit_acc = 0;
+      bit_n = 0;
+      if (!OnPacketByte(byte)) {
+        EndPacket();
+        return;
+      }
+    }
+  }
+}
+
+static_assert(MAX_PACKET_PAYLOAD_BYTES - 1 + IR_FEC_PARITY <=
+              sizeof(IrPacket::data_));
+
+bool IrLogic::OnPacketByte(uint8_t byte) {
+  switch (packet_state) {
+    case STATE_SIZE: {
+      // The size counts itself and the checksum, not the parity.
+      const uint8_t size = byte & ~IR_FEC_FLAG;
+      if (size < 2 || size >= MAX_PACKET_PAYLOAD_BYTES) {
+        // Too large, or too small to hold the checksum.
+        return false;
+      }
+      rx_packet.size_ = size;
+      rx_packet.data_[0] = byte;
+      data_pos = 1;
+      data_end = byte & IR_FEC_FLAG ? size + IR_FEC_PARITY : size;
+      packet_state = STATE_DATA;
+      return true;
+    }
+    case STATE_DATA:
+      rx_packet.data_[data_pos++] = byte;
+      if (data_pos < data_end) return true;
+      OnPacketComplete();
+      return false;
+    default:
+      return false;
+  }
+}
+
+void IrLogic::OnPacketComplete() {
+  if (data_end > rx_packet.size_) {
+    const uint8_t size_byte = rx_packet.data_[0];
+    // A corrected size would have put the parity elsewhere.
+    if (!RsDecode(rx_packet.data_, data_end, rx_erasures, rx_erasure_n) ||
+        rx_packet.data_[0] != size_byte) {
+      CountPacket(false);
+      return;
+    }
+  }
+  // if valid packet
+  const uint32_t chksum =
+      merge_chksum(crc32(rx_packet.data_, rx_packet.size_ - 1));
+  const bool good = chksum == rx_packet.data_[rx_packet.size_ - 1];
+  CountPacket(good);
+  if (!good) return;
+  if (data_end > rx_packet.size_) tx_fec = true;
+  // pop checksum, and parity
+  memset(&rx_packet.data_[rx_packet.size_ - 1], 0,
+         data_end - rx_packet.size_ + 1);
+  rx_packet.size_--;
+  rx_packet.data_[0] = rx_packet.size_;
+  // double buffering
+  rx_packet_ctrler = rx_packet;
+  callback(callback_arg, reinterpret_cast<void *>(&rx_packet_ctrler));
+}
+
+void IrLogic::CountPacket(bool good) {
+  if (good) {
+    rx_good_packets++;
+    if (rx_fast) rx_fast_packets++;
+  } else {
+    rx_bad_packets++;
+  }
+  if (rx_good_packets + rx_bad_packets >= IR_LINK_STATS_WINDOW) {
+    rx_good_packets /= 2;
+    rx_bad_packets /= 2;
+    rx_fast_packets /= 2;
+  }
+}
+
+void IrLogic::EndPacket() {
+  packet_state = STATE_START;
+  g_suspender.DecBlocker();
+  header_window = 0;
+  sample_carry = 0;
+  sample_carry_n = 0;
+  bit_acc = 0;
+  bit_n = 0;
+  memset(&rx_packet, 0, sizeof(IrPacket));
+}
+
 void IrLogic::SetOnPacketReceived(callback_t callback, void *callback_arg1) {
   this->callback = callback;
   this->callback_arg = callback_arg1;
@@ -239,10 +355,17 @@ void IrLogic::SetOnPacketReceived(callback_t callback, void *callback_arg1) {
 void IrLogic::EncodePacket(uint8_t *data, size_t len, IrPacket &packet) {
   // size included
   packet.size_ = len + 2;
+  // Not for sizes no one receives, the parity wouldn't fit either.
+  const bool fec = tx_fec && packet.size_ < MAX_PACKET_PAYLOAD_BYTES;
   packet.data_[0] = static_cast<uint8_t>(packet.size_);
+  if (fec) packet.data_[0] |= IR_FEC_FLAG;
   memcpy(packet.data_ + 1, data, len * sizeof(data[0]));
   const uint8_t chksum = merge_chksum(crc32(packet.data_, len + 1));
   packet.data_[len + 1] = chksum;
+  if (fec) {
+    RsEncode(packet.data_, packet.size_, packet.data_ + packet.size_);
+    packet.size_ += IR_FEC_PARITY;
+  }
 }
 
 bool IrLogic::SendPacket(uint8_t *data, size_t len) {
@@ -254,13 +377,21 @@ bool IrLogic::SendPacket(uint8_t *data, size_t len) {
   if (!irService.CanSendBufferNow()) return false;
   // TODO: Check if tx_packet is in use.
   EncodePacket(data, len, tx_packet);
-  bool ret = irService.SendBuffer(tx_packet.data_, tx_packet.size_, true);
+  bool ret = irService.SendBuffer(tx_packet.data_, tx_packet.size_, true,
+                                  UseFastPhy());
   my_assert(ret);
   return ret;
 }
 
 bool IrLogic::AvailableToSend() { return irService.CanSendBufferNow(); }
 
+bool IrLogic::UseFastPhy() {
+  return (tx_fast || rx_fast_packets) &&
+         GetLoadFactor() <= IR_FAST_MAX_LOADFACTOR &&
+         rx_good_packets >= IR_FAST_MIN_GOOD &&
+         rx_bad_packets * IR_FAST_BAD_RATIO <= rx_good_packets;
+}
+
 int IrLogic::GetLoadFactor() {
   int ret = lowpass_loadfactor;
   ret = ret * 100 * LF_MAX_SCALE;
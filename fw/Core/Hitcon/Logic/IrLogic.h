@@ -15,6 +15,8 @@ namespace ir {
 struct IrPacket {
   // IR Packet
   // | header | data (1 byte size + n bytes data + 1 byte checksum) |
+  // With IR_FEC_FLAG in the size byte, IR_FEC_PARITY bytes follow the
+  // checksum. Received packets come without either, and without the flag.
 
   IrPacket() : size_(0) {}
 
@@ -45,7 +47,19 @@ class IrLogic {
   // Return true if it's possible for us to send directly.
   bool AvailableToSend();
 
+  // Adds the FEC parity if SetTxFec(true).
   void EncodePacket(uint8_t *data, size_t len, IrPacket &packet);
+  // Whether to send with FEC. Badges without it can't receive those, so it's
+  // off until a packet with it passes the checksum, whoever sent that has it.
+  // Packets with and without it are received either way.
+  void SetTxFec(bool on) { tx_fec = on; }
+  // Whether to send with the fast profile whenever UseFastPhy() allows, off by
+  // default as well. Badges don't set it, they follow a base station that
+  // does, see IR_FAST_MAX_LOADFACTOR. Both profiles are received either way.
+  void SetTxFast(bool on) { tx_fast = on; }
+  // If the next packet goes out with the fast profile, see
+  // IR_FAST_MAX_LOADFACTOR for when the link allows it.
+  bool UseFastPhy();
   // Enqueue the task and reset the counter
   void OnBufferReceivedEnqueueTask(uint8_t *buffer);
 
@@ -66,6 +80,15 @@ class IrLogic {
   // This variable is a mystery.
   size_t dummy1 = 0xBAADF00D;
 
+  bool tx_fec;
+  bool tx_fast;
+
+  // Checksum statistics, of the packets that got past the size byte.
+  uint16_t rx_good_packets;
+  uint16_t rx_bad_packets;
+  // Of rx_good_packets, the ones with the fast profile.
+  uint16_t rx_fast_packets;
+
   // Total periods collected for load factor computation.
   size_t lf_total_period;
   // Total periods of non-zero (transmission) collected for load factor
@@ -76,8 +99,46 @@ class IrLogic {
   // In Q15.16 fixed point.
   uint32_t lowpass_loadfactor;
 
+  // Runs OnBufferReceived() on this, so there can be more than one IrLogic
+  // (see Host/sim-ir.cc).
+  service::sched::Task buffer_received_task;
+
   // To split OnBufferReceived into pieces
   size_t buffer_received_ctr;
+
+  /* --- Receive state, see OnBufferReceived() --- */
+  uint8_t packet_state;
+  // The packet has the fast profile.
+  bool rx_fast;
+  // The last 32 samples while looking for the header, the newest on top.
+  uint32_t header_window;
+  // Samples after the last whole pair of data bits, the oldest in bit 0.
+  uint8_t sample_carry;
+  uint8_t sample_carry_n;
+  // Decoded bits short of a whole byte, the oldest in bit 0.
+  uint16_t bit_acc;
+  uint8_t bit_n;
+  // Where the next data byte goes in rx_packet.data_.
+  uint8_t data_pos;
+  // Where the packet ends in rx_packet.data_, past the parity with FEC.
+  uint8_t data_end;
+  // With FEC, the bytes that had undecodable bits, taken as 0 for now.
+  uint8_t rx_erasures[IR_FEC_PARITY];
+  uint8_t rx_erasure_n;
+
+ private:
+  void SearchHeader(uint8_t samples);
+  void StartPacket(bool fast);
+  // Decode count data bits of 4 samples each, or 2 with rx_fast.
+  void DecodeSamples(uint8_t samples, uint8_t count);
+  // DecodeSamples() a bit at a time, once some of them are undecodable.
+  void DecodeWithInvalid(uint8_t decoded, uint8_t count);
+  // Return false once the packet is over, complete or not.
+  bool OnPacketByte(uint8_t byte);
+  // Check, and deliver if fine.
+  void OnPacketComplete();
+  void CountPacket(bool good);
+  void EndPacket();
 };
 
 extern IrLogic irLogic;
@@ -0,0 +1,133 @@
+#ifndef LOGIC_MOD_ARITH_H_
+#define LOGIC_MOD_ARITH_H_
+
+#include <stdint.h>
+
+// Multiply field elements of the curve in Montgomery form (see FieldNum in
+// EcLogic.h) instead of with 64 modular doublings. Set to 0 to go back to
+// modmul_shiftadd() everywhere.
+#ifndef ECC_MONTGOMERY
+#define ECC_MONTGOMERY 1
+#endif
+
+namespace hitcon {
+
+namespace ecc {
+
+namespace internal {
+
+constexpr inline uint64_t modneg(const uint64_t x, const uint64_t m) {
+  return m - (x % m);
+}
+
+constexpr inline uint64_t modadd(const uint64_t a, const uint64_t b,
+                                 const uint64_t m) {
+  if (a > UINT64_MAX - b)
+    return modneg((modneg(a, m) + modneg(b, m)) % m, m);
+  else
+    return (a + b) % m;
+}
+
+constexpr inline uint64_t modsub(const uint64_t a, const uint64_t b,
+                                 const uint64_t m) {
+  if (a >= b)
+    return a - b;
+  else
+    return a + m - b;
+}
+
+// a * b mod m by double-and-add, works for any m.
+constexpr inline uint64_t modmul_shiftadd(uint64_t a, uint64_t b, uint64_t m) {
+  uint64_t res = 0;
+  for (int i = 0; i < 64; ++i) {
+    res = modadd(res, res, m);
+    if (b & (1ULL << 63)) res = modadd(res, a, m);
+    b <<= 1;
+  }
+  return res;
+}
+
+// Montgomery multiplication with R = 2^64, for an odd m below 2^62.
+struct MontParams {
+  uint64_t m;
+  // -m^-1 mod 2^32.
+  uint32_t mInv;
+  // R^2 mod m, montmul() by it converts into Montgomery form.
+  uint64_t r2;
+};
+
+constexpr inline MontParams MakeMontParams(uint64_t m) {
+  // Newton's iteration, each step doubles the correct low bits. m * m is 1
+  // mod 8 for any odd m, so it starts with 3 of them.
+  uint32_t inv = static_cast<uint32_t>(m);
+  for (int i = 0; i < 4; i++) inv *= 2 - static_cast<uint32_t>(m) * inv;
+  uint64_t r2 = (UINT64_MAX % m + 1) % m;
+  for (int i = 0; i < 64; i++) r2 = modadd(r2, r2, m);
+  return MontParams{m, static_cast<uint32_t>(0 - inv), r2};
+}
+
+// a * b / R mod p.m, for any a and b < p.m. Two word-by-word rows (CIOS),
+// every product is 32x32->64 so it's a UMULL/UMLAL each on Cortex-M3.
+constexpr inline uint64_t montmul(uint64_t a, uint64_t b,
+                                  const MontParams &p) {
+  const uint32_t b0 = static_cast<uint32_t>(b), b1 = b >> 32;
+  const uint32_t m0 = static_cast<uint32_t>(p.m), m1 = p.m >> 32;
+  uint32_t t0 = 0, t1 = 0, t2 = 0;
+  for (int i = 0; i < 2; i++) {
+    const uint32_t ai = static_cast<uint32_t>(i ? a >> 32 : a);
+    // t += ai * b
+    uint64_t c = static_cast<uint64_t>(ai) * b0 + t0;
+    t0 = static_cast<uint32_t>(c);
+    c = static_cast<uint64_t>(ai) * b1 + t1 + (c >> 32);
+    t1 = static_cast<uint32_t>(c);
+    c = static_cast<uint64_t>(t2) + (c >> 32);
+    t2 = static_cast<uint32_t>(c);
+    const uint32_t t3 = c >> 32;
+    // t = (t + u * m) / 2^32, u is picked so that the low word drops out.
+    const uint32_t u = t0 * p.mInv;
+    c = static_cast<uint64_t>(u) * m0 + t0;
+    c = static_cast<uint64_t>(u) * m1 + t1 + (c >> 32);
+    t0 = static_cast<uint32_t>(c);
+    c = static_cast<uint64_t>(t2) + (c >> 32);
+    t1 = static_cast<uint32_t>(c);
+    t2 = t3 + static_cast<uint32_t>(c >> 32);
+  }
+  // t < a * b / R + m < 2m, and t2 is 0 since 2m < 2^64.
+  const uint64_t t = static_cast<uint64_t>(t1) << 32 | t0;
+  return t >= p.m ? t - p.m : t;
+}
+
+constexpr inline uint64_t tomont(uint64_t x, const MontParams &p) {
+  return montmul(x, p.r2, p);
+}
+
+constexpr inline uint64_t frommont(uint64_t x, const MontParams &p) {
+  return montmul(x, 1, p);
+}
+
+// a * b mod p.m in plain form, for any a and b < p.m.
+constexpr inline uint64_t modmul_mont(uint64_t a, uint64_t b,
+                                      const MontParams &p) {
+  return montmul(montmul(a, b, p), p.r2, p);
+}
+
+// a^-1 mod p.m by Fermat's little theorem, for a prime p.m and a not a
+// multiple of it. Slow next to ModDivService, it's for constexpr tables.
+constexpr inline uint64_t modinv_prime(uint64_t a, const MontParams &p) {
+  const uint64_t am = tomont(a, p);
+  uint64_t res = tomont(1, p);
+  const uint64_t e = p.m - 2;
+  for (int i = 63; i >= 0; i--) {
+    res = montmul(res, res, p);
+    if (e >> i & 1) res = montmul(res, am, p);
+  }
+  return frommont(res, p);
+}
+
+}  // namespace internal
+
+}  // namespace ecc
+
+}  // namespace hitcon
+
+#endif  // LOGIC_MOD_ARITH_H_
@@ -46,50 +46,56 @@ bool SecureRandomPool::GetRandom(uint64_t* res) {
 }
 
 void SecureRandomPool::Routine(void* unused) {
-  switch (routine_state) {
-    case SECURE_ROUTINE_IDLE: {
-      if (!seed_queue.IsEmpty()) {
-        routine_state = SECURE_SEED_START;
+  // Keep going until the pool has nothing to do or the scheduler needs the CPU
+  // back.
+  do {
+    switch (routine_state) {
+      case SECURE_ROUTINE_IDLE: {
+        if (!seed_queue.IsEmpty()) {
+          routine_state = SECURE_SEED_START;
+          break;
+        }
+        if (seed_count >= kMinSeedCountBeforeReady && !random_queue.IsFull()) {
+          routine_state = SECURE_RANDOM_START;
+          break;
+        }
         break;
       }
-      if (seed_count >= kMinSeedCountBeforeReady && !random_queue.IsFull()) {
-        routine_state = SECURE_RANDOM_START;
+      case SECURE_SEED_START: {
+        uint64_t seed_val = seed_queue.Front();
+        seed_queue.PopFront();
+        for (size_t i = 0; i < sizeof(uint64_t); i++) {
+          keccak_context.u.sb[i] ^= static_cast<uint8_t>(seed_val >> (8 * i));
+        }
+        seed_count++;
+        keccakf_round = 0;
+        routine_state = SECURE_KECCAKF;
         break;
       }
-      break;
-    }
-    case SECURE_SEED_START: {
-      uint64_t seed_val = seed_queue.Front();
-      seed_queue.PopFront();
-      for (size_t i = 0; i < sizeof(uint64_t); i++) {
-        keccak_context.u.sb[i] ^= static_cast<uint8_t>(seed_val >> (8 * i));
-      }
-      seed_count++;
-      keccakf_round = 0;
-      routine_state = SECURE_KECCAKF;
-      break;
-    }
-    case SECURE_KECCAKF: {
-      keccakf_split(keccak_context.u.s, keccakf_round);
-      keccakf_round++;
-      if (keccakf_round == KECCAK_ROUNDS) {
-        routine_state = SECURE_ROUTINE_IDLE;
+      case SECURE_KECCAKF: {
+        keccakf_split(keccak_context.u.s, keccakf_round);
+        keccakf_round++;
+        if (keccakf_round == KECCAK_ROUNDS) {
+          routine_state = SECURE_ROUTINE_IDLE;
+        }
+        break;
       }
-      break;
-    }
-    case SECURE_RANDOM_START: {
-      uint64_t random_val = 0;
-      for (size_t i = 0; i < sizeof(uint64_t); i++) {
-        random_val |= static_cast<uint64_t>(keccak_context.u.sb[i]) << (8 * i);
+      case SECURE_RANDOM_START: {
+        uint64_t random_val = 0;
+        for (size_t i = 0; i < sizeof(uint64_t); i++) {
+          random_val |= static_cast<uint64_t>(keccak_context.u.sb[i])
+                        << (8 * i);
+        }
+        random_queue.PushBack(random_val);
+        keccakf_round = 0;
+        routine_state = SECURE_KECCAKF;
+        break;
       }
-      random_queue.PushBack(random_val);
-      keccakf_round = 0;
-      routine_state = SECURE_KECCAKF;
-      break;
+      default:
+        my_assert(false);
     }
-    default:
-      my_assert(false);
-  }
+  } while (routine_state != SECURE_ROUTINE_IDLE &&
+           hitcon::service::sched::scheduler.RemainingBudget());
 }
 
 FastRandomPool::FastRandomPool() : prng(0) {}
@@ -5,6 +5,7 @@
 #include <Logic/pcg32.h>
 #include <Service/PerBoardData.h>
 #include <Service/Sched/Scheduler.h>
+#include <Util/CircularQueue.h>
 #include <stddef.h>
 #include <stdint.h>
 
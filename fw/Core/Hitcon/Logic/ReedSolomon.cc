@@ -0,0 +1,177 @@
+#include <Logic/ReedSolomon.h>
+
+namespace hitcon {
+namespace ir {
+
+namespace {
+
+constexpr size_t kOrder = 255;
+constexpr unsigned kPrimitive = 0x11d;
+
+struct GfTables {
+  // Twice over, so a sum of two logs needs no reduction.
+  uint8_t exp[2 * kOrder];
+  uint8_t log[kOrder + 1];
+};
+
+constexpr GfTables MakeGfTables() {
+  GfTables t = {};
+  unsigned x = 1;
+  for (unsigned i = 0; i < kOrder; i++) {
+    t.exp[i] = t.exp[i + kOrder] = x;
+    t.log[x] = i;
+    x <<= 1;
+    if (x & 0x100) x ^= kPrimitive;
+  }
+  return t;
+}
+
+constexpr GfTables kGf = MakeGfTables();
+
+constexpr uint8_t GfMul(uint8_t a, uint8_t b) {
+  return a && b ? kGf.exp[kGf.log[a] + kGf.log[b]] : 0;
+}
+
+// a must not be 0.
+constexpr uint8_t GfInv(uint8_t a) { return kGf.exp[kOrder - kGf.log[a]]; }
+
+// Polynomials below are IR_FEC_PARITY + 1 coefficients, lowest degree first.
+constexpr size_t kTerms = IR_FEC_PARITY + 1;
+
+struct Generator {
+  uint8_t coef[kTerms];
+};
+
+// The product of (x + a^i) for i in [0, IR_FEC_PARITY).
+constexpr Generator MakeGenerator() {
+  Generator g = {};
+  g.coef[0] = 1;
+  for (size_t i = 0; i < IR_FEC_PARITY; i++) {
+    for (size_t j = i + 1; j > 0; j--) {
+      g.coef[j] = g.coef[j - 1] ^ GfMul(g.coef[j], kGf.exp[i]);
+    }
+    g.coef[0] = GfMul(g.coef[0], kGf.exp[i]);
+  }
+  return g;
+}
+
+constexpr Generator kGenerator = MakeGenerator();
+
+uint8_t PolyEval(const uint8_t *poly, uint8_t x) {
+  uint8_t y = 0;
+  for (size_t j = kTerms; j > 0; j--) y = GfMul(y, x) ^ poly[j - 1];
+  return y;
+}
+
+// Returns whether any of them is nonzero, that is codeword has errors.
+bool Syndromes(const uint8_t *codeword, size_t len,
+               uint8_t synd[IR_FEC_PARITY]) {
+  uint8_t any = 0;
+  for (size_t k = 0; k < IR_FEC_PARITY; k++) {
+    uint8_t s = 0;
+    for (size_t i = 0; i < len; i++) {
+      s = (s ? kGf.exp[kGf.log[s] + k] : 0) ^ codeword[i];
+    }
+    synd[k] = s;
+    any |= s;
+  }
+  return any;
+}
+
+}  // namespace
+
+void RsEncode(const uint8_t *data, size_t len, uint8_t *parity) {
+  // The remainder of data(x) * x^IR_FEC_PARITY over the generator, highest
+  // degree first.
+  for (size_t j = 0; j < IR_FEC_PARITY; j++) parity[j] = 0;
+  for (size_t i = 0; i < len; i++) {
+    const uint8_t feedback = data[i] ^ parity[0];
+    for (size_t j = 0; j + 1 < IR_FEC_PARITY; j++) {
+      parity[j] = parity[j + 1] ^
+                  GfMul(feedback, kGenerator.coef[IR_FEC_PARITY - 1 - j]);
+    }
+    parity[IR_FEC_PARITY - 1] = GfMul(feedback, kGenerator.coef[0]);
+  }
+}
+
+bool RsDecode(uint8_t *codeword, size_t len, const uint8_t *erasures,
+              size_t erasure_count) {
+  if (len <= IR_FEC_PARITY || len > kOrder || erasure_count > IR_FEC_PARITY) {
+    return false;
+  }
+  uint8_t synd[IR_FEC_PARITY];
+  if (!Syndromes(codeword, len, synd)) return true;
+
+  // Berlekamp-Massey for the errata locator, started from the erasure locator
+  // (the product of 1 + X x over the erasures, X = a^(len - 1 - position)).
+  uint8_t lambda[kTerms] = {1};
+  for (size_t e = 0; e < erasure_count; e++) {
+    if (erasures[e] >= len) return false;
+    const uint8_t x = kGf.exp[len - 1 - erasures[e]];
+    for (size_t j = e + 1; j > 0; j--) lambda[j] ^= GfMul(lambda[j - 1], x);
+  }
+  uint8_t prev[kTerms];
+  for (size_t j = 0; j < kTerms; j++) prev[j] = lambda[j];
+  size_t degree = erasure_count;
+  for (size_t r = erasure_count; r < IR_FEC_PARITY; r++) {
+    uint8_t delta = 0;
+    for (size_t i = 0; i <= r; i++) delta ^= GfMul(lambda[i], synd[r - i]);
+    for (size_t j = kTerms - 1; j > 0; j--) prev[j] = prev[j - 1];
+    prev[0] = 0;
+    if (!delta) continue;
+    uint8_t next[kTerms];
+    for (size_t j = 0; j < kTerms; j++) {
+      next[j] = lambda[j] ^ GfMul(delta, prev[j]);
+    }
+    if (2 * degree <= r + erasure_count) {
+      const uint8_t inv = GfInv(delta);
+      for (size_t j = 0; j < kTerms; j++) prev[j] = GfMul(lambda[j], inv);
+      degree = r + 1 + erasure_count - degree;
+    }
+    for (size_t j = 0; j < kTerms; j++) lambda[j] = next[j];
+  }
+  size_t terms = kTerms;
+  while (terms > 1 && !lambda[terms - 1]) terms--;
+  if (terms - 1 != degree) return false;
+
+  // Chien search for the positions, which have to be within the shortened
+  // code.
+  uint8_t positions[IR_FEC_PARITY];
+  size_t found = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (PolyEval(lambda, kGf.exp[kOrder - (len - 1 - i)])) continue;
+    if (found == degree) return false;
+    positions[found++] = i;
+  }
+  if (found != degree) return false;
+
+  // Forney, omega(x) = synd(x) lambda(x) mod x^IR_FEC_PARITY.
+  uint8_t omega[kTerms] = {};
+  for (size_t i = 0; i < IR_FEC_PARITY; i++) {
+    for (size_t j = 0; j <= i; j++) omega[i] ^= GfMul(synd[i - j], lambda[j]);
+  }
+  uint8_t magnitudes[IR_FEC_PARITY];
+  for (size_t e = 0; e < found; e++) {
+    const size_t power = len - 1 - positions[e];
+    const uint8_t x_inv = kGf.exp[kOrder - power];
+    // The formal derivative of lambda keeps the odd terms.
+    uint8_t derivative = 0, x_pow = 1;
+    for (size_t j = 1; j < kTerms; j += 2) {
+      derivative ^= GfMul(lambda[j], x_pow);
+      x_pow = GfMul(x_pow, GfMul(x_inv, x_inv));
+    }
+    if (!derivative) return false;
+    magnitudes[e] = GfMul(GfMul(kGf.exp[power], PolyEval(omega, x_inv)),
+                          GfInv(derivative));
+  }
+
+  for (size_t e = 0; e < found; e++) codeword[positions[e]] ^= magnitudes[e];
+  if (Syndromes(codeword, len, synd)) {
+    for (size_t e = 0; e < found; e++) codeword[positions[e]] ^= magnitudes[e];
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ir
+}  // namespace hitcon
@@ -0,0 +1,31 @@
+#ifndef HITCON_LOGIC_REED_SOLOMON_H_
+#define HITCON_LOGIC_REED_SOLOMON_H_
+
+#include <Service/IrParam.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace hitcon {
+namespace ir {
+
+// Shortened Reed-Solomon code over GF(2^8) (x^8 + x^4 + x^3 + x^2 + 1), with
+// IR_FEC_PARITY parity bytes and the generator roots a^0 to
+// a^(IR_FEC_PARITY - 1). The first byte of a codeword is the highest degree
+// coefficient.
+//
+// A codeword with e wrong bytes and f erased ones (known positions, wrong or
+// not) can be corrected if 2e + f <= IR_FEC_PARITY.
+
+// Compute the parity bytes of data[0, len) into parity[0, IR_FEC_PARITY).
+void RsEncode(const uint8_t *data, size_t len, uint8_t *parity);
+
+// Correct codeword[0, len), the data followed by its parity, in place.
+// erasures holds erasure_count distinct byte positions. Returns false, with
+// codeword untouched, if it has more errors than the code can correct.
+bool RsDecode(uint8_t *codeword, size_t len, const uint8_t *erasures,
+              size_t erasure_count);
+
+}  // namespace ir
+}  // namespace hitcon
+
+#endif  // #ifndef HITCON_LOGIC_REED_SOLOMON_H_
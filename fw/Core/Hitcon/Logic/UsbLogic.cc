@@ -115,11 +115,76 @@ void UsbLogic::OnDataRecv(void* arg2) {
       _state = USB_STATE_IDLE;
       break;
     }
+    case USB_STATE_READ_PROFILE:
+      SendProfilePage(data[2], data[3]);
+      _state = USB_STATE_IDLE;
+      break;
     default:
       break;
   }
 }
 
+void UsbLogic::SendProfilePage(uint8_t index, uint8_t page) {
+  uint8_t report[REPORT_LEN - 1] = {0};
+  uint32_t* u32 = reinterpret_cast<uint32_t*>(report);
+  if (index == PROFILE_INDEX_LAST_MISS) {
+    const DeadlineMiss& miss = scheduler.GetLastDeadlineMiss();
+    if (page == 0) {
+      u32[0] = reinterpret_cast<uintptr_t>(miss.task);
+      u32[1] = reinterpret_cast<uintptr_t>(miss.offender);
+    } else if (page == 1) {
+      u32[0] = miss.lateCycles;
+      u32[1] = miss.offenderCycles;
+    } else if (page == 2) {
+      u32[0] = scheduler.GetDeadlineMisses();
+      u32[1] = miss.time;
+    }
+    g_usb_service.SendCustomReport(report);
+    return;
+  }
+#if SCHED_PROFILE
+  Profiler& profiler = scheduler.GetProfiler();
+  if (index < profiler.size()) {
+    const TaskProfile& p = profiler.Get(index);
+    switch (page) {
+      case PROFILE_PAGE_TASK:
+        u32[0] = reinterpret_cast<uintptr_t>(p.task);
+        u32[1] = p.runs;
+        break;
+      case PROFILE_PAGE_MAX:
+        u32[0] = p.execMax;
+        u32[1] = p.waitMax;
+        break;
+      case PROFILE_PAGE_EXEC_TOTAL:
+        memcpy(report, &p.execTotal, sizeof(p.execTotal));
+        break;
+      case PROFILE_PAGE_WAIT_TOTAL:
+        memcpy(report, &p.waitTotal, sizeof(p.waitTotal));
+        break;
+      case PROFILE_PAGE_MISSES:
+        u32[0] = p.misses;
+        u32[1] = p.task ? p.task->GetDeadline() : 0;
+        break;
+      default:
+        if (page >= PROFILE_PAGE_EXEC_HIST && page < PROFILE_PAGE_MISSES) {
+          const uint16_t* hist = page < PROFILE_PAGE_WAIT_HIST
+                                     ? &p.execHist[0]
+                                     : &p.waitHist[0];
+          unsigned first = (page < PROFILE_PAGE_WAIT_HIST
+                                ? page - PROFILE_PAGE_EXEC_HIST
+                                : page - PROFILE_PAGE_WAIT_HIST) *
+                           4;
+          for (unsigned i = 0; i < 4 && first + i < kHistBuckets; i++) {
+            memcpy(&report[i * 2], &hist[first + i], 2);
+          }
+        }
+        break;
+    }
+  }
+#endif
+  g_usb_service.SendCustomReport(report);
+}
+
 // 1. check for erase done
 // 2. program the script
 void UsbLogic::WriteRoutine(void* unused) {
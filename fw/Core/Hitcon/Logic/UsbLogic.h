@@ -47,6 +47,7 @@ enum usb_state_t {
   USB_STATE_WRITING,
   USB_STATE_WAITING,     // waiting flash service done program
   USB_STATE_WAIT_ERASE,  // waiting erase done
+  USB_STATE_READ_PROFILE,
 };
 
 enum {  // script code definition
@@ -59,6 +60,26 @@ enum {  // script code definition
 // e.g. program partial done, set name, r/w memory
 constexpr uint8_t CODE_ACTION_DONE = 0xFF;
 
+// Pages of a USB_STATE_READ_PROFILE reply, each is REPORT_LEN - 1 bytes,
+// little endian. An index past the used profile entries reads as all zero,
+// except PROFILE_INDEX_LAST_MISS.
+enum profile_page_t {
+  PROFILE_PAGE_TASK = 0,    // u32 task pointer, u32 runs
+  PROFILE_PAGE_MAX,         // u32 max exec cycles, u32 max wait cycles
+  PROFILE_PAGE_EXEC_TOTAL,  // u64 total exec cycles
+  PROFILE_PAGE_WAIT_TOTAL,  // u64 total wait cycles
+  PROFILE_PAGE_EXEC_HIST,   // 3 pages of 4 u16 exec histogram buckets
+  PROFILE_PAGE_WAIT_HIST = PROFILE_PAGE_EXEC_HIST + 3,  // Same for wait
+  PROFILE_PAGE_MISSES = PROFILE_PAGE_WAIT_HIST + 3,  // u32 misses, u32 deadline
+  PROFILE_PAGE_COUNT,
+};
+
+// Profile index that reads the last deadline miss instead.
+// Page 0: u32 task pointer, u32 offender pointer.
+// Page 1: u32 cycles past the deadline, u32 offender cycles.
+// Page 2: u32 total misses, u32 SysTimer time of the miss.
+constexpr uint8_t PROFILE_INDEX_LAST_MISS = 0xFF;
+
 enum mem_type_t {  // definiton for memory read/write type
   MEM_BYTE = 1,
   MEM_HALFWORD,
@@ -85,6 +106,7 @@ class UsbLogic {
   hitcon::service::sched::PeriodicTask _write_routine_task;
   void Routine(void* unused);
   void WriteRoutine(void* unused);
+  void SendProfilePage(uint8_t index, uint8_t page);
   callback_t _on_finish_cb;
   void* _on_finish_arg1;
   callback_t _on_err_cb;
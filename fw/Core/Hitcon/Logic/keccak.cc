@@ -69,6 +69,172 @@ static const unsigned keccakf_piln[24] = {10, 7,  11, 17, 18, 3,  5,  16,
                                           8,  21, 24, 4,  15, 23, 19, 13,
                                           12, 2,  20, 14, 22, 9,  6,  1};
 
+/* Bit interleaving, see KECCAK_INTERLEAVED. Only 32-bit operations. */
+
+/* Gather the even bits of x into the low 16 bits. */
+static constexpr inline uint32_t keccak_il_compress(uint32_t x) {
+  x &= 0x55555555;
+  x = (x | (x >> 1)) & 0x33333333;
+  x = (x | (x >> 2)) & 0x0F0F0F0F;
+  x = (x | (x >> 4)) & 0x00FF00FF;
+  x = (x | (x >> 8)) & 0x0000FFFF;
+  return x;
+}
+
+/* Inverse of keccak_il_compress(), spread the low 16 bits to the even bits. */
+static constexpr inline uint32_t keccak_il_spread(uint32_t x) {
+  x &= 0x0000FFFF;
+  x = (x | (x << 8)) & 0x00FF00FF;
+  x = (x | (x << 4)) & 0x0F0F0F0F;
+  x = (x | (x << 2)) & 0x33333333;
+  x = (x | (x << 1)) & 0x55555555;
+  return x;
+}
+
+static constexpr inline uint32_t keccak_il_even(uint64_t x) {
+  return keccak_il_compress((uint32_t)x) |
+         (keccak_il_compress((uint32_t)(x >> 32)) << 16);
+}
+
+static constexpr inline uint32_t keccak_il_odd(uint64_t x) {
+  return keccak_il_compress((uint32_t)x >> 1) |
+         (keccak_il_compress((uint32_t)(x >> 32) >> 1) << 16);
+}
+
+static constexpr inline uint64_t keccak_il_merge(uint32_t even, uint32_t odd) {
+  return (uint64_t)(keccak_il_spread(even) | (keccak_il_spread(odd) << 1)) |
+         ((uint64_t)(keccak_il_spread(even >> 16) |
+                     (keccak_il_spread(odd >> 16) << 1))
+          << 32);
+}
+
+/* XOR a lane of input into the state. */
+static inline void keccak_xor_lane(sha3_context *ctx, unsigned i, uint64_t v) {
+#if KECCAK_INTERLEAVED
+  ctx->u.w[2 * i] ^= keccak_il_even(v);
+  ctx->u.w[2 * i + 1] ^= keccak_il_odd(v);
+#else
+  ctx->u.s[i] ^= v;
+#endif
+}
+
+/* Convert the state to bytes after the final keccakf. */
+static void keccak_squeeze(sha3_context *ctx) {
+  for (unsigned i = 0; i < SHA3_KECCAK_SPONGE_WORDS; i++) {
+#if KECCAK_INTERLEAVED
+    const uint64_t v = keccak_il_merge(ctx->u.w[2 * i], ctx->u.w[2 * i + 1]);
+#else
+    const uint64_t v = ctx->u.s[i];
+#endif
+    const unsigned t1 = (uint32_t)v;
+    const unsigned t2 = (uint32_t)((v >> 16) >> 16);
+    ctx->u.sb[i * 8 + 0] = (uint8_t)(t1);
+    ctx->u.sb[i * 8 + 1] = (uint8_t)(t1 >> 8);
+    ctx->u.sb[i * 8 + 2] = (uint8_t)(t1 >> 16);
+    ctx->u.sb[i * 8 + 3] = (uint8_t)(t1 >> 24);
+    ctx->u.sb[i * 8 + 4] = (uint8_t)(t2);
+    ctx->u.sb[i * 8 + 5] = (uint8_t)(t2 >> 8);
+    ctx->u.sb[i * 8 + 6] = (uint8_t)(t2 >> 16);
+    ctx->u.sb[i * 8 + 7] = (uint8_t)(t2 >> 24);
+  }
+}
+
+#if KECCAK_INTERLEAVED
+
+struct keccakf_rndc_il_t {
+  uint32_t even[24];
+  uint32_t odd[24];
+};
+
+static constexpr keccakf_rndc_il_t keccakf_make_rndc_il() {
+  keccakf_rndc_il_t t{};
+  for (int i = 0; i < 24; i++) {
+    t.even[i] = keccak_il_even(keccakf_rndc[i]);
+    t.odd[i] = keccak_il_odd(keccakf_rndc[i]);
+  }
+  return t;
+}
+
+static constexpr keccakf_rndc_il_t keccakf_rndc_il = keccakf_make_rndc_il();
+
+/* n is 0..31 */
+static inline uint32_t keccak_rol32(uint32_t x, unsigned n) {
+  return (x << n) | (x >> ((32 - n) & 31));
+}
+
+/* Same steps as the 64-bit version below, lane i is s[2 * i] (even bits) and
+ * s[2 * i + 1] (odd bits). A 64-bit rotation by r rotates both halves by r/2,
+ * and for odd r also swaps them. */
+static void keccakf_round_il(uint32_t *s, int round) {
+  int i, j;
+  unsigned r;
+  uint32_t te, to, bce[5], bco[5];
+
+  /* Theta */
+  for (i = 0; i < 5; i++) {
+    bce[i] = s[2 * i] ^ s[2 * (i + 5)] ^ s[2 * (i + 10)] ^ s[2 * (i + 15)] ^
+             s[2 * (i + 20)];
+    bco[i] = s[2 * i + 1] ^ s[2 * (i + 5) + 1] ^ s[2 * (i + 10) + 1] ^
+             s[2 * (i + 15) + 1] ^ s[2 * (i + 20) + 1];
+  }
+
+  for (i = 0; i < 5; i++) {
+    te = bce[(i + 4) % 5] ^ keccak_rol32(bco[(i + 1) % 5], 1);
+    to = bco[(i + 4) % 5] ^ bce[(i + 1) % 5];
+    for (j = 0; j < 25; j += 5) {
+      s[2 * (j + i)] ^= te;
+      s[2 * (j + i) + 1] ^= to;
+    }
+  }
+
+  /* Rho Pi */
+  te = s[2];
+  to = s[3];
+  for (i = 0; i < 24; i++) {
+    j = keccakf_piln[i];
+    r = keccakf_rotc[i];
+    bce[0] = s[2 * j];
+    bco[0] = s[2 * j + 1];
+    if (r & 1) {
+      s[2 * j] = keccak_rol32(to, (r + 1) / 2);
+      s[2 * j + 1] = keccak_rol32(te, r / 2);
+    } else {
+      s[2 * j] = keccak_rol32(te, r / 2);
+      s[2 * j + 1] = keccak_rol32(to, r / 2);
+    }
+    te = bce[0];
+    to = bco[0];
+  }
+
+  /* Chi */
+  for (j = 0; j < 25; j += 5) {
+    for (i = 0; i < 5; i++) {
+      bce[i] = s[2 * (j + i)];
+      bco[i] = s[2 * (j + i) + 1];
+    }
+    for (i = 0; i < 5; i++) {
+      s[2 * (j + i)] ^= (~bce[(i + 1) % 5]) & bce[(i + 2) % 5];
+      s[2 * (j + i) + 1] ^= (~bco[(i + 1) % 5]) & bco[(i + 2) % 5];
+    }
+  }
+
+  /* Iota */
+  s[0] ^= keccakf_rndc_il.even[round];
+  s[1] ^= keccakf_rndc_il.odd[round];
+}
+
+void keccakf(uint64_t s[25]) {
+  for (unsigned round = 0; round < KECCAK_ROUNDS; round++) {
+    keccakf_round_il(reinterpret_cast<uint32_t *>(s), round);
+  }
+}
+
+void keccakf_split(uint64_t s[25], int round) {
+  keccakf_round_il(reinterpret_cast<uint32_t *>(s), round);
+}
+
+#else  // KECCAK_INTERLEAVED
+
 /* generally called after SHA3_KECCAK_SPONGE_WORDS-ctx->capacityWords words
  * are XORed into the state s
  */
@@ -140,6 +306,8 @@ void keccakf_split(uint64_t s[25], int round) {
   s[0] ^= keccakf_rndc[round];
 }
 
+#endif  // KECCAK_INTERLEAVED
+
 /* *************************** Public Inteface ************************ */
 
 /* For Init or Reset call these: */
@@ -175,7 +343,7 @@ void sha3_UpdateWord(void *priv, void const *bufIn) {
 
   const uint64_t *t = reinterpret_cast<const uint64_t *>(bufIn);
 
-  ctx->u.s[ctx->wordIndex] ^= *t;
+  keccak_xor_lane(ctx, ctx->wordIndex, *t);
   if (++ctx->wordIndex ==
       (SHA3_KECCAK_SPONGE_WORDS - SHA3_CW(ctx->capacityWords))) {
     keccakf(ctx->u.s);
@@ -189,7 +357,7 @@ int sha3_UpdateWord_split(void *priv, void const *bufIn, int round) {
   if (round == 0) {
     const uint64_t *t = reinterpret_cast<const uint64_t *>(bufIn);
 
-    ctx->u.s[ctx->wordIndex] ^= *t;
+    keccak_xor_lane(ctx, ctx->wordIndex, *t);
     if (++ctx->wordIndex ==
         (SHA3_KECCAK_SPONGE_WORDS - SHA3_CW(ctx->capacityWords)))
       return 1;
@@ -207,6 +375,38 @@ int sha3_UpdateWord_split(void *priv, void const *bufIn, int round) {
   }
 }
 
+int sha3_UpdateBlock_split(void *priv, void const *bufIn, size_t len,
+                           size_t *absorbed, int round) {
+  sha3_context *ctx = (sha3_context *)priv;
+
+  if (round == 0) {
+    const uint8_t *buf = reinterpret_cast<const uint8_t *>(bufIn);
+    const unsigned rateWords =
+        SHA3_KECCAK_SPONGE_WORDS - SHA3_CW(ctx->capacityWords);
+    size_t n = 0;
+
+    SHA3_ASSERT(ctx->byteIndex == 0);
+    while (len - n >= sizeof(uint64_t) && ctx->wordIndex < rateWords) {
+      uint64_t t;
+      /* bufIn needn't be aligned, little-endian like sha3_UpdateWord() */
+      memcpy(&t, buf + n, sizeof(t));
+      keccak_xor_lane(ctx, ctx->wordIndex++, t);
+      n += sizeof(uint64_t);
+    }
+    *absorbed = n;
+    return ctx->wordIndex == rateWords ? 1 : 0;
+  } else { /* 1 <= round <= KECCAK_ROUNDS */
+    keccakf_split(ctx->u.s, round - 1);
+
+    if (round == KECCAK_ROUNDS) {
+      ctx->wordIndex = 0;
+      return 0;
+    } else {
+      return round + 1;
+    }
+  }
+}
+
 void sha3_UpdateFinalWord(void *priv, void const *bufIn, size_t len) {
   size_t i;
   sha3_context *ctx = (sha3_context *)priv;
@@ -267,7 +467,7 @@ void sha3_Update(void *priv, void const *bufIn, size_t len) {
       ctx->saved |= (uint64_t)(*(buf++)) << ((ctx->byteIndex++) * 8);
 
     /* now ready to add saved to the sponge */
-    ctx->u.s[ctx->wordIndex] ^= ctx->saved;
+    keccak_xor_lane(ctx, ctx->wordIndex, ctx->saved);
     SHA3_ASSERT(ctx->byteIndex == 8);
     ctx->byteIndex = 0;
     ctx->saved = 0;
@@ -296,7 +496,7 @@ void sha3_Update(void *priv, void const *bufIn, size_t len) {
 #if defined(__x86_64__) || defined(__i386__)
     SHA3_ASSERT(memcmp(&t, buf, 8) == 0);
 #endif
-    ctx->u.s[ctx->wordIndex] ^= t;
+    keccak_xor_lane(ctx, ctx->wordIndex, t);
     if (++ctx->wordIndex ==
         (SHA3_KECCAK_SPONGE_WORDS - SHA3_CW(ctx->capacityWords))) {
       keccakf(ctx->u.s);
@@ -331,28 +531,18 @@ void const *sha3_Finalize_split(void *priv, int round) {
       t = (uint64_t)(((uint64_t)(0x02 | (1 << 2))) << ((ctx->byteIndex) * 8));
     }
 
-    ctx->u.s[ctx->wordIndex] ^= ctx->saved ^ t;
+    keccak_xor_lane(ctx, ctx->wordIndex, ctx->saved ^ t);
 
     /* Prepare for the final round */
-    ctx->u.s[SHA3_KECCAK_SPONGE_WORDS - SHA3_CW(ctx->capacityWords) - 1] ^=
-        SHA3_CONST(0x8000000000000000UL);
+    keccak_xor_lane(ctx,
+                    SHA3_KECCAK_SPONGE_WORDS - SHA3_CW(ctx->capacityWords) - 1,
+                    SHA3_CONST(0x8000000000000000UL));
   } else if (round <= KECCAK_ROUNDS) {
     /* Perform KECCAK_ROUNDS of keccakf */
     keccakf_split(ctx->u.s, round - 1);
   } else { /* round = KECCAK_ROUNDS + 1 */
     /* Convert the context state to bytes after the final round */
-    for (unsigned i = 0; i < SHA3_KECCAK_SPONGE_WORDS; i++) {
-      const unsigned t1 = (uint32_t)ctx->u.s[i];
-      const unsigned t2 = (uint32_t)((ctx->u.s[i] >> 16) >> 16);
-      ctx->u.sb[i * 8 + 0] = (uint8_t)(t1);
-      ctx->u.sb[i * 8 + 1] = (uint8_t)(t1 >> 8);
-      ctx->u.sb[i * 8 + 2] = (uint8_t)(t1 >> 16);
-      ctx->u.sb[i * 8 + 3] = (uint8_t)(t1 >> 24);
-      ctx->u.sb[i * 8 + 4] = (uint8_t)(t2);
-      ctx->u.sb[i * 8 + 5] = (uint8_t)(t2 >> 8);
-      ctx->u.sb[i * 8 + 6] = (uint8_t)(t2 >> 16);
-      ctx->u.sb[i * 8 + 7] = (uint8_t)(t2 >> 24);
-    }
+    keccak_squeeze(ctx);
   }
 
   return (round == KECCAK_ROUNDS + 1) ? ctx->u.sb : nullptr;
@@ -382,10 +572,11 @@ void const *sha3_Finalize(void *priv) {
     t = (uint64_t)(((uint64_t)(0x02 | (1 << 2))) << ((ctx->byteIndex) * 8));
   }
 
-  ctx->u.s[ctx->wordIndex] ^= ctx->saved ^ t;
+  keccak_xor_lane(ctx, ctx->wordIndex, ctx->saved ^ t);
 
-  ctx->u.s[SHA3_KECCAK_SPONGE_WORDS - SHA3_CW(ctx->capacityWords) - 1] ^=
-      SHA3_CONST(0x8000000000000000UL);
+  keccak_xor_lane(ctx,
+                  SHA3_KECCAK_SPONGE_WORDS - SHA3_CW(ctx->capacityWords) - 1,
+                  SHA3_CONST(0x8000000000000000UL));
   keccakf(ctx->u.s);
 
   /* Return first bytes of the ctx->s. This conversion is not needed for
@@ -394,21 +585,7 @@ void const *sha3_Finalize(void *priv) {
    * __BYTE_ORDER__!=__ORDER_LITTLE_ENDIAN__
    *    ... the conversion below ...
    * #endif */
-  {
-    unsigned i;
-    for (i = 0; i < SHA3_KECCAK_SPONGE_WORDS; i++) {
-      const unsigned t1 = (uint32_t)ctx->u.s[i];
-      const unsigned t2 = (uint32_t)((ctx->u.s[i] >> 16) >> 16);
-      ctx->u.sb[i * 8 + 0] = (uint8_t)(t1);
-      ctx->u.sb[i * 8 + 1] = (uint8_t)(t1 >> 8);
-      ctx->u.sb[i * 8 + 2] = (uint8_t)(t1 >> 16);
-      ctx->u.sb[i * 8 + 3] = (uint8_t)(t1 >> 24);
-      ctx->u.sb[i * 8 + 4] = (uint8_t)(t2);
-      ctx->u.sb[i * 8 + 5] = (uint8_t)(t2 >> 8);
-      ctx->u.sb[i * 8 + 6] = (uint8_t)(t2 >> 16);
-      ctx->u.sb[i * 8 + 7] = (uint8_t)(t2 >> 24);
-    }
-  }
+  keccak_squeeze(ctx);
 
   SHA3_TRACE_BUF("Hash: (first 32 bytes)", ctx->u.sb, 256 / 8);
 
@@ -26,6 +26,15 @@
  * Aug 2015. Andrey Jivsov. crypto@brainhub.org
  * ---------------------------------------------------------------------- */
 
+// Keep the state bit-interleaved: each 64-bit lane is stored as two 32-bit
+// words, one with the even bits and one with the odd bits. The 64-bit
+// rotations of Keccak-f then become 32-bit rotations, which is much cheaper on
+// a 32-bit core. Input and output are converted on absorb and squeeze, so the
+// sha3_* results don't change. Set to 0 for the plain 64-bit lanes.
+#ifndef KECCAK_INTERLEAVED
+#define KECCAK_INTERLEAVED 1
+#endif
+
 /* 'Words' here refers to uint64_t */
 #define SHA3_KECCAK_SPONGE_WORDS \
   (((1600) / 8 /*bits to byte*/) / sizeof(uint64_t))
@@ -35,6 +44,9 @@ typedef struct sha3_context_ {
   union {         /* Keccak's state */
     uint64_t s[SHA3_KECCAK_SPONGE_WORDS];
     uint8_t sb[SHA3_KECCAK_SPONGE_WORDS * 8];
+    // Lane i is w[2 * i] (even bits) and w[2 * i + 1] (odd bits) when
+    // KECCAK_INTERLEAVED.
+    uint32_t w[SHA3_KECCAK_SPONGE_WORDS * 2];
   } u;
   unsigned byteIndex;     /* 0..7--the next byte after the set one
                            * (starts from 0; 0--none are buffered) */
@@ -52,7 +64,8 @@ typedef enum SHA3_RETURN sha3_return_t;
 /* For Init or Reset call these: */
 sha3_return_t sha3_Init(void *priv, unsigned bitSize);
 
-// Takes 16ms on STM32@12MHz, should be split.
+// s is the state in the layout selected by KECCAK_INTERLEAVED.
+// Takes 16ms on STM32@12MHz with 64-bit lanes, should be split.
 void keccakf(uint64_t s[25]);
 // Takes 0.7ms on STM32@12MHz, should only be called once per task.
 // round should be sequentially called with [0, KECCAK_ROUNDS-1], for a total of
@@ -73,6 +86,19 @@ void sha3_UpdateWord(void *priv, void const *bufIn);
 // For round=1 to KECCAK_ROUNDS, it should call keccakf(round-1)
 int sha3_UpdateWord_split(void *priv, void const *bufIn, int round);
 
+// Absorbs a rate-sized block at a time, for callers that want to split the
+// work by permutation round rather than by word. Returns the next round to be
+// called, like sha3_UpdateWord_split().
+// For round=0, XOR as many whole words from bufIn (len bytes available) into
+// the state as fit in the current block, and set *absorbed to the number of
+// bytes taken. Returns 1 if that filled the block, 0 if bufIn has less than a
+// word left.
+// For round=1 to KECCAK_ROUNDS, it should call keccakf(round-1), bufIn, len and
+// absorbed are unused.
+// No partial word may be buffered, see sha3_UpdateFinalWord().
+int sha3_UpdateBlock_split(void *priv, void const *bufIn, size_t len,
+                           size_t *absorbed, int round);
+
 // Called for updating the final few bytes that's shorter than a word.
 void sha3_UpdateFinalWord(void *priv, void const *bufIn, size_t len);
 
@@ -270,6 +270,63 @@ int main() {
     return 1;
   }
 
+  /* SHA3-256 through the _split API, the way HashService drives it. */
+  sha3_Init256(&c);
+  for (i = 0; i < sizeof(buf); i += 8) {
+    int round = 0;
+    do {
+      round = sha3_UpdateWord_split(&c, buf + i, round);
+    } while (round != 0);
+  }
+  for (i = 0; i < KECCAK_ROUNDS + 2; i++) {
+    hash = sha3_Finalize_split(&c, i);
+  }
+  if (memcmp(sha3_256_0xa3_200_times, hash, sizeof(sha3_256_0xa3_200_times)) !=
+      0) {
+    printf(
+        "SHA3-256( 0xa3 ... [200 times] ) "
+        "doesn't match known answer (split)\n");
+    return 21;
+  }
+
+  /* SHA3-256 a block per call through the _split API, the way HashService
+   * drives it now. Both 200 bytes and an unaligned 141 bytes, which leaves a
+   * block boundary and a tail shorter than a word. */
+  for (int pass = 0; pass < 2; pass++) {
+    const uint8_t *msg = pass == 0 ? buf : buf + 1;
+    size_t len = pass == 0 ? sizeof(buf) : 141;
+    size_t done = 0, absorbed;
+    uint8_t expect[32];
+
+    if (pass == 0) {
+      memcpy(expect, sha3_256_0xa3_200_times, sizeof(expect));
+    } else {
+      sha3_Init256(&c);
+      sha3_Update(&c, msg, len);
+      memcpy(expect, sha3_Finalize(&c), sizeof(expect));
+    }
+
+    sha3_Init256(&c);
+    while (true) {
+      int round = sha3_UpdateBlock_split(&c, msg + done, len - done, &absorbed,
+                                         0);
+      done += absorbed;
+      if (round == 0) break;
+      while (round != 0) {
+        round = sha3_UpdateBlock_split(&c, nullptr, 0, nullptr, round);
+      }
+    }
+    sha3_UpdateFinalWord(&c, msg + done, len - done);
+    for (i = 0; i < KECCAK_ROUNDS + 2; i++) {
+      hash = sha3_Finalize_split(&c, i);
+    }
+    if (memcmp(expect, hash, sizeof(expect)) != 0) {
+      printf("SHA3-256( %u bytes ) doesn't match (block split)\n",
+             (unsigned)len);
+      return 22;
+    }
+  }
+
   /* SHA3-256 in two steps. [FIPS 202] */
   sha3_Init256(&c);
   sha3_Update(&c, buf, sizeof(buf) / 2);
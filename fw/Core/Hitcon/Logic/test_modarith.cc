@@ -0,0 +1,92 @@
+#ifdef HITCON_TEST_MODE
+
+// Checks the Montgomery multiplication in ModArith.h against the
+// double-and-add modmul_shiftadd() it replaced.
+// Built and run by `make test` in Host/.
+
+#include <Logic/ModArith.h>
+#include <Logic/pcg32.h>
+#include <stdio.h>
+
+using namespace hitcon::ecc::internal;
+
+namespace {
+
+// The curve's field prime and order, and a few other odd moduli up to 2^62.
+const uint64_t kModuli[] = {0xbcffb098340493, 0xbcffb09c43733d,
+                            0x3,              0xffffffff,
+                            0x100000001,      0x3fffffffffffffff};
+
+int CheckModulus(uint64_t m, PCG32 &rng) {
+  const MontParams p = MakeMontParams(m);
+  // Both curve moduli are.
+  const bool prime = m == kModuli[0] || m == kModuli[1];
+  if (static_cast<uint32_t>(m) * p.mInv != 0xffffffff) {
+    printf("mInv wrong for m = %#llx\n", (unsigned long long)m);
+    return 1;
+  }
+
+  const uint64_t edges[] = {0, 1, 2, m - 1, m - 2, m >> 1};
+  for (int i = 0; i < 20000; i++) {
+    uint64_t a = static_cast<uint64_t>(rng.GetRandom()) << 32 | rng.GetRandom();
+    uint64_t b = static_cast<uint64_t>(rng.GetRandom()) << 32 | rng.GetRandom();
+    if (i < 36) {
+      a = edges[i % 6];
+      b = edges[i / 6];
+    } else if (i < 40) {
+      // a doesn't have to be reduced.
+      a = UINT64_MAX - i;
+    } else {
+      a %= m;
+    }
+    b %= m;
+
+    const uint64_t expect = modmul_shiftadd(a, b, m);
+    if (modmul_mont(a, b, p) != expect) {
+      printf("%#llx * %#llx mod %#llx: %#llx, should be %#llx\n",
+             (unsigned long long)a, (unsigned long long)b,
+             (unsigned long long)m,
+             (unsigned long long)modmul_mont(a, b, p),
+             (unsigned long long)expect);
+      return 2;
+    }
+    if (prime && i < 200 && b != 0) {
+      if (modmul_mont(b, modinv_prime(b, p), p) != 1) {
+        printf("1 / %#llx mod %#llx is off\n", (unsigned long long)b,
+               (unsigned long long)m);
+        return 4;
+      }
+    }
+    // Multiplying in Montgomery form and converting back gives the same.
+    const uint64_t am = tomont(a, p), bm = tomont(b, p);
+    if (am >= m || frommont(am, p) != a % m ||
+        frommont(montmul(am, bm, p), p) != expect) {
+      printf("Montgomery form of %#llx * %#llx mod %#llx is off\n",
+             (unsigned long long)a, (unsigned long long)b,
+             (unsigned long long)m);
+      return 3;
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+int main() {
+  PCG32 rng(0x5eed);
+  for (uint64_t m : kModuli) {
+    int ret = CheckModulus(m, rng);
+    if (ret) return ret;
+  }
+  // It's evaluated at compile time for the curve.
+  static_assert(montmul(tomont(3, MakeMontParams(0xbcffb098340493)),
+                        tomont(5, MakeMontParams(0xbcffb098340493)),
+                        MakeMontParams(0xbcffb098340493)) ==
+                    tomont(15, MakeMontParams(0xbcffb098340493)),
+                "constexpr montmul");
+  printf("Montgomery modmul matches shift-and-add for %u moduli\n",
+         (unsigned)(sizeof(kModuli) / sizeof(kModuli[0])));
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
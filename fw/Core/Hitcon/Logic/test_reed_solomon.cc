@@ -0,0 +1,95 @@
+#ifdef HITCON_TEST_MODE
+
+// Checks that RsDecode() in ReedSolomon.cc corrects every mix of errors and
+// erasures within 2e + f <= IR_FEC_PARITY, for the codeword lengths IR packets
+// use, and that it leaves the codeword alone whenever it gives up.
+// Built and run by `make test` in Host/.
+
+#include <Logic/ReedSolomon.h>
+#include <Logic/pcg32.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace hitcon::ir;
+
+namespace {
+
+constexpr unsigned kIters = 20000;
+// The size byte, data and checksum of the longest IR packet, and parity.
+constexpr size_t kMaxLen = MAX_PACKET_PAYLOAD_BYTES - 1 + IR_FEC_PARITY;
+
+// Pick count distinct positions below len.
+void PickPositions(PCG32 &rng, size_t len, uint8_t *pos, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    bool dup;
+    do {
+      pos[i] = rng.GetRandom() % len;
+      dup = false;
+      for (size_t j = 0; j < i; j++) dup |= pos[j] == pos[i];
+    } while (dup);
+  }
+}
+
+}  // namespace
+
+int main() {
+  PCG32 rng(0xfec);
+  unsigned corrected = 0, refused = 0, miscorrected = 0;
+  for (unsigned n = 0; n < kIters; n++) {
+    const size_t len = IR_FEC_PARITY + 2 +
+                       rng.GetRandom() % (kMaxLen - IR_FEC_PARITY - 1);
+    uint8_t sent[kMaxLen];
+    for (size_t i = 0; i < len - IR_FEC_PARITY; i++) sent[i] = rng.GetRandom();
+    RsEncode(sent, len - IR_FEC_PARITY, sent + len - IR_FEC_PARITY);
+
+    // Up to the limit most of the time, one error past it otherwise.
+    const bool over = n % 4 == 3;
+    const size_t erasure_count = rng.GetRandom() % (IR_FEC_PARITY + 1);
+    size_t error_count = (IR_FEC_PARITY - erasure_count) / 2;
+    if (over) {
+      error_count++;
+    } else {
+      error_count = rng.GetRandom() % (error_count + 1);
+    }
+    uint8_t pos[2 * IR_FEC_PARITY];
+    PickPositions(rng, len, pos, erasure_count + error_count);
+    uint8_t got[kMaxLen];
+    memcpy(got, sent, len);
+    for (size_t i = 0; i < erasure_count + error_count; i++) {
+      // An erased byte may well have come out right.
+      const uint8_t flip = rng.GetRandom();
+      got[pos[i]] ^= i < erasure_count ? flip : flip | 1;
+    }
+
+    uint8_t before[kMaxLen];
+    memcpy(before, got, len);
+    if (!RsDecode(got, len, pos, erasure_count)) {
+      if (memcmp(got, before, len) != 0) {
+        printf("RsDecode() gave up but changed the codeword\n");
+        return 1;
+      }
+      if (!over) {
+        printf("RsDecode() gave up on %zu errors %zu erasures in %zu bytes\n",
+               error_count, erasure_count, len);
+        return 1;
+      }
+      refused++;
+    } else if (memcmp(got, sent, len) != 0) {
+      if (!over) {
+        printf("RsDecode() got %zu errors %zu erasures in %zu bytes wrong\n",
+               error_count, erasure_count, len);
+        return 1;
+      }
+      // Past the limit a closer codeword is fair game, the CRC catches it.
+      miscorrected++;
+    } else {
+      corrected++;
+    }
+  }
+  printf("ReedSolomon %u codewords: %u corrected, past the limit %u refused "
+         "%u miscorrected\n",
+         kIters, corrected, refused, miscorrected);
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
@@ -31,6 +31,9 @@ DisplayService::DisplayService()
  * 5. if the Task hasn't been executed, then run the second buffer
  */
 
+// TIM1 update rate, each update moves one word to GPIOB.
+constexpr unsigned kDmaRateHz = 1600;
+
 request_cb_param tmp_request_cb_param;
 void DisplayTransferHalfComplete(DMA_HandleTypeDef* hdma) {
   if (!g_suspender.IsSuspended()) {
@@ -51,6 +54,10 @@ void DisplayTransferComplete(DMA_HandleTypeDef* hdma) {
 }
 
 void DisplayService::Init() {
+  // The next frames have to be in before the dma wraps to the half it just
+  // finished.
+  task.SetDeadline(DISPLAY_FRAME_SIZE * DISPLAY_FRAME_BATCH * 1000000ULL /
+                   kDmaRateHz);
   tmp_request_cb_param.callback = request_frame_callback_arg1;
   tmp_request_cb_param.buf_index = 0;
   scheduler.Queue(&task, &tmp_request_cb_param);
@@ -28,7 +28,8 @@ void HashStatus::NewState(enum state state) {
 }
 
 ServiceContext::ServiceContext()
-    : message(nullptr), len(0), callback(nullptr), callbackArg1(nullptr) {}
+    : message(nullptr), len(0), callback(nullptr), callbackArg1(nullptr),
+      submitTime(0) {}
 
 void ServiceContext::Init(uint8_t const *message, size_t len,
                           callback_t callback, void *callbackArg1) {
@@ -36,6 +37,7 @@ void ServiceContext::Init(uint8_t const *message, size_t len,
   this->len = len;
   this->callback = callback;
   this->callbackArg1 = callbackArg1;
+  submitTime = SysTimer::GetTime();
 }
 
 }  // namespace internal
@@ -44,51 +46,65 @@ void HashService::Init() { scheduler.Queue(&hashTask, nullptr); }
 
 bool HashService::StartHash(uint8_t const *message, size_t len,
                             callback_t callback, void *callbackArg1) {
-  if (hashTask.IsEnabled()) return false;
-  scheduler.EnablePeriodic(&hashTask);
+  ServiceContext request;
+  request.Init(message, len, callback, callbackArg1);
+  if (!hashTask.IsEnabled()) {
+    scheduler.EnablePeriodic(&hashTask);
+    startRequest(request);
+    return true;
+  }
+  // Busy, doHashDone() picks it up once everything before it is done.
+  if (!queue.PushBack(request)) {
+    stats.rejected++;
+    return false;
+  }
+  if (queue.Size() > stats.maxDepth) stats.maxDepth = queue.Size();
+  return true;
+}
+
+void HashService::startRequest(const ServiceContext &request) {
+  serviceContext = request;
+  uint32_t wait = SysTimer::GetTime() - request.submitTime;
+  stats.totalWait += wait;
+  if (wait > stats.maxWait) stats.maxWait = wait;
   status.Init();
-  serviceContext.Init(message, len, callback, callbackArg1);
   sha3_Init(&sha3Context, SHA3_BIT_SIZE);
-  return true;
 }
 
 void HashService::doHash(void *unused) {
-  switch (status.state) {
-    case status.kUpdateState:
-      doHashUpdate();
-      break;
-    case status.kFinalizeState:
-      doHashFinalize();
-      break;
-    case status.kDoneState:
-      doHashDone();
-      break;
-  }
+  // Keep stepping until the hash is done or the scheduler needs the CPU back.
+  do {
+    switch (status.state) {
+      case status.kUpdateState:
+        doHashUpdate();
+        break;
+      case status.kFinalizeState:
+        doHashFinalize();
+        break;
+    }
+  } while (hashTask.IsEnabled() && scheduler.RemainingBudget());
 }
 
+// Each step either absorbs up to a whole block or runs one permutation round.
 void HashService::doHashUpdate() {
-  size_t i;
-  uint64_t word;
-  // TODO: the performance of UpdateWord can be optimized.
-  // sha3_UpdateWord_split often does a "fast return", so we can analyze how
-  // much each "fast return" takes, and do multiple of them each round.
-  if (status.progress + 8 > serviceContext.len) {
-    // final block, needs padding
+  if (status.round != 0) {
+    status.round = sha3_UpdateBlock_split(&sha3Context, nullptr, 0, nullptr,
+                                          status.round);
+    return;
+  }
+
+  size_t absorbed;
+  status.round = sha3_UpdateBlock_split(
+      &sha3Context, serviceContext.message + status.progress,
+      serviceContext.len - status.progress, &absorbed, 0);
+  status.progress += absorbed;
+  if (status.round == 0) {
+    // Less than a word left, it goes in along with the padding.
     sha3_UpdateFinalWord(&sha3Context, serviceContext.message + status.progress,
                          serviceContext.len - status.progress);
+    sha3_Finalize_split(&sha3Context, 0);
     status.NewState(status.kFinalizeState);
-  } else {
-    // just do this block without padding
-    status.round = sha3_UpdateWord_split(
-        &sha3Context, serviceContext.message + status.progress, status.round);
-
-    if (status.round == 0) {
-      status.progress += 8;
-    }
-
-    if (status.progress >= serviceContext.len) {
-      status.NewState(status.kFinalizeState);
-    }
+    status.round = 1;
   }
 }
 
@@ -97,17 +113,25 @@ void HashService::doHashFinalize() {
   if (++status.round == KECCAK_ROUNDS + 2) {
     result.digest = digest;
     result.size = SHA3_BIT_SIZE / 8;
-    status.NewState(status.kDoneState);
+    doHashDone();
   }
 }
 
 void HashService::doHashDone() {
+  stats.completed++;
   serviceContext.callback(serviceContext.callbackArg1, &result);
-  scheduler.DisablePeriodic(&hashTask);
+  // The callback may have queued another request, so check afterwards.
+  if (queue.IsEmpty()) {
+    scheduler.DisablePeriodic(&hashTask);
+    return;
+  }
+  startRequest(queue.Front());
+  queue.PopFront();
 }
 
 HashService::HashService()
-    : hashTask(880, (task_callback_t)&HashService::doHash, (void *)this, 0) {}
+    : hashTask(880, (task_callback_t)&HashService::doHash, (void *)this, 0),
+      stats{} {}
 
 }  // namespace hash
 
@@ -3,6 +3,7 @@
 
 #include <Logic/keccak.h>
 #include <Service/Sched/Scheduler.h>
+#include <Util/CircularQueue.h>
 #include <Util/callback.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -13,12 +14,15 @@ namespace hash {
 
 constexpr size_t SHA3_BIT_SIZE = 256;
 
+// How many StartHash() requests can wait behind the one being hashed.
+constexpr size_t kHashQueueSize = 4;
+
 namespace internal {
 
 struct HashStatus {
   size_t progress;
   int round;
-  enum state { kUpdateState, kFinalizeState, kDoneState } state;
+  enum state { kUpdateState, kFinalizeState } state;
 
   HashStatus();
   void Init();
@@ -31,6 +35,9 @@ struct ServiceContext {
   callback_t callback;
   void *callbackArg1;
 
+  // SysTimer::GetTime() when StartHash() accepted the request.
+  unsigned submitTime;
+
   ServiceContext();
   void Init(uint8_t const *message, size_t len, callback_t callback,
             void *callbackArg1);
@@ -43,13 +50,27 @@ struct HashResult {
   size_t size;
 };
 
+// Request queue statistics, times are in SysTimer units (ms).
+struct HashQueueStats {
+  uint32_t completed;
+  // StartHash() calls turned down because the queue was full.
+  uint32_t rejected;
+  // Requests waiting behind the one being hashed, at most kHashQueueSize.
+  uint32_t maxDepth;
+  // From StartHash() until hashing the request begins.
+  uint32_t totalWait;
+  uint32_t maxWait;
+};
+
 class HashService {
  public:
   void Init();
 
   // Call StartHash() to hash the message of size len.
-  // Return false if HashService is busy and cannot take this request. In that
-  // case the caller should retry later.
+  // Requests are hashed one after another in the order they're accepted, up
+  // to kHashQueueSize of them can wait behind the one being hashed.
+  // Return false if the queue is full and HashService cannot take this
+  // request. In that case the caller should retry later.
   // Return true if HashService has accepted this request, in that case the
   // callback will be called once the hashing is done. The argument to the
   // callback will be a uint8_t pointer to the hash result, it'll only be valid
@@ -59,17 +80,26 @@ class HashService {
   bool StartHash(uint8_t const *message, size_t len, callback_t callback,
                  void *callbackArg1);
 
+  // Requests waiting behind the one being hashed.
+  size_t GetQueueDepth() { return queue.Size(); }
+  const HashQueueStats &GetQueueStats() { return stats; }
+
   HashService();
 
  private:
   service::sched::PeriodicTask hashTask;
 
+  // The request being hashed.
   internal::ServiceContext serviceContext;
+  // One extra slot, CircularQueue keeps one empty.
+  CircularQueue<internal::ServiceContext, kHashQueueSize + 1> queue;
+  HashQueueStats stats;
   internal::HashStatus status;
   sha3_context sha3Context;
   HashResult result;
 
   void doHash(void *unused);
+  void startRequest(const internal::ServiceContext &request);
 
   void doHashUpdate();
   void doHashFinalize();
@@ -25,11 +25,15 @@ constexpr size_t IR_SERVICE_TX_SIZE = 128;
 // interrupt (half/full).
 constexpr size_t IR_SERVICE_RX_SIZE = 64;
 constexpr int16_t IR_PWM_TIM_CCR = 16;
+// TIM3 paces the tx dma, TIM2 samples rx at a quarter of its rate.
+constexpr unsigned IR_SERVICE_TX_RATE_HZ = 38000;
+constexpr unsigned IR_SERVICE_RX_RATE_HZ = IR_SERVICE_TX_RATE_HZ / 4;
 
 constexpr size_t IR_SERVICE_RX_ON_BUFFER_SIZE = 32;
 
-// How many rx buffer is processed per task run in IrLogic?
-constexpr size_t IR_SERVICE_RX_BUFFER_PER_RUN = 4;
+// How many rx buffer is processed per task run in IrLogic? It decodes a byte
+// at a time, so a whole buffer fits in one run.
+constexpr size_t IR_SERVICE_RX_BUFFER_PER_RUN = IR_SERVICE_RX_ON_BUFFER_SIZE;
 static_assert(IR_SERVICE_RX_ON_BUFFER_SIZE % IR_SERVICE_RX_BUFFER_PER_RUN == 0);
 
 // Two elements represents a data bit, see PULSE_PER_HEADER_BIT.
@@ -46,22 +50,95 @@ constexpr size_t IR_PACKET_HEADER_PACKED = 0b111'111'00000'00000'111'111;
 constexpr size_t IR_PACKET_HEADER_MASK = 0b111'110'01111'11110'011'110;
 constexpr size_t IR_CHKSUM_SZ = 8;
 
+// A size byte with IR_FEC_FLAG set is followed by IR_FEC_PARITY Reed-Solomon
+// parity bytes after the checksum, over the size byte, data and checksum. The
+// size without the flag is still below MAX_PACKET_PAYLOAD_BYTES, so receivers
+// without FEC drop these packets as too large.
+constexpr uint8_t IR_FEC_FLAG = 0x80;
+constexpr size_t IR_FEC_PARITY = 4;
+static_assert(MAX_PACKET_PAYLOAD_BYTES <= IR_FEC_FLAG);
+
 constexpr size_t PULSE_PER_DATA_BIT = 16;
 constexpr size_t PULSE_PER_HEADER_BIT = PULSE_PER_DATA_BIT / 2;
+static_assert(PULSE_PER_DATA_BIT ==
+              DECODE_SAMPLE_RATIO * IR_SERVICE_TX_RATE_HZ /
+                  IR_SERVICE_RX_RATE_HZ);
+
+// The fast profile for close range, twice the bit rate: a data bit is a header
+// element long, and decoded from 2 samples that have to agree. Packets start
+// with IR_PACKET_HEADER_FAST instead, which receivers without it never match.
+constexpr size_t PULSE_PER_DATA_BIT_FAST = PULSE_PER_HEADER_BIT;
+constexpr size_t DECODE_SAMPLE_RATIO_FAST = 2;
+constexpr size_t DECODE_SAMPLE_RATIO_THRESHOLD_FAST = 2;
+static_assert(PULSE_PER_DATA_BIT_FAST ==
+              DECODE_SAMPLE_RATIO_FAST * IR_SERVICE_TX_RATE_HZ /
+                  IR_SERVICE_RX_RATE_HZ);
+
+constexpr uint8_t IR_PACKET_HEADER_FAST[] = {
+    0, 0, 0, 0,
+    0, 0, 0,  // Pad to boundary.
+    1, 1, 1,  // 3x bit time of 1.
+    0, 0, 0,  // 3x bit time of 0.
+    1, 1, 1   // 3x bit time of 1.
+};
+// 3 3 3 times 2(decode ratio)
+constexpr size_t IR_PACKET_HEADER_FAST_PACKED = 0b111'111'000'000'111'111;
+// Edges are don't care, the normal header's gap is too long for it.
+constexpr size_t IR_PACKET_HEADER_FAST_MASK = 0b111'110'011'110'011'110;
+static_assert(sizeof(IR_PACKET_HEADER_FAST) == sizeof(IR_PACKET_HEADER));
+
+// The fast profile is only sent while this badge hears the others well: the
+// load factor is at most IR_FAST_MAX_LOADFACTOR, and of the recent packets that
+// got past the size byte, at least IR_FAST_MIN_GOOD passed the checksum and at
+// most one per IR_FAST_BAD_RATIO of those failed it. The counts are halved once
+// they add up to IR_LINK_STATS_WINDOW. Unless IrLogic::SetTxFast(), one of the
+// good ones has to have the fast profile as well, so a badge only sends it
+// while a base station near it does.
+constexpr int IR_FAST_MAX_LOADFACTOR = 80;
+constexpr size_t IR_FAST_MIN_GOOD = 4;
+constexpr size_t IR_FAST_BAD_RATIO = 8;
+constexpr size_t IR_LINK_STATS_WINDOW = 32;
 
 // Number of elements in IR_PACKET_HEADER.
 constexpr size_t IR_PACKET_HEADER_SIZE =
     sizeof(IR_PACKET_HEADER) / sizeof(IR_PACKET_HEADER[0]);
-// How many elements of IR_PACKET_HEADER do we send out per DMA population run?
-constexpr size_t IR_PACKET_PER_RUN = (IR_SERVICE_TX_SIZE) / 8;
-constexpr size_t IR_PACKET_RUN_COUNT =
-    IR_PACKET_HEADER_SIZE / IR_PACKET_PER_RUN;
-
-static_assert((IR_SERVICE_TX_SIZE) % 8 == 0);
-static_assert((IR_PACKET_HEADER_SIZE * 8) % (IR_SERVICE_TX_SIZE) == 0);
 
-constexpr size_t IR_BITS_PER_TX_RUN = (IR_SERVICE_TX_SIZE) / PULSE_PER_DATA_BIT;
-static_assert((IR_SERVICE_TX_SIZE / 2) % PULSE_PER_DATA_BIT == 0);
+// IrService::SendBuffer() expands the header and data into runs of pulses of
+// the same level, counted in units of PULSE_PER_HEADER_BIT pulses (a header
+// element, or half a data bit).
+constexpr size_t IR_TX_UNITS_PER_DATA_BIT =
+    PULSE_PER_DATA_BIT / PULSE_PER_HEADER_BIT;
+constexpr size_t IR_TX_UNITS_PER_DATA_BIT_FAST =
+    PULSE_PER_DATA_BIT_FAST / PULSE_PER_HEADER_BIT;
+// How many units do we send out per DMA population run?
+constexpr size_t IR_TX_UNITS_PER_RUN =
+    IR_SERVICE_TX_SIZE / PULSE_PER_HEADER_BIT;
+// The tx dma buffer is filled a word (two CCR values) at a time.
+constexpr size_t IR_TX_WORDS_PER_UNIT = PULSE_PER_HEADER_BIT / 2;
+// Longest buffer SendBuffer() takes, a packet with its size, checksum and FEC
+// parity.
+constexpr size_t IR_TX_MAX_BYTES = MAX_PACKET_PAYLOAD_BYTES + IR_FEC_PARITY;
+// Runs are uint8_t and get split past 255 units, still that's at most one per
+// header element and data bit, plus an empty one if the first is on.
+constexpr size_t IR_TX_MAX_RUNS =
+    1 + IR_PACKET_HEADER_SIZE + 8 * IR_TX_MAX_BYTES;
+
+static_assert(PULSE_PER_HEADER_BIT % 2 == 0);
+// The header and each byte take whole population runs, fast bytes half of one.
+static_assert(IR_PACKET_HEADER_SIZE % IR_TX_UNITS_PER_RUN == 0);
+static_assert((8 * IR_TX_UNITS_PER_DATA_BIT) % IR_TX_UNITS_PER_RUN == 0);
+
+// IrService::Routine() runs this often, in ms.
+constexpr unsigned IR_SERVICE_ROUTINE_MS = 22;
+// Before sending, rx has to be quiet for IR_TX_QUIET_MIN rx bytes, plus a
+// random 0 to IR_TX_QUIET_SPREAD - 1 more picked by every Routine().
+constexpr size_t IR_TX_QUIET_MIN = 20;
+constexpr size_t IR_TX_QUIET_SPREAD = 32;
+// After a collision, every Routine() ends the wait with the number of
+// Routine() runs so far against IR_COLLISION_WAIT_MIN plus a random 0 to
+// IR_COLLISION_WAIT_SPREAD - 1.
+constexpr size_t IR_COLLISION_WAIT_MIN = 32;
+constexpr size_t IR_COLLISION_WAIT_SPREAD = 64;
 
 constexpr size_t IR_BYTE_PER_RUN = IR_SERVICE_RX_SIZE / 8;
 // An integer number of run is needed to fulfill the OnBufferRecv().
@@ -21,12 +21,14 @@ IrService::IrService()
     : dma_tx_populate_task(
           100, (task_callback_t)&IrService::PopulateTxDmaBuffer, this),
       dma_rx_pull_task(150, (task_callback_t)&IrService::PullRxDmaBuffer, this),
-      routine_task(600, (callback_t)&IrService::Routine, this, 22),
+      routine_task(600, (callback_t)&IrService::Routine, this,
+                   IR_SERVICE_ROUTINE_MS),
       on_rx_callback_runner(500, (callback_t)&IrService::OnBufferRecvWrapper,
                             this),
-      rx_buffer_base(0), rx_on_buffer_callback_finished(true), rx_quiet_cnt(0),
-      rx_required_quiet_period(500), rx_ctr_since_release(100000),
-      tx_packet_cnt(0) {}
+      rx_buffer_base(0), tx_run_count(0), tx_run(0), tx_run_left(0),
+      tx_dirty_halves(0), rx_on_buffer_callback_finished(true),
+      rx_quiet_cnt(0), rx_required_quiet_period(500),
+      rx_ctr_since_release(100000), tx_packet_cnt(0) {}
 
 void ReceiveDmaHalfCplt(DMA_HandleTypeDef *hdma) {
   if (!g_suspender.IsSuspended()) {
@@ -110,6 +112,13 @@ void IrService::OnBufferRecvWrapper(void *arg2) {
 }
 
 void IrService::Init() {
+  // A half buffer has to be refilled or drained before the dma wraps back to
+  // it.
+  dma_tx_populate_task.SetDeadline(IR_SERVICE_TX_SIZE * 1000000ULL /
+                                   IR_SERVICE_TX_RATE_HZ);
+  dma_rx_pull_task.SetDeadline(IR_SERVICE_RX_SIZE * 1000000ULL /
+                               IR_SERVICE_RX_RATE_HZ);
+
   hdma_tim2_ch3.XferHalfCpltCallback = &ReceiveDmaHalfCplt;
   hdma_tim2_ch3.XferCpltCallback = &ReceiveDmaCplt;
 
@@ -132,15 +141,30 @@ void IrService::Init() {
 
 bool IrService::CanSendBufferNow() { return tx_state == 0x00000000; }
 
-bool IrService::SendBuffer(const uint8_t *data, size_t len, bool send_header) {
+bool IrService::SendBuffer(const uint8_t *data, size_t len, bool send_header,
+                           bool fast) {
   if (tx_state != 0x00000000) {
     // Can't send buffer now, we're handling another buffer.
     return false;
   }
 
-  tx_pending_buffer = data;
-  tx_pending_buffer_len = len;
-  tx_pending_send_header = send_header;
+  if (len > IR_TX_MAX_BYTES) {
+    // Doesn't fit tx_runs.
+    return false;
+  }
+
+  // Expand it here once, so the refill only copies runs out.
+  tx_run_count = 0;
+  if (send_header) {
+    for (uint8_t element : fast ? IR_PACKET_HEADER_FAST : IR_PACKET_HEADER) {
+      AppendTxRun(element, 1);
+    }
+  }
+  const uint8_t units =
+      fast ? IR_TX_UNITS_PER_DATA_BIT_FAST : IR_TX_UNITS_PER_DATA_BIT;
+  for (size_t i = 0; i < len * 8; i++) {
+    AppendTxRun((data[i / 8] >> (i % 8)) & 0x01, units);
+  }
 
   g_suspender.IncBlocker();
   tx_state = 0x01000000;
@@ -153,63 +177,82 @@ void IrService::SetOnBufferReceived(callback_t callback, void *callback_arg1) {
   on_rx_buffer_arg = callback_arg1;
 }
 
+void IrService::AppendTxRun(bool on, uint8_t units) {
+  // Run i is on for odd i.
+  if (tx_run_count && ((tx_run_count - 1) & 1) == on &&
+      tx_runs[tx_run_count - 1] <= UINT8_MAX - units) {
+    tx_runs[tx_run_count - 1] += units;
+    return;
+  }
+  // An empty run of the other level goes in between if the last one is full,
+  // or if the first one is on.
+  if ((tx_run_count & 1) != on) tx_runs[tx_run_count++] = 0;
+  tx_runs[tx_run_count++] = units;
+}
+
+// Two CCR3 values of a pulse on.
+constexpr uint32_t IR_TX_ON_WORD =
+    static_cast<uint16_t>(IR_PWM_TIM_CCR) * 0x00010001U;
+
 void IrService::PopulateTxDmaBuffer(void *ptr_side) {
   int side = reinterpret_cast<intptr_t>(ptr_side);
 
   uint32_t cstate = tx_state >> 24;
-  int dma_base = (-side) & static_cast<int>(IR_SERVICE_TX_SIZE);
+  uint32_t *dst = &tx_dma_buffer[side * (IR_SERVICE_TX_SIZE / 2)];
+  const uint8_t side_bit = 1 << side;
   if (cstate <= 2) {
-    // Not transmitting.
-    for (int i = 0; i < IR_SERVICE_TX_SIZE; i++) {
-      tx_dma_buffer[dma_base + i] = 0;
+    // Not transmitting, the half stays 0 once cleared.
+    if (tx_dirty_halves & side_bit) {
+      for (size_t i = 0; i < IR_SERVICE_TX_SIZE / 2; i++) dst[i] = 0;
+      tx_dirty_halves &= ~side_bit;
     }
-  } else if (cstate == 3) {
-    // Send header.
-    size_t ctr = tx_state & 0x00FFFFFF;
-    size_t base = ctr * IR_PACKET_PER_RUN;
-    for (int i = 0; i < IR_SERVICE_TX_SIZE; i++) {
-      tx_dma_buffer[dma_base + i] =
-          (-static_cast<int16_t>(IR_PACKET_HEADER[base + i / 8])) &
-          IR_PWM_TIM_CCR;
-    }
-    tx_state++;
-    if (ctr == IR_PACKET_RUN_COUNT - 1) {
-      // Done.
-      tx_state = 0x04000000;
-    }
-  } else if (cstate == 4) {
-    // Send body.
-    size_t ctr = tx_state & 0x00FFFFFF;
-    size_t base_bit = ctr * IR_BITS_PER_TX_RUN;
-    int i = 0;
-    for (int j = 0; j < IR_BITS_PER_TX_RUN; j++, base_bit++) {
-      int cbit = (tx_pending_buffer[base_bit / 8] >> (base_bit % 8)) & 0x01;
-      int16_t ccr_val = (-static_cast<int16_t>(cbit)) & IR_PWM_TIM_CCR;
-      for (int k = 0; k < PULSE_PER_DATA_BIT; k++, i++) {
-        tx_dma_buffer[dma_base + i] = ccr_val;
-      }
-    }
-    tx_state++;
-    if (ctr + 1 == (tx_pending_buffer_len * 8 / IR_BITS_PER_TX_RUN)) {
-      // Transmission done.
-      tx_state = 0x00000000;
-      g_suspender.DecBlocker();
-      tx_packet_cnt++;
+    return;
+  }
+  my_assert(cstate <= 4);
+  if (cstate == 3) {
+    // From the top, this may be a retransmission after a collision.
+    tx_run = 0;
+    tx_run_left = tx_run_count ? tx_runs[0] : 0;
+    tx_state = 0x04000000;
+  }
+
+  size_t units = IR_TX_UNITS_PER_RUN;
+  while (units) {
+    if (!tx_run_left) {
+      if (tx_run + 1 >= tx_run_count) break;
+      tx_run_left = tx_runs[++tx_run];
+      continue;
     }
-  } else {
-    my_assert(false);
+    const size_t n = tx_run_left < units ? tx_run_left : units;
+    const uint32_t word = (tx_run & 1) ? IR_TX_ON_WORD : 0;
+    for (size_t i = 0; i < n * IR_TX_WORDS_PER_UNIT; i++) *dst++ = word;
+    tx_run_left -= n;
+    units -= n;
+  }
+  // Only if the runs end within the half.
+  for (size_t i = 0; i < units * IR_TX_WORDS_PER_UNIT; i++) *dst++ = 0;
+  tx_dirty_halves |= side_bit;
+
+  if (!tx_run_left && tx_run + 1 >= tx_run_count) {
+    // Transmission done.
+    tx_state = 0x00000000;
+    g_suspender.DecBlocker();
+    tx_packet_cnt++;
   }
 }
 
 void IrService::Routine(void *arg1) {
-  rx_required_quiet_period = 20 + g_fast_random_pool.GetRandom() % 32;
+  rx_required_quiet_period =
+      IR_TX_QUIET_MIN + g_fast_random_pool.GetRandom() % IR_TX_QUIET_SPREAD;
   if (rx_ctr_since_release >= 100000) rx_ctr_since_release = 100000;
 
   if (tx_state >> 24 == 0x02) {
     // Collision, let's wait randomly.
     tx_state++;
-    int collision_wait = tx_state & 0x00FFFFFF;
-    if (collision_wait >= (32 + g_fast_random_pool.GetRandom() % 64)) {
+    size_t collision_wait = tx_state & 0x00FFFFFF;
+    if (collision_wait >=
+        (IR_COLLISION_WAIT_MIN +
+         g_fast_random_pool.GetRandom() % IR_COLLISION_WAIT_SPREAD)) {
       // Wait's over, retransmit.
       tx_state = 0x01000000;
     }
@@ -9,9 +9,16 @@
 #include <stdint.h>
 
 namespace hitcon {
+namespace host {
+class IrAirSim;
+}  // namespace host
+
 namespace ir {
 
 class IrService {
+  // Drives many of these on one simulated medium.
+  friend class ::hitcon::host::IrAirSim;
+
  public:
   IrService();
 
@@ -32,10 +39,13 @@ class IrService {
   // Call to send an IR packet.
   // This is a packed bit array, each bit is PULSE_PER_DATA_BIT pulse at 38kHz.
   // The least significant bit of a byte is the first transmitted bit.
-  // Caller must guarantee that the buffer is valid and not changed during the
-  // whole transmission process.
+  // The buffer is expanded into tx_runs right away, so it's free again once
+  // this returns. len is at most IR_TX_MAX_BYTES.
   // If send_header is true, we'll prepend the header during transmission.
-  bool SendBuffer(const uint8_t* data, size_t len, bool send_header);
+  // If fast is true, it goes out with the fast profile, PULSE_PER_DATA_BIT_FAST
+  // pulses per bit after IR_PACKET_HEADER_FAST.
+  bool SendBuffer(const uint8_t* data, size_t len, bool send_header,
+                  bool fast);
 
   // Whenever we've collected of IR_SERVICE_RX_ON_BUFFER_SIZE bytes of receive
   // buffer, we'll call the specified function.
@@ -47,7 +57,8 @@ class IrService {
   void SetOnBufferReceived(callback_t callback, void* callback_arg1);
 
   uint16_t rx_dma_buffer[2 * IR_SERVICE_RX_SIZE];
-  uint16_t tx_dma_buffer[2 * IR_SERVICE_TX_SIZE];
+  // Two CCR3 values per word, the DMA still reads it as uint16_t.
+  uint32_t tx_dma_buffer[IR_SERVICE_TX_SIZE];
   uint8_t rx_buffer[2 * IR_SERVICE_RX_ON_BUFFER_SIZE];
   size_t rx_buffer_base;
 
@@ -63,18 +74,23 @@ class IrService {
   hitcon::service::sched::Task dma_rx_pull_task;
 
  private:
-  const uint8_t* tx_pending_buffer;
-  uint32_t tx_pending_buffer_len;
-  // If false, will skip sending header.
-  bool tx_pending_send_header;
+  // The pending buffer, as lengths of alternately off and on runs starting
+  // with off, in units of PULSE_PER_HEADER_BIT pulses.
+  uint8_t tx_runs[IR_TX_MAX_RUNS];
+  size_t tx_run_count;
+  // The run being sent, and how many of its units are left.
+  size_t tx_run;
+  uint8_t tx_run_left;
+  // Bit n is set if half n of tx_dma_buffer may not be all 0.
+  uint8_t tx_dirty_halves;
 
   /*
   MSB meaning:
   0x00 - Ready to accept the next buffer.
   0x01 - Waiting for air space to silent.
   0x02 - Waiting for collision to finish.
-  0x03 - Sending header.
-  0x04 - Sending body.
+  0x03 - Starting from the first run.
+  0x04 - Sending.
   */
   uint32_t tx_state;
 
@@ -98,6 +114,9 @@ class IrService {
 
   bool rx_on_buffer_callback_finished;
 
+  // Add units of on or off to the end of tx_runs.
+  void AppendTxRun(bool on, uint8_t units);
+
   // Call to populate TX DMA Buffer.
   // ptr_side is to be reinterpret_cast<int>(), and will be 0 or 1.
   void PopulateTxDmaBuffer(void* ptr_side);
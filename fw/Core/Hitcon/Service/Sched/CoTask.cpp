@@ -0,0 +1,34 @@
+/*
+ * CoTask.cpp
+ *
+ *  Resumable (stackless coroutine) tasks.
+ */
+
+#include "CoTask.h"
+
+#include "Scheduler.h"
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+CoTask::~CoTask() {}
+
+void CoTask::Start(void *arg) {
+  resumePoint = 0;
+  scheduler.Queue(this, arg);
+}
+
+void CoTask::Resume(void *self, void *result) {
+  CoTask *task = reinterpret_cast<CoTask *>(self);
+  // Running it nested saves the round trip through the ready heap. The chain
+  // of tasks resuming each other this way ends at the first one that
+  // suspends, so the stack only grows by how deep the awaits are nested.
+  if (!scheduler.RunNested(task, result)) scheduler.Queue(task, result);
+}
+
+void CoTask::Yield() { scheduler.Queue(this, nullptr); }
+
+} /* namespace sched */
+} /* namespace service */
+} /* namespace hitcon */
@@ -0,0 +1,88 @@
+/*
+ * CoTask.h
+ *
+ *  Resumable (stackless coroutine) tasks.
+ */
+
+#ifndef HITCON_SERVICE_SCHED_COTASK_H_
+#define HITCON_SERVICE_SCHED_COTASK_H_
+
+#include "Task.h"
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+// A Task whose callback can suspend itself and later carry on where it left
+// off, instead of being split into one callback and one Task per step.
+//
+// It's a protothread: the callback body sits between CO_BEGIN() and CO_END(),
+// and the CO_YIELD()/CO_AWAIT() in between return from it and jump back in on
+// the next Run(). Locals don't survive that, anything that has to live across
+// a suspension goes in a member. No two CO_ macros can share a line.
+//
+// CO_AWAIT() hands the task to an API that reports back through a
+// callback_t, by passing Resume and the CoTask as its callback and
+// callbackArg1. The second argument of the callback is passed to the body as
+// its arg, so it has to stay valid until the task runs.
+class CoTask : public Task {
+ private:
+  // __LINE__ of the suspension point to resume from, 0 to start over.
+  unsigned short resumePoint;
+
+ public:
+  // For prio, see Scheduler.h
+  constexpr CoTask(unsigned prio, task_callback_t callback, void *thisptr)
+      : Task(prio, callback, thisptr), resumePoint(0) {}
+
+  virtual ~CoTask();
+
+  // Queue the body to run from the top, dropping whatever was in progress.
+  void Start(void *arg);
+
+  // Run the body from the top the next time Resume() is called.
+  void Rewind() { resumePoint = 0; }
+
+  // callback_t for CO_AWAIT(), self is the CoTask. Resumes the body right
+  // away if Scheduler::RunNested() allows it, otherwise queues it.
+  static void Resume(void *self, void *result);
+
+  // For the CO_ macros only.
+  unsigned short GetResumePoint() { return resumePoint; }
+  void SetResumePoint(unsigned short line) { resumePoint = line; }
+  void Yield();
+};
+
+} /* namespace sched */
+} /* namespace service */
+} /* namespace hitcon */
+
+#define CO_BEGIN(co)                 \
+  switch ((co).GetResumePoint()) { \
+    case 0:
+
+// Let everything else that is ready run first, then carry on.
+#define CO_YIELD(co)                \
+  do {                              \
+    (co).SetResumePoint(__LINE__);  \
+    (co).Yield();                   \
+    return;                         \
+    case __LINE__:;                 \
+  } while (0)
+
+// Evaluate start, which should arrange for CoTask::Resume() to be called with
+// co, and carry on from there once it is.
+#define CO_AWAIT(co, start)         \
+  do {                              \
+    (co).SetResumePoint(__LINE__);  \
+    start;                          \
+    return;                         \
+    case __LINE__:;                 \
+  } while (0)
+
+// The body is done, the next Start() or Resume() runs it from the top.
+#define CO_END(co) \
+  }                \
+  (co).Rewind()
+
+#endif /* HITCON_SERVICE_SCHED_COTASK_H_ */
@@ -10,19 +10,43 @@
 
 #include "Task.h"
 
+// Keep delayed and periodic tasks in a TimerWheel instead of a fixed size
+// Heap<DelayedTask>, see Scheduler.h.
+#ifndef SCHED_USE_TIMER_WHEEL
+#define SCHED_USE_TIMER_WHEEL 1
+#endif
+
 namespace hitcon {
 namespace service {
 namespace sched {
 
+template <class T, unsigned bits, unsigned levels>
+class TimerWheel;
+
 class DelayedTask : public Task {
  protected:
   unsigned wakeTime;
+#if SCHED_USE_TIMER_WHEEL
+  // Links for the TimerWheel this task is in, maintained by TimerWheel.
+  DelayedTask *wheelNext;
+  DelayedTask **wheelPprev;
+  unsigned char wheelLevel;
+
+  template <class T, unsigned bits, unsigned levels>
+  friend class TimerWheel;
+#endif
 
  public:
   // For prio, see Scheduler.h
   constexpr DelayedTask(unsigned prio, task_callback_t callback, void *thisptr,
                         unsigned wakeTime)
-      : Task(prio, callback, thisptr), wakeTime(wakeTime) {}
+      : Task(prio, callback, thisptr), wakeTime(wakeTime)
+#if SCHED_USE_TIMER_WHEEL
+        ,
+        wheelNext(nullptr), wheelPprev(nullptr), wheelLevel(0)
+#endif
+  {
+  }
 
   virtual ~DelayedTask();
 
@@ -14,30 +14,31 @@ namespace hitcon {
 namespace service {
 namespace sched {
 
+// Unordered array of T*. Like Heap, each element remembers its own position
+// in arrayIdx so Remove() doesn't need to search.
 template <class T, unsigned capacity>
 class Array {
-  unsigned sz;
+  unsigned sz = 0;
   T *storage[capacity];
 
- private:
-  unsigned GetIdx(T &t) {
-    for (unsigned i = 0; i < sz; ++i) {
-      if (t == *storage[i]) return i;
-    }
-    return sz;
-  }
-
  public:
   bool Add(T *t) {
     if (sz >= capacity) return false;
+    t->arrayIdx = sz;
     storage[sz++] = t;
     return true;
   }
 
+  bool Contains(T *t) {
+    unsigned idx = t->arrayIdx;
+    return idx < sz && storage[idx] == t;
+  }
+
   bool Remove(T *t) {
-    unsigned idx = GetIdx(*t);
-    if (idx == sz) return false;
+    if (!Contains(t)) return false;
+    unsigned idx = t->arrayIdx;
     storage[idx] = storage[--sz];
+    storage[idx]->arrayIdx = idx;
     return true;
   }
 };
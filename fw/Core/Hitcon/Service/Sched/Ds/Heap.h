@@ -24,68 +24,82 @@ inline unsigned ChildIdx2(unsigned i) { return (i * 2) + 2; }
 
 } /* namespace heap */
 
+// Binary min-heap of T*. The heap is intrusive: each element remembers its
+// own position in heapIdx, so Remove() and Update() don't need to search.
+// An element can only be in one Heap at a time.
 template <class T, unsigned capacity>
 class Heap {
   unsigned sz;
   T *storage[capacity];
 
  private:
-  unsigned GetIdx(T &t) {
-    for (unsigned i = 0; i < sz; ++i) {
-      if (t == *storage[i]) return i;
-    }
-    return sz;
+  inline void Place(unsigned i, T *t) {
+    storage[i] = t;
+    t->heapIdx = i;
   }
 
   void Heapify(unsigned i) {
+    T *t = storage[i];
     while (i > 0) {
       unsigned parIdx = heap::ParentIdx(i);
-      T **cur = &storage[i], **par = &storage[parIdx];
-      if (**cur < **par) {
-        T *tmp1 = *cur;
-        *cur = *par;
-        *par = tmp1;
-      }
+      if (!(*t < *storage[parIdx])) break;
+      Place(i, storage[parIdx]);
       i = parIdx;
     }
+    Place(i, t);
   }
 
   void ReverseHeapify(unsigned i) {
+    T *t = storage[i];
     while (heap::ChildIdx1(i) < sz) {
-      unsigned i1 = heap::ChildIdx1(i);
+      unsigned smallest = heap::ChildIdx1(i);
       unsigned i2 = heap::ChildIdx2(i);
-      unsigned smallest = i;
-      if (i1 < sz && *storage[i1] < *storage[smallest]) smallest = i1;
       if (i2 < sz && *storage[i2] < *storage[smallest]) smallest = i2;
-      if (i == smallest) break;
-      T *tmp1 = storage[i];
-      storage[i] = storage[smallest];
-      storage[smallest] = tmp1;
+      if (!(*storage[smallest] < *t)) break;
+      Place(i, storage[smallest]);
       i = smallest;
     }
+    Place(i, t);
   }
 
  public:
-  Heap() {}
+  Heap() : sz(0) {}
 
   virtual ~Heap() {}
 
   bool Add(T *t) {
     if (sz >= capacity) return false;
-    storage[sz++] = t;
+    Place(sz++, t);
     Heapify(sz - 1);
     return true;
   }
 
+  bool Contains(T *t) {
+    unsigned idx = t->heapIdx;
+    return idx < sz && storage[idx] == t;
+  }
+
   bool Remove(T *t) {
-    unsigned idx = GetIdx(*t);
-    if (idx == sz) return false;
-    storage[idx] = storage[--sz];
+    if (!Contains(t)) return false;
+    unsigned idx = t->heapIdx;
+    T *last = storage[--sz];
     storage[sz] = nullptr;
-    ReverseHeapify(idx);
+    if (idx != sz) {
+      Place(idx, last);
+      Update(last);
+    }
     return true;
   }
 
+  // Restore the heap order after t's key has changed, whichever direction.
+  void Update(T *t) {
+    unsigned idx = t->heapIdx;
+    if (idx > 0 && *t < *storage[heap::ParentIdx(idx)])
+      Heapify(idx);
+    else
+      ReverseHeapify(idx);
+  }
+
   T &Top() { return *storage[0]; }
 
   unsigned size() { return sz; }
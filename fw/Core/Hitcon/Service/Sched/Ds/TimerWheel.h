@@ -0,0 +1,189 @@
+/*
+ * TimerWheel.h
+ *
+ *  Hierarchical timer wheel for DelayedTask, an alternative to
+ *  Heap<DelayedTask>.
+ */
+
+#ifndef HITCON_SERVICE_SCHED_DS_TIMER_WHEEL_H_
+#define HITCON_SERVICE_SCHED_DS_TIMER_WHEEL_H_
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+// Tick-indexed hierarchical timer wheel, one tick is one SysTimer unit (ms).
+//
+// Level 0 has one slot per tick for the next 2^bits ticks, each level above
+// covers 2^bits times the range of the one below. When the tick counter
+// crosses a boundary, the matching slot of the level above is cascaded down.
+// Elements beyond the range of the top level are parked in its farthest slot
+// and get re-filed when they're cascaded.
+//
+// The wheel is intrusive and unbounded: T must provide WakeTime() and the
+// wheelNext/wheelPprev/wheelLevel members. Add() and Remove() are O(1).
+// Everything due on the same tick sits in the same slot and expires as one
+// batch.
+template <class T, unsigned bits, unsigned levels>
+class TimerWheel {
+  static_assert(bits * levels < 32, "Wheel range must fit in a tick counter");
+  static constexpr unsigned kSlots = 1u << bits;
+  static constexpr unsigned kMask = kSlots - 1;
+  // wheelLevel of elements on the expired list.
+  static constexpr unsigned kExpired = levels;
+
+  T *slots[levels][kSlots];
+  unsigned slotCount[levels];
+  // Elements that are due but not yet taken by PopExpired().
+  T *expired;
+  // Next tick to be processed by Advance().
+  unsigned tick;
+  unsigned sz;
+
+ private:
+  static inline void Link(T **head, T *t, unsigned level) {
+    t->wheelNext = *head;
+    if (*head) (*head)->wheelPprev = &t->wheelNext;
+    *head = t;
+    t->wheelPprev = head;
+    t->wheelLevel = level;
+  }
+
+  inline void Unlink(T *t) {
+    *t->wheelPprev = t->wheelNext;
+    if (t->wheelNext) t->wheelNext->wheelPprev = t->wheelPprev;
+    if (t->wheelLevel != kExpired) slotCount[t->wheelLevel]--;
+    t->wheelNext = nullptr;
+    t->wheelPprev = nullptr;
+  }
+
+  bool AnyFiled() {
+    for (unsigned l = 0; l < levels; l++) {
+      if (slotCount[l]) return true;
+    }
+    return false;
+  }
+
+  void File(T *t) {
+    unsigned wake = t->WakeTime();
+    unsigned delta = wake - tick;
+    if (static_cast<int>(delta) < 0) {
+      Link(&expired, t, kExpired);
+      return;
+    }
+    unsigned level = 0;
+    while (level + 1 < levels && delta >= (1u << (bits * (level + 1)))) {
+      level++;
+    }
+    if (delta >= (1u << (bits * levels))) {
+      // Too far out, park it in the farthest slot.
+      wake = tick + (1u << (bits * levels)) - 1;
+    }
+    Link(&slots[level][(wake >> (bits * level)) & kMask], t, level);
+    slotCount[level]++;
+  }
+
+  void Cascade(unsigned level, unsigned idx) {
+    T *t = slots[level][idx];
+    while (t) {
+      T *next = t->wheelNext;
+      Unlink(t);
+      File(t);
+      t = next;
+    }
+  }
+
+ public:
+  TimerWheel() : expired(nullptr), tick(0), sz(0) {
+    for (unsigned l = 0; l < levels; l++) {
+      slotCount[l] = 0;
+      for (unsigned i = 0; i < kSlots; i++) slots[l][i] = nullptr;
+    }
+  }
+
+  bool Add(T *t) {
+    File(t);
+    sz++;
+    return true;
+  }
+
+  bool Contains(T *t) { return t->wheelPprev != nullptr; }
+
+  bool Remove(T *t) {
+    if (!Contains(t)) return false;
+    Unlink(t);
+    sz--;
+    return true;
+  }
+
+  // Process every tick up to and including now. Whatever is due ends up on
+  // the expired list.
+  void Advance(unsigned now) {
+    while (static_cast<int>(now - tick) >= 0) {
+      if (!AnyFiled()) {
+        tick = now + 1;
+        break;
+      }
+      unsigned idx = tick & kMask;
+      if (idx == 0) {
+        for (unsigned l = 1; l < levels; l++) {
+          unsigned i = (tick >> (bits * l)) & kMask;
+          if (slotCount[l]) Cascade(l, i);
+          if (i != 0) break;
+        }
+      }
+      // Everything due on this tick goes in one batch.
+      T *t = slots[0][idx];
+      while (t) {
+        T *next = t->wheelNext;
+        Unlink(t);
+        Link(&expired, t, kExpired);
+        t = next;
+      }
+      tick++;
+      if (!slotCount[0] && (tick & kMask) != 0) {
+        // Level 0 is empty until the next cascade, skip ahead.
+        unsigned boundary = (tick | kMask) + 1;
+        tick = static_cast<int>(now + 1 - boundary) >= 0 ? boundary : now + 1;
+      }
+    }
+  }
+
+  // Take one element off the expired list, nullptr if there's none.
+  T *PopExpired() {
+    T *t = expired;
+    if (t) {
+      Unlink(t);
+      sz--;
+    }
+    return t;
+  }
+
+  // Lower bound of the next time something could expire, only meaningful
+  // when size() != 0. It is exact if that's before the next cascade, or if
+  // nothing is filed above level 0. Otherwise it's the next cascade, after
+  // which it should be asked again.
+  unsigned NextWake() {
+    if (expired) return tick - 1;
+    // Advance() hasn't cascaded into tick yet if it's on a boundary.
+    const unsigned boundary = tick & kMask ? (tick | kMask) + 1 : tick;
+    bool above = false;
+    for (unsigned l = 1; l < levels; l++) above |= slotCount[l] != 0;
+    if (slotCount[0]) {
+      // Slots past the boundary are already the next round of level 0.
+      for (unsigned i = 0; i < kSlots; i++) {
+        if (!slots[0][(tick + i) & kMask]) continue;
+        return above && tick + i > boundary ? boundary : tick + i;
+      }
+    }
+    return boundary;
+  }
+
+  unsigned size() { return sz; }
+};
+
+} /* namespace sched */
+} /* namespace service */
+} /* namespace hitcon */
+
+#endif /* HITCON_SERVICE_SCHED_DS_TIMER_WHEEL_H_ */
@@ -14,14 +14,22 @@ namespace hitcon {
 namespace service {
 namespace sched {
 
+template <class T, unsigned capacity>
+class Array;
+
 class PeriodicTask : public DelayedTask {
  private:
   bool enabled;
   unsigned interval;
   void *savedThisptr;
   task_callback_t savedCallback;
+  // Position in the enabled/disabled Array, maintained by Array.
+  unsigned arrayIdx;
   void AutoRequeueCb(void *arg);
 
+  template <class T, unsigned capacity>
+  friend class Array;
+
  public:
   // For prio, see Scheduler.h
   constexpr PeriodicTask(unsigned prio, task_callback_t callback, void *thisptr,
@@ -29,7 +37,7 @@ class PeriodicTask : public DelayedTask {
       : DelayedTask(prio, (task_callback_t)&PeriodicTask::AutoRequeueCb,
                     (void *)this, 0),
         enabled(false), interval(interval), savedThisptr(thisptr),
-        savedCallback(callback) {}
+        savedCallback(callback), arrayIdx(0) {}
 
   virtual ~PeriodicTask();
   void Enable();
@@ -0,0 +1,70 @@
+/*
+ * Profiler.cc
+ *
+ *  Per task dispatch accounting in DWT cycles.
+ */
+
+#include "Profiler.h"
+
+#include <string.h>
+
+#if SCHED_PROFILE
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+namespace {
+
+void AddSample(uint16_t *hist, uint32_t cycles) {
+  uint16_t &count = hist[Profiler::Bucket(cycles)];
+  if (count != 0xFFFF) count++;
+}
+
+}  // namespace
+
+Profiler::Profiler() : used(0), overflowed(false) { Reset(); }
+
+unsigned Profiler::Bucket(uint32_t cycles) {
+  unsigned log2 = cycles ? 31 - __builtin_clz(cycles) : 0;
+  if (log2 < kHistShift) return 0;
+  log2 -= kHistShift;
+  return log2 < kHistBuckets ? log2 : kHistBuckets - 1;
+}
+
+void Profiler::Record(Task *task, uint32_t waitCycles, uint32_t execCycles,
+                      bool missed) {
+  // profileIdx may be stale after a Reset().
+  size_t i = task->profileIdx;
+  if (i >= used || profiles[i].task != task) {
+    if (used < kSlots) {
+      i = used++;
+      profiles[i].task = task;
+    } else {
+      i = kSlots;
+      overflowed = true;
+    }
+    task->profileIdx = i;
+  }
+  TaskProfile &p = profiles[i];
+  p.runs++;
+  if (missed) p.misses++;
+  p.execTotal += execCycles;
+  if (execCycles > p.execMax) p.execMax = execCycles;
+  p.waitTotal += waitCycles;
+  if (waitCycles > p.waitMax) p.waitMax = waitCycles;
+  AddSample(p.execHist, execCycles);
+  AddSample(p.waitHist, waitCycles);
+}
+
+void Profiler::Reset() {
+  memset(profiles, 0, sizeof(profiles));
+  used = 0;
+  overflowed = false;
+}
+
+} /* namespace sched */
+} /* namespace service */
+} /* namespace hitcon */
+
+#endif  // SCHED_PROFILE
@@ -0,0 +1,73 @@
+/*
+ * Profiler.h
+ *
+ *  Per task dispatch accounting in DWT cycles.
+ */
+
+#ifndef HITCON_SERVICE_SCHED_PROFILER_H_
+#define HITCON_SERVICE_SCHED_PROFILER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Task.h"
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+// Bucket i of a histogram counts samples in [2^(i+kHistShift),
+// 2^(i+kHistShift+1)) cycles, the first and last bucket also take everything
+// below and above.
+constexpr unsigned kHistShift = 8;
+constexpr size_t kHistBuckets = 10;
+
+struct TaskProfile {
+  // nullptr for the shared entry of tasks that didn't get their own.
+  Task *task;
+  uint32_t runs;
+  // Task::Run() duration.
+  uint32_t execMax;
+  // From entering the ready heap until the dispatch.
+  uint32_t waitMax;
+  // Runs that finished past Task::GetDeadline().
+  uint32_t misses;
+  uint64_t execTotal;
+  uint64_t waitTotal;
+  // Counters saturate at 0xFFFF.
+  uint16_t execHist[kHistBuckets];
+  uint16_t waitHist[kHistBuckets];
+};
+
+class Profiler {
+ public:
+  // Tasks get an entry on their first run, the ones after that share the
+  // last entry. Each task keeps the index of its entry in profileIdx, so
+  // Record() doesn't need to search.
+  static constexpr size_t kSlots = 24;
+  static_assert(kSlots < 256, "Task::profileIdx is a byte");
+
+  Profiler();
+
+  void Record(Task *task, uint32_t waitCycles, uint32_t execCycles,
+              bool missed);
+  void Reset();
+
+  // Entries in use, including the shared one once something lands there.
+  size_t size() { return used + (overflowed ? 1 : 0); }
+  const TaskProfile &Get(size_t i) { return profiles[i]; }
+
+  static unsigned Bucket(uint32_t cycles);
+
+ private:
+  TaskProfile profiles[kSlots + 1];
+  size_t used;
+  // The shared entry has been used.
+  bool overflowed;
+};
+
+} /* namespace sched */
+} /* namespace service */
+} /* namespace hitcon */
+
+#endif /* HITCON_SERVICE_SCHED_PROFILER_H_ */
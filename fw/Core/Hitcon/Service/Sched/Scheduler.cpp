@@ -25,33 +25,28 @@ Scheduler::~Scheduler() {}
 bool Scheduler::Queue(Task *task, void *arg) {
   my_assert(task);
   task->SetArg(arg);
-  bool result = true;
-  // TODO: Disable Interrupt.
-  __disable_irq();
+  task->queuedCycle = SysTimer::GetCycles();
+  // The add queues are lock-free, no need to mask interrupts.
   if (!tasksAddQueue.PushBack(task)) {
-    // Overflow, we need to drop this request.
-    result = false;
+    // Overflow, we need to drop this request. It's counted by the queue.
     AssertOverflow();
+    return false;
   }
-  // TODO: Enable Interrupt.
-  __enable_irq();
-  return result;
+#ifdef HITCON_HOST_BUILD
+  HostOnTaskQueued(task);
+#endif
+  return true;
 }
 
 bool Scheduler::Queue(DelayedTask *task, void *arg) {
   my_assert(task);
   task->SetArg(arg);
-  bool result = true;
-  // TODO: Disable Interrupt.
-  __disable_irq();
   if (!delayedTasksAddQueue.PushBack(task)) {
-    // Overflow, we need to drop this request.
-    result = false;
+    // Overflow, we need to drop this request. It's counted by the queue.
     AssertOverflow();
+    return false;
   }
-  // TODO: Enable Interrupt.
-  __enable_irq();
-  return result;
+  return true;
 }
 
 bool Scheduler::Queue(PeriodicTask *task, void *arg) {
@@ -75,6 +70,9 @@ bool Scheduler::EnablePeriodic(PeriodicTask *task) {
       AssertOverflow();
     } else {
       task->EnterQueue();
+#ifdef HITCON_HOST_BUILD
+      HostOnTaskQueued(task);
+#endif
     }
   }
   task->Enable();
@@ -107,27 +105,48 @@ bool Scheduler::DisablePeriodic(PeriodicTask *task) {
 
 void Scheduler::DelayedHouseKeeping() {
   // Handle all Queue operations.
-  while (!tasksAddQueue.IsEmpty()) {
-    bool ret = tasks.Add(tasksAddQueue.Front());
+  Task *task;
+  while (tasksAddQueue.PeekFront(task)) {
+    bool ret = tasks.Add(task);
     if (!ret) {
       // Heap is full.
       AssertOverflow();
       break;
     }
-    tasksAddQueue.Front()->EnterQueue();
+    task->EnterQueue();
     tasksAddQueue.PopFront();
   }
-  while (!delayedTasksAddQueue.IsEmpty()) {
-    bool ret = delayedTasks.Add(delayedTasksAddQueue.Front());
+  DelayedTask *delayedTask;
+  while (delayedTasksAddQueue.PeekFront(delayedTask)) {
+    bool ret = delayedTasks.Add(delayedTask);
     if (!ret) {
       // Heap is full.
       AssertOverflow();
       break;
     }
-    delayedTasksAddQueue.Front()->EnterQueue();
+    delayedTask->EnterQueue();
     delayedTasksAddQueue.PopFront();
   }
   unsigned now = SysTimer::GetTime();
+#if SCHED_USE_TIMER_WHEEL
+  delayedTasks.Advance(now);
+  while (DelayedTask *expired = delayedTasks.PopExpired()) {
+    expired->ExitQueue();
+    bool ret = tasks.Add(expired);
+    if (!ret) {
+      // Heap is full, put it back so it's retried on the next round.
+      AssertOverflow();
+      delayedTasks.Add(expired);
+      expired->EnterQueue();
+      break;
+    }
+    expired->EnterQueue();
+    expired->queuedCycle = SysTimer::GetCycles();
+#ifdef HITCON_HOST_BUILD
+    HostOnTaskWoken(expired, expired->WakeTime());
+#endif
+  }
+#else
   while (delayedTasks.size()) {
     DelayedTask &top = delayedTasks.Top();
     unsigned wake = top.WakeTime();
@@ -143,14 +162,63 @@ void Scheduler::DelayedHouseKeeping() {
       AssertOverflow();
     } else {
       top.EnterQueue();
+      top.queuedCycle = SysTimer::GetCycles();
+#ifdef HITCON_HOST_BUILD
+      HostOnTaskWoken(&top, wake);
+#endif
     }
   }
+#endif
+}
+
+void Scheduler::Idle() {
+  bool hasDelayed = delayedTasks.size() != 0;
+  unsigned nextWake = 0;
+  if (hasDelayed) {
+#if SCHED_USE_TIMER_WHEEL
+    // Never late, but may be early at a wheel cascade. The next round will
+    // sleep again then.
+    nextWake = delayedTasks.NextWake();
+#else
+    nextWake = delayedTasks.Top().WakeTime();
+#endif
+  }
+  unsigned start = SysTimer::GetTime();
+  idleCount++;
+  while (1) {
+    // Check and sleep with interrupts masked, so an interrupt that queues a
+    // task in between still wakes up the WFI.
+    __disable_irq();
+    if (!tasksAddQueue.IsEmpty() || !delayedTasksAddQueue.IsEmpty()) break;
+    if (hasDelayed && SysTimer::GetTime() >= nextWake) break;
+#ifdef HITCON_HOST_BUILD
+    HostOnIdle(hasDelayed, nextWake);
+    if (HostShouldStop()) break;
+#else
+    __WFI();
+#endif
+    // Let the pending interrupt run.
+    __enable_irq();
+  }
+  __enable_irq();
+  idleTime += SysTimer::GetTime() - start;
 }
 
 void Scheduler::Run() {
+#ifdef DEBUG
+  // Keep the debugger attached while sleeping in Idle().
+  HAL_DBGMCU_EnableDBGSleepMode();
+#endif
+  SysTimer::StartCycleCounter();
   while (1) {
+#ifdef HITCON_HOST_BUILD
+    if (HostShouldStop()) return;
+#endif
     DelayedHouseKeeping();
-    if (!tasks.size()) continue;
+    if (!tasks.size()) {
+      Idle();
+      continue;
+    }
     Task &top = tasks.Top();
     bool ret = tasks.Remove(&top);
     if (!ret) {
@@ -158,18 +226,97 @@ void Scheduler::Run() {
     } else {
       top.ExitQueue();
     }
-    totalTasks++;
-    TaskRecord record;
-    record.startTime = SysTimer::GetTime();
-    record.task = &top;
-
-    currentTask = &top;
-    top.Run();
-    currentTask = nullptr;
-    record.endTime = SysTimer::GetTime();
-    taskRecords[record_index] = record;
-    record_index++;
-    if (record_index == kRecordSize) record_index = 0;
+    // top may queue itself again while it runs, which restamps it.
+    Dispatch(top, top.queuedCycle);
+  }
+}
+
+void Scheduler::Dispatch(Task &task, uint32_t queuedCycle) {
+  totalTasks++;
+  TaskRecord record;
+  record.task = &task;
+
+  Task *caller = currentTask;
+  uint32_t callerNested = nestedCycles;
+  nestedCycles = 0;
+  currentTask = &task;
+#ifdef HITCON_HOST_BUILD
+  HostOnTaskStart(&task, tasks.size(), delayedTasks.size());
+#endif
+  record.startTime = SysTimer::GetCycles();
+  // A nested dispatch shares the slice of the one it's nested in.
+  if (!caller) sliceStart = record.startTime;
+  task.Run();
+#ifdef HITCON_HOST_BUILD
+  HostOnTaskEnd(&task);
+#endif
+  record.endTime = SysTimer::GetCycles();
+  currentTask = caller;
+  // Dispatches nested in this one are accounted to their own tasks.
+  uint32_t nested = nestedCycles;
+  nestedCycles = callerNested + (record.endTime - record.startTime);
+  taskRecords[record_index] = record;
+  record_index++;
+  if (record_index == kRecordSize) record_index = 0;
+
+  if (task.deadline && task.deadline / 4 < sliceCycles) {
+    sliceCycles = task.deadline / 4;
+  }
+  uint32_t endCycle = record.endTime - nested;
+  bool missed = task.deadline && endCycle - queuedCycle > task.deadline;
+  if (missed) OnDeadlineMiss(&task, queuedCycle, endCycle);
+#if SCHED_PROFILE
+  profiler.Record(&task, record.startTime - queuedCycle,
+                  record.endTime - record.startTime - nested, missed);
+#endif
+}
+
+bool Scheduler::RunNested(Task *task, void *arg) {
+  if (!RemainingBudget()) return false;
+  if (tasks.size() && tasks.Top() < *task) return false;
+  task->SetArg(arg);
+  Dispatch(*task, SysTimer::GetCycles());
+  return true;
+}
+
+uint32_t Scheduler::RemainingBudget() {
+#ifdef HITCON_HOST_BUILD
+  HostOnBudgetQuery(currentTask);
+#endif
+  if (!currentTask) return 0;
+  if (!tasksAddQueue.IsEmpty() || !delayedTasksAddQueue.IsEmpty()) return 0;
+  if (tasks.size() && tasks.Top() < *currentTask) return 0;
+  if (delayedTasks.size()) {
+#if SCHED_USE_TIMER_WHEEL
+    unsigned nextWake = delayedTasks.NextWake();
+#else
+    unsigned nextWake = delayedTasks.Top().WakeTime();
+#endif
+    if (SysTimer::GetTime() >= nextWake) return 0;
+  }
+  uint32_t used = SysTimer::GetCycles() - sliceStart;
+  return used < sliceCycles ? sliceCycles - used : 0;
+}
+
+void Scheduler::OnDeadlineMiss(Task *task, uint32_t queuedCycle,
+                               uint32_t endCycle) {
+  deadlineMisses++;
+  lastDeadlineMiss.task = task;
+  lastDeadlineMiss.lateCycles = endCycle - queuedCycle - task->deadline;
+  lastDeadlineMiss.time = SysTimer::GetTime();
+  // Blame the longest dispatch in taskRecords that ended after task was
+  // queued, that's what kept it waiting (or task itself).
+  lastDeadlineMiss.offender = nullptr;
+  lastDeadlineMiss.offenderCycles = 0;
+  for (size_t i = 0; i < kRecordSize; i++) {
+    TaskRecord &r = taskRecords[i];
+    if (!r.task) continue;
+    if (static_cast<int32_t>(r.endTime - queuedCycle) <= 0) continue;
+    uint32_t cycles = r.endTime - r.startTime;
+    if (cycles > lastDeadlineMiss.offenderCycles) {
+      lastDeadlineMiss.offender = r.task;
+      lastDeadlineMiss.offenderCycles = cycles;
+    }
   }
 }
 
@@ -8,7 +8,7 @@
 #ifndef HITCON_SERVICE_SCHED_SCHEDULER_H_
 #define HITCON_SERVICE_SCHED_SCHEDULER_H_
 
-#include <Util/CircularQueue.h>
+#include <Util/MpscQueue.h>
 #include <stddef.h>
 
 #include <cstdint>
@@ -16,7 +16,9 @@
 #include "DelayedTask.h"
 #include "Ds/Array.h"
 #include "Ds/Heap.h"
+#include "Ds/TimerWheel.h"
 #include "PeriodicTask.h"
+#include "Profiler.h"
 #include "Scheduler.h"
 #include "Task.h"
 
@@ -39,41 +41,81 @@ For real time task that has hard deadline, such as display refresh/trigger,
 we use priority 100-200.
 */
 
+// Start and end are SysTimer::GetCycles().
 struct TaskRecord {
   Task *task;
   uint32_t startTime;
   uint32_t endTime;
 };
 
+struct DeadlineMiss {
+  // The task that finished past its deadline.
+  Task *task;
+  // The longest dispatch between task being queued and it finishing, which
+  // may be task itself.
+  Task *offender;
+  uint32_t offenderCycles;
+  // How far past the deadline task finished.
+  uint32_t lateCycles;
+  // SysTimer::GetTime() when it was detected.
+  uint32_t time;
+};
+
 class Scheduler {
  private:
   static constexpr size_t kAddQueueSize = 8;
   static constexpr size_t kRecordSize = 20;
+  // Longest slice RemainingBudget() hands out, 1ms.
+  static constexpr uint32_t kMaxSliceCycles = 1000 * SysTimer::kCyclesPerUs;
 
   Heap<Task, 32> tasks;
+#if SCHED_USE_TIMER_WHEEL
+  // 32 ticks per level, 4 levels covers 2^20ms (~17 minutes) before tasks
+  // have to be parked and re-filed.
+  TimerWheel<DelayedTask, 5, 4> delayedTasks;
+#else
   Heap<DelayedTask, 24> delayedTasks;
+#endif
   Array<PeriodicTask, 24> enabledPeriodicTasks, disabledPeriodicTasks;
 
   // Queue used to temporarily hold calls to Queue() so we can defer heap
-  // operations to later.
-  /* Previous raw queue implementation.
-  Task* tasksAddQueue[kAddQueueSize];
-  size_t tasksAddQueueHead = 0;
-  size_t tasksAddQueueTail = 0;
-  DelayedTask* delayedTasksAddQueue[kAddQueueSize];
-  size_t delayedTasksAddQueueHead = 0;
-  size_t delayedTasksAddQueueTail = 0;*/
-  CircularQueue<Task *, kAddQueueSize> tasksAddQueue;
-  CircularQueue<DelayedTask *, kAddQueueSize> delayedTasksAddQueue;
+  // operations to later. Interrupts push while the scheduler pops, so these
+  // are lock-free instead of masking interrupts around each push.
+  MpscQueue<Task *, kAddQueueSize> tasksAddQueue;
+  MpscQueue<DelayedTask *, kAddQueueSize> delayedTasksAddQueue;
 
   size_t totalTasks = 0;
 
-  TaskRecord taskRecords[kRecordSize];
+  // Time spent sleeping in Idle(), in SysTimer units (ms), and how many times
+  // the scheduler went idle.
+  uint32_t idleTime = 0;
+  uint32_t idleCount = 0;
+
+  TaskRecord taskRecords[kRecordSize] = {};
   size_t record_index{0};
 
+  uint32_t deadlineMisses = 0;
+  DeadlineMiss lastDeadlineMiss = {};
+
   Task *currentTask = nullptr;
+  // SysTimer::GetCycles() when currentTask started.
+  uint32_t sliceStart = 0;
+  // Length of a slice, a quarter of the tightest deadline seen so far.
+  uint32_t sliceCycles = kMaxSliceCycles;
+  // Cycles spent in dispatches nested in the current one, see RunNested().
+  uint32_t nestedCycles = 0;
+
+#if SCHED_PROFILE
+  Profiler profiler;
+#endif
 
   void DelayedHouseKeeping();
+  // Sleeps until the earliest delayed task is due or an interrupt queues a
+  // task.
+  void Idle();
+  // Runs task and accounts for it, queuedCycle is when it became ready.
+  void Dispatch(Task &task, uint32_t queuedCycle);
+  void OnDeadlineMiss(Task *task, uint32_t queuedCycle, uint32_t endCycle);
 
  public:
   Scheduler();
@@ -94,12 +136,63 @@ class Scheduler {
   // Which task is running now? nullptr for nothing's running.
   Task *GetCurrentTask() { return currentTask; }
 
+  // How many more cycles may the running task use before it should return?
+  // Long computations can loop while this is non-zero instead of doing one
+  // step per dispatch. It's 0 once the slice is used up, or as soon as
+  // anything is queued, a more urgent task is ready or a delayed task is due,
+  // so hard deadline tasks wait at most one step.
+  uint32_t RemainingBudget();
+
+  // Runs task right away, nested in the running task, if that has budget left
+  // and task would be dispatched before everything that's ready anyway. Its
+  // time and deadline count for task itself. Returns false, without running
+  // it, otherwise.
+  bool RunNested(Task *task, void *arg);
+
   // How many tasks has run?
   size_t GetTotalTasksRan() { return totalTasks; }
+
+  // How long has the scheduler slept, in ms, and how many times?
+  uint32_t GetIdleTime() { return idleTime; }
+  uint32_t GetIdleCount() { return idleCount; }
+
+  // How many Queue() calls were dropped because the add queue was full.
+  uint32_t GetQueueOverflows() {
+    return tasksAddQueue.Overflows() + delayedTasksAddQueue.Overflows();
+  }
+
+  // How many dispatches finished past the deadline of their task, see
+  // Task::SetDeadline(), and the details of the last one.
+  uint32_t GetDeadlineMisses() { return deadlineMisses; }
+  const DeadlineMiss &GetLastDeadlineMiss() { return lastDeadlineMiss; }
+
+#if SCHED_PROFILE
+  // Per task cycle counts, see Profiler.h.
+  Profiler &GetProfiler() { return profiler; }
+#endif
 };
 
 extern Scheduler scheduler;
 
+#ifdef HITCON_HOST_BUILD
+// Hooks for the host build, implemented in Host/SchedProbe.cc. They let the
+// harness observe every dispatch and drive the virtual clock.
+
+// task was handed to Queue(Task*), or a periodic task was enabled.
+void HostOnTaskQueued(Task *task);
+// task left the delayed queue, it was due at wakeTime.
+void HostOnTaskWoken(DelayedTask *task, unsigned wakeTime);
+void HostOnTaskStart(Task *task, size_t readyDepth, size_t delayedDepth);
+void HostOnTaskEnd(Task *task);
+// Nothing to run, stands in for __WFI(). nextWake is only valid if hasDelayed.
+void HostOnIdle(bool hasDelayed, unsigned nextWake);
+// Run() returns once this is true.
+bool HostShouldStop();
+// The running task asked for RemainingBudget(), charge it for the work so
+// far.
+void HostOnBudgetQuery(Task *task);
+#endif  // HITCON_HOST_BUILD
+
 } /* namespace sched */
 } /* namespace service */
 } /* namespace hitcon */
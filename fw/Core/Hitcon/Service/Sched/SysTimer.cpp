@@ -27,6 +27,14 @@ unsigned SysTimer::GetTime() {
   return HAL_GetTick();
 }
 
+void SysTimer::StartCycleCounter() {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+unsigned SysTimer::GetCycles() { return DWT->CYCCNT; }
+
 } /* namespace sched */
 } /* namespace service */
 } /* namespace hitcon */
@@ -17,6 +17,14 @@ class SysTimer {
   SysTimer();
   virtual ~SysTimer();
   static unsigned GetTime();
+
+  // HCLK.
+  static constexpr unsigned kCyclesPerUs = 12;
+
+  // DWT cycle counter, HCLK cycles. Wraps every ~6 minutes at 12MHz, so only
+  // use it for differences.
+  static void StartCycleCounter();
+  static unsigned GetCycles();
 };
 
 } /* namespace sched */
@@ -9,6 +9,17 @@
 #define HITCON_SERVICE_SCHED_TASK_H_
 
 #include <Service/Sched/Checks.h>
+#include <Service/Sched/SysTimer.h>
+
+// Per task dispatch profiling, see Profiler.h. It costs ~1.9KB of RAM, so
+// it's only on in debug builds unless set explicitly.
+#ifndef SCHED_PROFILE
+#ifdef DEBUG
+#define SCHED_PROFILE 1
+#else
+#define SCHED_PROFILE 0
+#endif
+#endif
 
 namespace hitcon {
 namespace service {
@@ -16,18 +27,43 @@ namespace sched {
 
 typedef void (*task_callback_t)(void *thisptr, void *arg);
 
+template <class T, unsigned capacity>
+class Heap;
+
 class Task {
  protected:
   unsigned prio;
   task_callback_t callback;
   void *thisptr, *arg;
   bool in_queue = false;
+  // Position in the Heap this task is in, maintained by Heap.
+  unsigned heapIdx;
+  // SysTimer::GetCycles() when the task entered the ready heap.
+  unsigned queuedCycle;
+  // Cycles from entering the ready heap until Run() has to be done, 0 for
+  // no deadline.
+  unsigned deadline;
+#if SCHED_PROFILE
+  // Entry of this task in the Profiler, maintained by Profiler.
+  unsigned char profileIdx;
+#endif
+
+  template <class T, unsigned capacity>
+  friend class Heap;
+  friend class Scheduler;
+  friend class Profiler;
 
  public:
   // For prio, see Scheduler.h
   constexpr Task(unsigned prio, task_callback_t callback, void *thisptr)
       : prio(prio), callback(callback), thisptr(thisptr), arg(nullptr),
-        in_queue(false) {}
+        in_queue(false), heapIdx(0), queuedCycle(0), deadline(0)
+#if SCHED_PROFILE
+        ,
+        profileIdx(0)
+#endif
+  {
+  }
 
   // No copy
   Task(const Task &) = delete;
@@ -43,6 +79,19 @@ class Task {
   void Run();
   void SetArg(void *arg);
 
+  // The scheduler counts a deadline miss whenever Run() of this task returns
+  // more than us microseconds after it was queued. 0 disables the check.
+  void SetDeadline(unsigned us) { deadline = us * SysTimer::kCyclesPerUs; }
+  unsigned GetDeadline() { return deadline; }
+
+  // For prio, see Scheduler.h. Not while the task is queued, the ready heap
+  // is ordered by it.
+  void SetPriority(unsigned prio) {
+    my_assert(!in_queue);
+    this->prio = prio;
+  }
+  unsigned GetPriority() { return prio; }
+
   // Must be called whenever entering task or delayedTask queue.
   // This is for debugging double Add() or Remove().
   inline void EnterQueue() {
@@ -9,6 +9,11 @@ namespace signed_packet {
 
 SignedPacket::SignedPacket() : status(kFree) {}
 
+void SignedPacket::OnSignFinish(hitcon::ecc::Signature *signature) {
+  signature->toBuffer(sig);
+  status = PacketStatus::kWaitTransmit;
+}
+
 }  // namespace signed_packet
 
 using namespace hitcon::signed_packet;
@@ -93,22 +98,16 @@ bool SignedPacketService::SignAndSendData(packet_type packetType,
   return true;
 }
 
-void SignedPacketService::OnPacketSignFinish(
-    hitcon::ecc::Signature *signature) {
-  SignedPacket &packet = packet_queue_[signingPacketId];
-  signature->toBuffer(packet.sig);
-  packet.status = PacketStatus::kWaitTransmit;
-}
-
 void SignedPacketService::RoutineFunc() {
+  // EcLogic queues the jobs, so several packets can be signing at once.
   for (size_t packetId = 0; packetId < PACKET_QUEUE_SIZE; ++packetId) {
     if (packet_queue_[packetId].status != kWaitSignStart) continue;
     SignedPacket &packet = packet_queue_[packetId];
     bool ret = hitcon::ecc::g_ec_logic.StartSign(
         packet.data, packet.dataSize,
-        (callback_t)&SignedPacketService::OnPacketSignFinish, this);
+        (callback_t)&SignedPacket::OnSignFinish, &packet);
     if (!ret) break;
-    signingPacketId = packetId;
+    packet.status = kWaitSignDone;
   }
   // Scan the packet queue and transmit them if possible
   for (size_t packetId = 0; packetId < PACKET_QUEUE_SIZE; ++packetId) {
@@ -29,6 +29,7 @@ struct SignedPacket {
   uint8_t sig[ECC_SIGNATURE_SIZE];
 
   SignedPacket();
+  void OnSignFinish(hitcon::ecc::Signature *signature);
 };
 
 }  // namespace signed_packet
@@ -46,11 +47,9 @@ class SignedPacketService {
 
  private:
   hitcon::service::sched::PeriodicTask routineTask;
-  size_t signingPacketId;
   signed_packet::SignedPacket packet_queue_[signed_packet::PACKET_QUEUE_SIZE];
 
   void RoutineFunc();
-  void OnPacketSignFinish(hitcon::ecc::Signature *signature);
 };
 
 extern SignedPacketService g_signed_packet_service;
@@ -0,0 +1,101 @@
+#ifndef UTIL_MPSC_QUEUE_DOT_H_
+#define UTIL_MPSC_QUEUE_DOT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace hitcon {
+
+// A fixed-capacity lock-free queue for many producers and one consumer.
+//
+// PushBack() may be called from any context, including interrupts that
+// preempt each other or the consumer, without masking interrupts. Producers
+// claim a slot with a compare-and-swap on the back index (LDREX/STREX on the
+// Cortex-M3), write it, then publish it through the slot's sequence number.
+// The consumer only takes published slots in order, so a producer that got
+// preempted between claiming and publishing holds up the elements behind it
+// until it resumes, it never loses them.
+//
+// Pushes that find the queue full are dropped and counted in Overflows().
+//
+// capacity must be a power of 2.
+template <class T, unsigned capacity>
+class MpscQueue {
+  static_assert(capacity >= 2 && (capacity & (capacity - 1)) == 0,
+                "capacity must be a power of 2");
+  static constexpr uint32_t kMask = capacity - 1;
+
+  struct Slot {
+    // pos when the slot is free for the push at pos, pos + 1 once that push
+    // is published.
+    std::atomic<uint32_t> seq;
+    T value;
+  };
+
+  Slot slots_[capacity];
+  std::atomic<uint32_t> back_;
+  // Only touched by the consumer.
+  uint32_t front_;
+  std::atomic<uint32_t> overflows_;
+
+ public:
+  MpscQueue() : back_(0), front_(0), overflows_(0) {
+    for (uint32_t i = 0; i < capacity; i++) {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  size_t Capacity() { return capacity; }
+
+  // Returns false and counts an overflow if the queue is full.
+  bool PushBack(const T &value) {
+    uint32_t pos = back_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot &slot = slots_[pos & kMask];
+      int32_t diff = static_cast<int32_t>(
+          slot.seq.load(std::memory_order_acquire) - pos);
+      if (diff == 0) {
+        // On failure pos is reloaded and we retry with the new back.
+        if (back_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          slot.value = value;
+          slot.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        // The consumer hasn't freed this slot since the last lap.
+        overflows_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = back_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Consumer only. Copies the front element if it has been published.
+  bool PeekFront(T &out) {
+    Slot &slot = slots_[front_ & kMask];
+    if (slot.seq.load(std::memory_order_acquire) != front_ + 1) return false;
+    out = slot.value;
+    return true;
+  }
+
+  // Consumer only. Drops the front element, only after PeekFront() found it.
+  void PopFront() {
+    slots_[front_ & kMask].seq.store(front_ + capacity,
+                                     std::memory_order_release);
+    front_++;
+  }
+
+  // Consumer only. A push makes this false as soon as it has claimed its
+  // slot, PeekFront() may still fail until it's published.
+  bool IsEmpty() { return back_.load(std::memory_order_acquire) == front_; }
+
+  // How many pushes were dropped because the queue was full.
+  uint32_t Overflows() { return overflows_.load(std::memory_order_relaxed); }
+};
+
+}  // namespace hitcon
+
+#endif  // UTIL_MPSC_QUEUE_DOT_H_
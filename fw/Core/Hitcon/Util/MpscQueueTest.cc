@@ -0,0 +1,124 @@
+#ifdef MPSC_QUEUE_TEST
+
+// g++ -I./ -Wall -pedantic -O2 -pthread Util/MpscQueueTest.cc
+// -o Util/MpscQueueTest -DMPSC_QUEUE_TEST
+// Also built and run by `make test` in Host/.
+
+#include <Util/MpscQueue.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Fill, overflow, drain and wrap around from a single thread.
+void test_single_thread() {
+  std::cout << "Running test_single_thread..." << std::endl;
+
+  hitcon::MpscQueue<uint32_t, 8> q;
+  uint32_t out = 0;
+  assert(q.IsEmpty());
+  assert(!q.PeekFront(out));
+
+  for (uint32_t lap = 0; lap < 5; lap++) {
+    for (uint32_t i = 0; i < 8; i++) assert(q.PushBack(lap * 100 + i));
+    assert(!q.IsEmpty());
+    assert(!q.PushBack(999));
+    assert(q.Overflows() == lap + 1);
+    for (uint32_t i = 0; i < 8; i++) {
+      assert(q.PeekFront(out));
+      assert(out == lap * 100 + i);
+      // Peeking doesn't consume.
+      assert(q.PeekFront(out));
+      assert(out == lap * 100 + i);
+      q.PopFront();
+    }
+    assert(q.IsEmpty());
+    assert(!q.PeekFront(out));
+  }
+
+  // Interleaved push and pop across the wrap point.
+  for (uint32_t i = 0; i < 100; i++) {
+    assert(q.PushBack(i));
+    assert(q.PushBack(i + 1000));
+    assert(q.PeekFront(out) && out == i);
+    q.PopFront();
+    assert(q.PeekFront(out) && out == i + 1000);
+    q.PopFront();
+  }
+  assert(q.IsEmpty());
+  std::cout << "test_single_thread passed." << std::endl;
+}
+
+// Producer threads stand in for interrupts: they push without retrying and
+// drop on overflow, like Scheduler::Queue(). The consumer stands in for
+// Scheduler::DelayedHouseKeeping(). Every accepted push must come out
+// exactly once and in order per producer, and every rejected push must be
+// counted by Overflows().
+void test_stress() {
+  std::cout << "Running test_stress..." << std::endl;
+
+  constexpr unsigned kProducers = 4;
+  constexpr uint32_t kPushes = 200000;
+  static hitcon::MpscQueue<uint32_t, 8> q;
+
+  std::atomic<unsigned> running(kProducers);
+  std::vector<uint32_t> accepted(kProducers), rejected(kProducers);
+  std::vector<std::thread> producers;
+  for (unsigned p = 0; p < kProducers; p++) {
+    producers.emplace_back([&, p]() {
+      for (uint32_t i = 0; i < kPushes; i++) {
+        if (q.PushBack((p << 24) | i))
+          accepted[p]++;
+        else
+          rejected[p]++;
+        // Interrupts come in bursts, let the consumer catch up in between.
+        // Together the bursts are a bit more than the queue holds.
+        if (i % (p + 1) == p) std::this_thread::yield();
+      }
+      running--;
+    });
+  }
+
+  std::vector<uint32_t> received(kProducers);
+  std::vector<int64_t> last(kProducers, -1);
+  uint32_t out;
+  while (true) {
+    bool done = running.load() == 0;
+    while (q.PeekFront(out)) {
+      q.PopFront();
+      unsigned p = out >> 24;
+      int64_t seq = out & 0xFFFFFF;
+      assert(p < kProducers);
+      assert(seq > last[p]);
+      last[p] = seq;
+      received[p]++;
+    }
+    if (done) break;
+    std::this_thread::yield();
+  }
+  for (auto &t : producers) t.join();
+
+  uint32_t total_rejected = 0;
+  for (unsigned p = 0; p < kProducers; p++) {
+    assert(received[p] == accepted[p]);
+    assert(accepted[p] + rejected[p] == kPushes);
+    total_rejected += rejected[p];
+  }
+  assert(q.Overflows() == total_rejected);
+  assert(total_rejected < kProducers * kPushes);
+  assert(q.IsEmpty());
+  std::cout << "test_stress passed, " << total_rejected << " of "
+            << kProducers * kPushes << " pushes overflowed." << std::endl;
+}
+
+int main() {
+  test_single_thread();
+  test_stress();
+  std::cout << "All MpscQueue tests passed!" << std::endl;
+  return 0;
+}
+
+#endif  // MPSC_QUEUE_TEST
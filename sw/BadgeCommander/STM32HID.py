@@ -1,4 +1,5 @@
 import math
+import struct
 import time
 import hid
 import crc32
@@ -44,6 +45,36 @@ def read_memory(addr, mode):
     print(r)
     return r
 
+# Scheduler task profile, see profile_page_t in fw/Core/Hitcon/Logic/UsbLogic.h
+def read_task_profile(index):
+    pages = []
+    for page in range(11):
+        send_command([0x09, index, page] + [0x00]*5)
+        pages.append(bytes(device.read(8)))
+    task, runs = struct.unpack('<II', pages[0])
+    exec_max, wait_max = struct.unpack('<II', pages[1])
+    exec_total, = struct.unpack('<Q', pages[2])
+    wait_total, = struct.unpack('<Q', pages[3])
+    exec_hist = list(struct.unpack('<12H', b''.join(pages[4:7])))[:10]
+    wait_hist = list(struct.unpack('<12H', b''.join(pages[7:10])))[:10]
+    misses, deadline = struct.unpack('<II', pages[10])
+    return {'task': task, 'runs': runs, 'exec_max': exec_max,
+            'wait_max': wait_max, 'exec_total': exec_total,
+            'wait_total': wait_total, 'exec_hist': exec_hist,
+            'wait_hist': wait_hist, 'misses': misses, 'deadline': deadline}
+
+def read_last_deadline_miss():
+    pages = []
+    for page in range(3):
+        send_command([0x09, 0xFF, page] + [0x00]*5)
+        pages.append(bytes(device.read(8)))
+    task, offender = struct.unpack('<II', pages[0])
+    late, offender_cycles = struct.unpack('<II', pages[1])
+    misses, time_ms = struct.unpack('<II', pages[2])
+    return {'task': task, 'offender': offender, 'late': late,
+            'offender_cycles': offender_cycles, 'misses': misses,
+            'time': time_ms}
+
 def write_memory(addr, data, mode):
     #hex string to 4 bytes array
     addr = [int(addr[i:i+2], 16) for i in range(0, len(addr), 2)]